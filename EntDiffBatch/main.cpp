@@ -0,0 +1,285 @@
+/*
+* EntDiffBatch - Exports an EntityDiff for every entities file changed between two game versions
+*
+* Usage: EntDiffBatch <olddir> <newdir> <outputdir> [-j threads] [--memory megabytes]
+*
+* Files are matched by their path relative to each directory. Every matched file gets
+* <outputdir>/<relative path>.diff, and <outputdir>/index.txt summarizes the whole update.
+* Files are parsed and diffed in parallel, largest first, while the estimated memory held by
+* parsed files stays within the budget. A file that exceeds the budget by itself runs alone
+*/
+#include "../Parser/EntityParser.h"
+#include "../Parser/EntityDiff.h"
+#include "../Parser/WorkerPool.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+/* Parsed trees take roughly this many times their text's size in memory */
+const size_t ParseOverhead = 4;
+
+enum class batch_status
+{
+	changed,
+	identical,
+	added,
+	removed,
+	failed
+};
+
+const char* batch_statusname(batch_status status)
+{
+	switch (status)
+	{
+		case batch_status::changed: return "changed";
+		case batch_status::identical: return "identical";
+		case batch_status::added: return "added";
+		case batch_status::removed: return "removed";
+		default: return "failed";
+	}
+}
+
+struct batch_job
+{
+	std::string relpath;
+	fs::path oldpath;        // Empty if the file was added
+	fs::path newpath;        // Empty if the file was removed
+	ParsingMode mode = ParsingMode::ENTITIES;
+	size_t cost = 0;         // Estimated peak memory while diffing
+
+	batch_status status = batch_status::failed;
+	EntityDiff::ExportStats stats;
+	std::string error;
+};
+
+/*
+* Blocks jobs until enough of the memory budget is free for them
+*/
+class batch_budget
+{
+	private:
+	std::mutex mutex;
+	std::condition_variable released;
+	const size_t limit;
+	size_t used = 0;
+
+	public:
+	batch_budget(size_t megabytes) : limit(megabytes * 1024 * 1024) {}
+
+	void acquire(size_t cost)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		released.wait(lock, [&]() { return used == 0 || used + cost <= limit; });
+		used += cost;
+	}
+
+	void release(size_t cost)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			used -= cost;
+		}
+		released.notify_all();
+	}
+};
+
+/*
+* Size of a file's text once decompressed, read from the Oodle header if it has one
+*/
+size_t batch_textsize(const fs::path& path)
+{
+	std::error_code err;
+	size_t filesize = (size_t)fs::file_size(path, err);
+	if(err)
+		return 0;
+
+	unsigned char header[17];
+	std::ifstream file(path, std::ios_base::binary);
+	if (file.read((char*)header, sizeof(header)) && header[16] == 0x8C) {
+		uint64_t decompsize = 0;
+		memcpy(&decompsize, header, sizeof(decompsize));
+		return (size_t)decompsize + filesize;
+	}
+	return filesize;
+}
+
+bool batch_isentities(const fs::path& path, ParsingMode& mode)
+{
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+
+	if(extension == ".entities")
+		mode = ParsingMode::ENTITIES;
+	else if(extension == ".mapentities")
+		mode = ParsingMode::PERMISSIVE;
+	else return false;
+	return true;
+}
+
+/*
+* Adds every entities file in a directory to the jobs, keyed by relative path
+*/
+void batch_gather(const fs::path& directory, bool isnew, std::map<std::string, batch_job>& jobs)
+{
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(directory)) {
+		ParsingMode mode;
+		if(!entry.is_regular_file() || !batch_isentities(entry.path(), mode))
+			continue;
+
+		std::string relpath = fs::relative(entry.path(), directory).generic_string();
+		batch_job& job = jobs[relpath];
+		job.relpath = relpath;
+		job.mode = mode;
+		job.cost += batch_textsize(entry.path()) * ParseOverhead;
+		if(isnew)
+			job.newpath = entry.path();
+		else job.oldpath = entry.path();
+	}
+}
+
+void batch_run(batch_job& job, const fs::path& outputdir, unsigned exportThreads)
+{
+	try {
+		// Files that only exist on one side are diffed against an empty file
+		// Input files are never rewritten, even when a compressed one fails to parse
+		std::unique_ptr<EntityParser> oldparser(job.oldpath.empty() ? new EntityParser(job.mode, "", false)
+			: new EntityParser(job.oldpath.string(), job.mode, false, false));
+		std::unique_ptr<EntityParser> newparser(job.newpath.empty() ? new EntityParser(job.mode, "", false)
+			: new EntityParser(job.newpath.string(), job.mode, false, false));
+
+		fs::path diffpath = outputdir / (job.relpath + ".diff");
+		fs::create_directories(diffpath.parent_path());
+		job.stats = EntityDiff::Export(*oldparser->getRoot(), *newparser->getRoot(), diffpath.string().c_str(), exportThreads);
+		const EntityDiff::ExportStats& s = job.stats;
+
+		if(job.oldpath.empty())
+			job.status = batch_status::added;
+		else if(job.newpath.empty())
+			job.status = batch_status::removed;
+		else if(s.deleted + s.added + s.edited + s.renamed + s.moved == 0)
+			job.status = batch_status::identical;
+		else job.status = batch_status::changed;
+	}
+	catch (std::exception& e) {
+		job.status = batch_status::failed;
+		job.error = e.what();
+	}
+	catch (...) {
+		job.status = batch_status::failed;
+		job.error = "Unknown error";
+	}
+}
+
+/*
+* Writes the summary of every job, in a syntax the editor can open
+*/
+bool batch_writeindex(const std::vector<batch_job*>& jobs, const fs::path& outputdir)
+{
+	std::ofstream index(outputdir / "index.txt", std::ios_base::binary);
+	if(!index.is_open())
+		return false;
+
+	for (const batch_job* job : jobs) {
+		index << "file \"" << job->relpath << "\" {\n"
+			<< "\tstatus = \"" << batch_statusname(job->status) << "\";\n";
+		if (job->status == batch_status::failed) {
+			std::string error = job->error;
+			std::replace(error.begin(), error.end(), '"', '\'');
+			index << "\terror = \"" << error << "\";\n";
+		}
+		else {
+			index << "\tdeleted = " << job->stats.deleted << ";\n"
+				<< "\tadded = " << job->stats.added << ";\n"
+				<< "\tedited = " << job->stats.edited << ";\n"
+				<< "\trenamed = " << job->stats.renamed << ";\n"
+				<< "\tmoved = " << job->stats.moved << ";\n";
+		}
+		index << "}\n";
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* usage = "Usage: EntDiffBatch <olddir> <newdir> <outputdir> [-j threads] [--memory megabytes]\n";
+	std::vector<std::string> positional;
+	unsigned threads = WorkerPool::ThreadCount();
+	size_t memory = 4096;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc)
+			threads = (unsigned)std::max(1L, strtol(argv[++i], nullptr, 10));
+		else if (arg == "--memory" && i + 1 < argc)
+			memory = (size_t)std::max(1L, strtol(argv[++i], nullptr, 10));
+		else positional.push_back(arg);
+	}
+	if (positional.size() != 3) {
+		std::cerr << usage;
+		return 1;
+	}
+
+	fs::path olddir = positional[0], newdir = positional[1], outputdir = positional[2];
+	if (!fs::is_directory(olddir) || !fs::is_directory(newdir)) {
+		std::cerr << "Input directories must exist\n" << usage;
+		return 1;
+	}
+
+	std::map<std::string, batch_job> jobmap;
+	try {
+		batch_gather(olddir, false, jobmap);
+		batch_gather(newdir, true, jobmap);
+		fs::create_directories(outputdir);
+	}
+	catch (fs::filesystem_error& e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	// Start the largest files first so a big file isn't left running alone at the end
+	std::vector<batch_job*> jobs;
+	for(auto& pair : jobmap)
+		jobs.push_back(&pair.second);
+	std::vector<batch_job*> order = jobs;
+	std::stable_sort(order.begin(), order.end(), [](const batch_job* a, const batch_job* b) {
+		return a->cost > b->cost;
+	});
+
+	// When several files are diffed at once, each diff stays on its own thread
+	unsigned exportThreads = threads > 1 && jobs.size() > 1 ? 1 : threads;
+	batch_budget budget(memory);
+	std::mutex printMutex;
+	WorkerPool::ParallelFor(order.size(), [&](size_t i) {
+		batch_job& job = *order[i];
+		budget.acquire(job.cost);
+		batch_run(job, outputdir, exportThreads);
+		budget.release(job.cost);
+
+		std::lock_guard<std::mutex> lock(printMutex);
+		std::cout << batch_statusname(job.status) << ": " << job.relpath << "\n";
+		if(job.status == batch_status::failed)
+			std::cout << "\t" << job.error << "\n";
+	}, threads);
+
+	if (!batch_writeindex(jobs, outputdir)) {
+		std::cerr << "Could not write the summary index\n";
+		return 1;
+	}
+
+	size_t failures = std::count_if(jobs.begin(), jobs.end(), [](const batch_job* job) {
+		return job->status == batch_status::failed;
+	});
+	std::cout << jobs.size() << " files compared, " << failures << " failed\n";
+	return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,76 @@
+/*
+* EntQuery - Lists the entities in a file that match an EntityQuery
+*
+* Usage: EntQuery <file> <query> [-j threads]
+*
+* .entities files are parsed as entities, .json files as JSON and everything else permissively.
+* The name of every matching entity is printed in file order, followed by the number of matches
+*/
+#include "../Parser/EntityParser.h"
+#include "../Parser/EntityQuery.h"
+#include "../Parser/WorkerPool.h"
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+ParsingMode query_mode(const fs::path& path)
+{
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+
+	if(extension == ".entities")
+		return ParsingMode::ENTITIES;
+	if(extension == ".json")
+		return ParsingMode::JSON;
+	return ParsingMode::PERMISSIVE;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* usage = "Usage: EntQuery <file> <query> [-j threads]\n";
+	std::vector<std::string> positional;
+	unsigned threads = WorkerPool::ThreadCount();
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc)
+			threads = (unsigned)std::max(1L, strtol(argv[++i], nullptr, 10));
+		else positional.push_back(arg);
+	}
+	if (positional.size() != 2) {
+		std::cerr << usage;
+		return 1;
+	}
+
+	try {
+		// Compile first so a mistyped query doesn't wait on a large file
+		EntityQuery query(positional[1]);
+		// The input file is never rewritten, even when a compressed one fails to parse
+		EntityParser parser(positional[0], query_mode(positional[0]), false, false);
+
+		EntityBitset matches;
+		const EntityIndex& index = parser.getFacets();
+		query.Run(index, matches, nullptr, threads);
+
+		size_t count = 0;
+		for (size_t slot = 0; slot < index.SlotCount(); slot++) {
+			if(!matches.test(slot))
+				continue;
+			const EntNode* entity = index.EntityAt(slot);
+			std::string_view name = EntityFields::Name(*entity);
+			std::cout << (name.empty() ? entity->getName() : name) << "\n";
+			count++;
+		}
+		std::cout << count << " entities matched\n";
+		return 0;
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+}
@@ -10,8 +10,12 @@ wxBEGIN_EVENT_TABLE(EntityEditor, wxStyledTextCtrl)
     EVT_STC_CHARADDED(wxID_ANY, EntityEditor::OnCharAdded)
 
     EVT_KEY_DOWN(EntityEditor::OnKeyDown)
+    EVT_IDLE(EntityEditor::OnIdle)
 wxEND_EVENT_TABLE()
 
+const size_t EntityEditor::LAZY_THRESHOLD = 128 * 1024;
+const size_t EntityEditor::CHUNK_SIZE = 128 * 1024;
+
 #define MarginLines 0
 #define MarginFolds 1
 #define AnnotationStyle wxSTC_STYLE_LASTPREDEFINED + 1
@@ -202,6 +206,7 @@ void InitPrefs(wxStyledTextCtrl* e) {
     // More policies that it's probably best not to touch
     e->CmdKeyClear(wxSTC_KEY_TAB, 0); // This is done by the menu accelerator key
     e->SetLayoutCache(wxSTC_CACHE_PAGE);
+    e->SetIdleStyling(wxSTC_IDLESTYLING_ALL); // Only the visible text is styled and folded immediately
     e->UsePopUp(wxSTC_POPUP_ALL); // Disables the context menu if disabled
 
     // Controlled Elsewhere in the Editor
@@ -302,6 +307,9 @@ void EntityEditor::OnCharAdded(wxStyledTextEvent& event)
 void EntityEditor::SetActiveNode(EntNode* node)
 {
     //wxLogMessage("Changing text editor's node");
+    pendingText.clear();
+    pendingOffset = 0;
+    SetUndoCollection(true);
 
     /* 
     * Line Wrap causes noticeable lag when loading large texts
@@ -309,6 +317,7 @@ void EntityEditor::SetActiveNode(EntNode* node)
     * by disabling line wrap until the node's text has been loaded in
     */
     SetWrapMode(wxSTC_WRAP_NONE);
+    SetReadOnly(false);
 
     if (node == nullptr || node->IsRoot())
     {
@@ -316,16 +325,63 @@ void EntityEditor::SetActiveNode(EntNode* node)
         SetReadOnly(true);
     }
     else {
-        SetReadOnly(false);
-        SetText(node->toString());
+        node->generateText(pendingText);
+        if (pendingText.length() <= LAZY_THRESHOLD) {
+            SetText(pendingText);
+            pendingText.clear();
+        }
+        else {
+            // Show the first chunk now - idle events append the rest
+            SetUndoCollection(false);
+            ClearAll();
+            appendChunk();
+        }
     }
-    SetWrapMode(wxSTC_WRAP_WORD);
+    if(pendingText.empty())
+        SetWrapMode(wxSTC_WRAP_WORD);
     activeNode = node;
     AnnotationClearAll();
     EmptyUndoBuffer();
     MarkUnmodified();
 }
 
+bool EntityEditor::appendChunk()
+{
+    // Split at a line break, so no multi-byte character is cut in half
+    size_t end = pendingOffset + CHUNK_SIZE;
+    if (end >= pendingText.length())
+        end = pendingText.length();
+    else {
+        size_t lineEnd = pendingText.rfind('\n', end);
+        if(lineEnd != std::string::npos && lineEnd >= pendingOffset)
+            end = lineEnd + 1;
+    }
+
+    SetReadOnly(false);
+    AppendText(wxString(pendingText.data() + pendingOffset, end - pendingOffset));
+    pendingOffset = end;
+    if (pendingOffset < pendingText.length()) {
+        SetReadOnly(true);
+        return false;
+    }
+
+    pendingText.clear();
+    pendingText.shrink_to_fit();
+    pendingOffset = 0;
+    SetUndoCollection(true);
+    EmptyUndoBuffer();
+    MarkUnmodified();
+    SetWrapMode(wxSTC_WRAP_WORD);
+    return true;
+}
+
+void EntityEditor::OnIdle(wxIdleEvent& event)
+{
+    if(!pendingText.empty() && !appendChunk())
+        event.RequestMore();
+    event.Skip(); // The styled text control does it's own idle work
+}
+
 EntNode* EntityEditor::Node()
 {
     return activeNode;
@@ -339,15 +395,13 @@ bool EntityEditor::Modified()
 
 void EntityEditor::MarkUnmodified()
 {
-    originalText = GetValue();
     SetModified(false);
 }
 
 void EntityEditor::RevertEdits()
 {
-    AnnotationClearAll();
-    SetText(originalText);
-    SetModified(false);
+    // The node isn't changed until edits are committed, so it still has the original text
+    SetActiveNode(activeNode);
 }
 
 void EntityEditor::setAnnotationError(const size_t lineNumber, const std::string& errorMessage)
@@ -8,7 +8,15 @@ class EntityEditor: public wxStyledTextCtrl
 {
     private:
     EntNode* activeNode = nullptr;
-    wxString originalText = "";
+
+    /*
+    * Large nodes are loaded a chunk at a time during idle events, so selecting one
+    * doesn't stall. The editor stays read-only until the rest of their text arrives
+    */
+    std::string pendingText;
+    size_t pendingOffset = 0;
+    static const size_t LAZY_THRESHOLD;
+    static const size_t CHUNK_SIZE;
 
     bool recursiveGuard = false; // Prevent recursive loops when adding characters programatically
 
@@ -32,6 +40,7 @@ class EntityEditor: public wxStyledTextCtrl
     void OnMarginClick(wxStyledTextEvent& event);
     void OnKeyDown(wxKeyEvent& event);
     void OnCharAdded(wxStyledTextEvent& event);
+    void OnIdle(wxIdleEvent& event);
 
     /* Editing-Related Items */
 
@@ -43,5 +52,6 @@ class EntityEditor: public wxStyledTextCtrl
     void setAnnotationError(const size_t lineNumber, const std::string& errorMessage);
 
     private:
+    bool appendChunk(); // Returns true once the whole node is loaded
     wxDECLARE_EVENT_TABLE();
 };
@@ -3,6 +3,7 @@
 #include "wx/clipbrd.h"
 #include "wx/dir.h"
 #include "wx/filename.h"
+#include "wx/progdlg.h"
 #include "Meathook.h"
 #include "Oodle.h"
 #include "Config.h"
@@ -10,6 +11,7 @@
 #include "EntityTab.h"
 #include "EntityFolderDialog.h"
 #include "EntityProfiler.h"
+#include "WorkerPool.h"
 
 enum FrameID
 {
@@ -24,10 +26,16 @@ enum FrameID
 	FILE_CLOSE_ALL_OTHERS,
 	FILE_RELOAD,
 	FILE_RELOAD_CONFIGFILE,
+	FILE_OPEN_PROGRESS,
 	
 	TAB_SEARCHFORWARD,
 	TAB_SEARCHBACKWARD,
 	TAB_COMPRESS,
+	TAB_COMPRESSION_BENCHMARK,
+	TAB_COMPRESSION_SAVE,
+	TAB_COMPRESSION_SAVE_MAX = TAB_COMPRESSION_SAVE + 31,
+	TAB_COMPRESSION_RELOAD,
+	TAB_COMPRESSION_RELOAD_MAX = TAB_COMPRESSION_RELOAD + 31,
 	TAB_NUMBERLISTS,
 	TAB_EXPORTDIFF,
 	TAB_IMPORTDIFF,
@@ -45,6 +53,7 @@ enum FrameID
 	MEATHOOK_SPAWNPOS_OFFSET,
 	MEATHOOK_GET_CHECKPOINT,
 	MEATHOOK_GET_ENCOUNTER,
+	MEATHOOK_GET_NEAREST,
 	
 	SPECIAL_DEBUG_DUMPBUFFERS,
 	SPECIAL_PROPMOVERS,
@@ -53,6 +62,34 @@ enum FrameID
 	DEBUG_MENUONE
 };
 
+/*
+* Compression submenus: compressor radio items use ids base + compressor index,
+* and level radio items use ids base + COMPRESSIONMENU_LEVELS + level
+*/
+const int COMPRESSIONMENU_LEVELS = 16;
+
+wxMenu* BuildCompressionMenu(int idBase)
+{
+	wxMenu* menu = new wxMenu;
+	for(int i = 0; i < Oodle::CompressorCount; i++)
+		menu->AppendRadioItem(idBase + i, Oodle::CompressorName(Oodle::CompressorList[i]));
+	menu->AppendSeparator();
+	for(int level = 0; level < Oodle::LEVEL_COUNT; level++)
+		menu->AppendRadioItem(idBase + COMPRESSIONMENU_LEVELS + level, Oodle::LevelName(level));
+	return menu;
+}
+
+void CheckCompressionMenu(wxMenu* menu, int idBase, const Oodle::CompressionSettings& settings)
+{
+	for (int i = 0; i < Oodle::CompressorCount; i++) {
+		if (Oodle::CompressorList[i] == settings.compressor) {
+			menu->Check(idBase + i, true);
+			break;
+		}
+	}
+	menu->Check(idBase + COMPRESSIONMENU_LEVELS + settings.level, true);
+}
+
 wxBEGIN_EVENT_TABLE(EntityFrame, wxFrame)
 	EVT_CLOSE(EntityFrame::onWindowClose)
 
@@ -65,6 +102,7 @@ wxBEGIN_EVENT_TABLE(EntityFrame, wxFrame)
 	EVT_MENU(FILE_NEW, EntityFrame::onFileNew)
 	EVT_MENU(FILE_OPEN_FILE, EntityFrame::onFileOpen)
 	EVT_MENU(FILE_OPEN_FOLDER, EntityFrame::onFileOpenFolder)
+	EVT_TIMER(FILE_OPEN_PROGRESS, EntityFrame::onOpenProgress)
 	EVT_MENU(FILE_OPEN_CONFIG, EntityFrame::onOpenConfig)
 	EVT_MENU(FILE_SAVE, EntityFrame::onFileSave)
 	EVT_MENU(FILE_SAVEAS, EntityFrame::onFileSaveAs)
@@ -75,6 +113,9 @@ wxBEGIN_EVENT_TABLE(EntityFrame, wxFrame)
 	EVT_MENU(TAB_SEARCHFORWARD, EntityFrame::onSearchForward)
 	EVT_MENU(TAB_SEARCHBACKWARD, EntityFrame::onSearchBackward)
 	EVT_MENU(TAB_COMPRESS, EntityFrame::onCompressCheck)
+	EVT_MENU(TAB_COMPRESSION_BENCHMARK, EntityFrame::onCompressionBenchmark)
+	EVT_MENU_RANGE(TAB_COMPRESSION_SAVE, TAB_COMPRESSION_SAVE_MAX, EntityFrame::onCompressionSelect)
+	EVT_MENU_RANGE(TAB_COMPRESSION_RELOAD, TAB_COMPRESSION_RELOAD_MAX, EntityFrame::onCompressionSelect)
 	EVT_MENU(TAB_NUMBERLISTS, EntityFrame::onNumberListCheck)
 	EVT_MENU(TAB_EXPORTDIFF, EntityFrame::onExportDiff)
 	EVT_MENU(TAB_IMPORTDIFF, EntityFrame::onImportDiff)
@@ -86,6 +127,7 @@ wxBEGIN_EVENT_TABLE(EntityFrame, wxFrame)
 	EVT_MENU(MEATHOOK_RELOAD, EntityFrame::onReloadMH)
 	EVT_MENU(MEATHOOK_OPENFILE, EntityFrame::onMeathookOpen) 
 	EVT_MENU(MEATHOOK_GET_ENCOUNTER, EntityFrame::onPrintActiveEncounters)
+	EVT_MENU(MEATHOOK_GET_NEAREST, EntityFrame::onFindNearestEntities)
 	EVT_MENU(MEATHOOK_GET_SPAWNPOSITION, EntityFrame::onGetSpawnPosition)
 	EVT_MENU(MEATHOOK_GET_SPAWNPOSITION_FILTER, EntityFrame::onGetSpawnPosition)
 	EVT_MENU(MEATHOOK_GET_SPAWNORIENTATION, EntityFrame::onGetSpawnOrientation)
@@ -131,6 +173,11 @@ EntityFrame::EntityFrame() : wxFrame(nullptr, wxID_ANY, "EntitySlayer")
 		tabMenu->Append(TAB_SEARCHBACKWARD, "Search Backward\tCtrl+Space");
 		tabMenu->AppendSeparator();
 		tabMenu->AppendCheckItem(TAB_COMPRESS, "Compress on Save\tF1");
+		tabMenu->AppendSubMenu(BuildCompressionMenu(TAB_COMPRESSION_SAVE), "Save Compression");
+		tabMenu->AppendSubMenu(BuildCompressionMenu(TAB_COMPRESSION_RELOAD), "Reload Compression",
+			"Compression used when saving the file for a level reload");
+		tabMenu->Append(TAB_COMPRESSION_BENCHMARK, "Benchmark Compression",
+			"Times every level of the save compressor. The fastest level becomes the reload compression setting");
 		tabMenu->AppendCheckItem(TAB_NUMBERLISTS, "Auto-Renumber idLists");
 		tabMenu->AppendSeparator();
 		tabMenu->Append(TAB_EXPORTDIFF, "Export Entity Diff");
@@ -144,6 +191,8 @@ EntityFrame::EntityFrame() : wxFrame(nullptr, wxID_ANY, "EntitySlayer")
 		mhMenu->Append(MEATHOOK_OPENFILE, "Open Current Map\tCtrl+Shift+O",
 			"Write's the current level's entities to a temporary file and opens it in a new tab");
 		mhMenu->Append(MEATHOOK_GET_ENCOUNTER, "Find Active Encounters\tF3");
+		mhMenu->Append(MEATHOOK_GET_NEAREST, "Find Nearest Entities\tShift+F3",
+			"Lists the entities in this tab with the closest spawnPositions to the player");
 		mhMenu->AppendSeparator();
 		mhMenu->Append(MEATHOOK_GET_SPAWNPOSITION, "Copy spawnPosition");
 		mhMenu->Append(MEATHOOK_GET_SPAWNPOSITION_FILTER, "Copy spawnPosition and Set Filter\tF2",
@@ -217,6 +266,8 @@ EntityFrame::EntityFrame() : wxFrame(nullptr, wxID_ANY, "EntitySlayer")
 		mhStatusTimer.Start(5000);
 	}
 
+	openJob.progressTimer.SetOwner(this, FILE_OPEN_PROGRESS);
+
 	/* Initialize Notebook */
 	{
 		book = new wxAuiNotebook(this, wxID_ANY, wxDefaultPosition, wxDefaultSize,
@@ -258,6 +309,7 @@ EntityFrame::EntityFrame() : wxFrame(nullptr, wxID_ANY, "EntitySlayer")
 
 EntityFrame::~EntityFrame()
 {
+	stopOpenJob();
 	delete wxLog::SetActiveTarget(NULL);
 }
 
@@ -372,6 +424,8 @@ void EntityFrame::onTabChanged(wxAuiNotebookEvent& event)
 		fileMenu->Enable(FILE_RELOAD, true);
 	}
 	tabMenu->Check(TAB_COMPRESS, activeTab->compressOnSave);
+	CheckCompressionMenu(tabMenu, TAB_COMPRESSION_SAVE, activeTab->saveCompression);
+	CheckCompressionMenu(tabMenu, TAB_COMPRESSION_RELOAD, activeTab->reloadCompression);
 	tabMenu->Check(TAB_NUMBERLISTS, activeTab->autoNumberLists);
 	RefreshMHMenu();
 }
@@ -381,42 +435,167 @@ void EntityFrame::onFileNew(wxCommandEvent& event)
 	AddUntitledTab();
 }
 
+/*
+* Parsers are built for every file at once on worker threads. GUI classes aren't thread safe,
+* so each file's tab is made on the main thread once its parser is ready
+*/
 void EntityFrame::openFiles(const wxArrayString& filepaths)
 {
+	if (openJob.worker.joinable()) {
+		wxLogMessage("Files are still being opened. Wait for them to finish before opening more");
+		return;
+	}
+
+	wxArrayString paths;
 	for (const wxString& path : filepaths)
 	{
-		wxString name = wxFileNameFromPath(path);
-
 		// Don't open the same file twice
-		for (size_t i = 0, max = book->GetPageCount(); i < max; i++)
+		bool alreadyOpen = false;
+		for (size_t i = 0, max = book->GetPageCount(); i < max && !alreadyOpen; i++)
 		{
 			EntityTab* page = (EntityTab*)book->GetPage(i);
 			if (page->filePath == path)
 			{
 				book->SetSelection(i);
-				goto LABEL_CONTINUE_OUTER;
+				alreadyOpen = true;
 			}
 		}
+		if(!alreadyOpen && paths.Index(path) == wxNOT_FOUND)
+			paths.push_back(path);
+	}
+	if(paths.IsEmpty())
+		return;
 
-		try {
-			// If we want to multithread this function (which we should)
-			// Then we'll need to create the EntityParsers here and pass them
-			// to tabs as a constructor parm - the GUI classes don't appear to be
-			// thread safe (which is pretty stupid), so we have to separate
-			// the tab creation from the parser creation
-			// Questionable whether this would even be worthwhile
-			// Tab creation takes ~150 MS excluding the Parser anyways, meaning
-			// Parser operations only take ~40% of the total tab build time for average entity files
-			EntityTab* newTab = new EntityTab(book, name, path);
-			AddOpenedTab(newTab);
-		}
-		catch (std::runtime_error e) {
-			wxString msg = wxString::Format("File Opening Cancelled\n\n%s", e.what());
-			wxMessageBox(msg, name, wxICON_ERROR | wxOK | wxCENTER, this);
-		}
+	// wxStrings are converted here, so the workers only touch their own data
+	std::vector<std::string> files;
+	std::vector<ParsingMode> modes;
+	for (const wxString& path : paths) {
+		files.push_back(std::string(path));
+		modes.push_back(EntityTab::FileMode(path));
+	}
 
-		LABEL_CONTINUE_OUTER:;
+	openJob.paths = paths;
+	openJob.opened = 0;
+	openJob.finished = 0;
+	openJob.failures.clear();
+	openJob.cancel = false;
+	if (paths.size() > 1) {
+		openJob.progress = new wxProgressDialog("Opening Files",
+			wxString::Format("Opening %zu files", paths.size()), (int)paths.size(), this,
+			wxPD_CAN_ABORT | wxPD_AUTO_HIDE | wxPD_ELAPSED_TIME | wxPD_REMAINING_TIME);
+		openJob.progressTimer.Start(100);
 	}
+
+	std::weak_ptr<bool> alive = openJob.alive;
+	openJob.worker = std::thread([this, alive, files = std::move(files), modes = std::move(modes)]() {
+		WorkerPool::ParallelFor(files.size(), [&](size_t i) {
+			if(openJob.cancel)
+				return;
+
+			EntityParser* parsed = nullptr;
+			std::string error;
+			try {
+				parsed = new EntityParser(files[i], modes[i], true);
+			}
+			catch (std::exception& e) {
+				error = e.what();
+			}
+
+			wxTheApp->CallAfter([this, alive, i, parsed, error]() {
+				if (alive.expired()) {
+					if(parsed)
+						parsed->DecRef();
+					return;
+				}
+				onFileParsed(i, parsed, error);
+			});
+		});
+
+		// Queued behind every file's callback
+		wxTheApp->CallAfter([this, alive]() {
+			if(!alive.expired())
+				finishOpenJob();
+		});
+	});
+}
+
+void EntityFrame::onFileParsed(size_t index, EntityParser* parsed, const std::string& error)
+{
+	wxString name = wxFileNameFromPath(openJob.paths[index]);
+	if (parsed) {
+		EntityTab* newTab = new EntityTab(book, name, openJob.paths[index], parsed);
+		AddOpenedTab(newTab);
+		openJob.opened++;
+	}
+	else openJob.failures.append(wxString::Format("\n\n%s\n%s", name, error));
+
+	openJob.finished++;
+	updateOpenProgress("Opened " + name);
+}
+
+void EntityFrame::onOpenProgress(wxTimerEvent& event)
+{
+	updateOpenProgress(wxEmptyString);
+}
+
+/*
+* Update yields to the event loop, so the callbacks queued by the workers can run inside it.
+* Those nested calls skip their own Update, and finishOpenJob waits for this one to return
+* before it deletes the dialog
+*/
+void EntityFrame::updateOpenProgress(const wxString& message)
+{
+	if(!openJob.progress || openJob.cancel || openJob.updating)
+		return;
+
+	openJob.updating = true;
+	if(!openJob.progress->Update((int)openJob.finished, message))
+		openJob.cancel = true;
+	openJob.updating = false;
+
+	if (openJob.finishDeferred) {
+		openJob.finishDeferred = false;
+		std::weak_ptr<bool> alive = openJob.alive;
+		wxTheApp->CallAfter([this, alive]() {
+			if(!alive.expired())
+				finishOpenJob();
+		});
+	}
+}
+
+void EntityFrame::finishOpenJob()
+{
+	if (openJob.updating) {
+		openJob.finishDeferred = true;
+		return;
+	}
+
+	bool cancelled = openJob.cancel;
+	size_t attempted = openJob.paths.size();
+	stopOpenJob();
+
+	if(cancelled)
+		wxLogMessage("Opening cancelled. %zu of %zu files were opened", openJob.opened, attempted);
+
+	if (!openJob.failures.empty()) {
+		wxString msg = "File Opening Cancelled" + openJob.failures;
+		wxMessageBox(msg, "Could not open files", wxICON_ERROR | wxOK | wxCENTER, this);
+		openJob.failures.clear();
+	}
+}
+
+void EntityFrame::stopOpenJob()
+{
+	openJob.cancel = true;
+	if(openJob.worker.joinable())
+		openJob.worker.join();
+	openJob.progressTimer.Stop();
+	openJob.finishDeferred = false;
+	if (openJob.progress) {
+		delete openJob.progress; // Re-enables the frame
+		openJob.progress = nullptr;
+	}
+	openJob.paths.clear();
 }
 
 void EntityFrame::onOpenConfig(wxCommandEvent& event)
@@ -646,6 +825,27 @@ void EntityFrame::onCompressCheck(wxCommandEvent& event)
 	activeTab->Parser->MarkFileOutdated(); // Allows saving unedited file when compression toggled
 }
 
+void EntityFrame::onCompressionSelect(wxCommandEvent& event)
+{
+	int id = event.GetId();
+	bool isReload = id >= TAB_COMPRESSION_RELOAD;
+	Oodle::CompressionSettings& settings = isReload ? activeTab->reloadCompression : activeTab->saveCompression;
+	int offset = id - (isReload ? TAB_COMPRESSION_RELOAD : TAB_COMPRESSION_SAVE);
+
+	if(offset < COMPRESSIONMENU_LEVELS)
+		settings.compressor = Oodle::CompressorList[offset];
+	else settings.level = offset - COMPRESSIONMENU_LEVELS;
+
+	if(!isReload && activeTab->compressOnSave)
+		activeTab->Parser->MarkFileOutdated(); // Allows re-saving an unedited file with the new settings
+}
+
+void EntityFrame::onCompressionBenchmark(wxCommandEvent& event)
+{
+	activeTab->benchmarkCompression();
+	CheckCompressionMenu(tabMenu, TAB_COMPRESSION_RELOAD, activeTab->reloadCompression);
+}
+
 void EntityFrame::onNumberListCheck(wxCommandEvent& event)
 {
 	activeTab->autoNumberLists = event.IsChecked();
@@ -798,14 +998,14 @@ void EntityFrame::onReloadMH(wxCommandEvent& event)
 	switch (Meathook::IsOnline())
 	{
 		case game_eternal:
-		mhTab->saveFile();
+		mhTab->saveFile(true);
 		success = Meathook::ReloadMap(std::string(mhTab->filePath));
 		break;
 
 		// For Dark Ages, we do not pass a file to Kaibz Mod
 		// So just save the active tab instead
 		case game_darkages:
-		activeTab->saveFile();
+		activeTab->saveFile(true);
 		success = Meathook::ReloadMap("");
 		break;
 
@@ -853,6 +1053,43 @@ void EntityFrame::onActiveEncounterMenu(wxCommandEvent& event)
 	activeTab->Parser->FilteredSearch("entityDef" + activeEncounters[event.GetId()], false, true, true);
 }
 
+void EntityFrame::onFindNearestEntities(wxCommandEvent& event)
+{
+	const size_t NEAREST_COUNT = 15;
+
+	if (!Meathook::CopySpawnPosition()) {
+		wxMessageBox("Couldn't get spawnPosition. Is Meathook offline?", "Meathook Interface", wxICON_WARNING | wxOK);
+		return;
+	}
+
+	std::vector<EntNode*> nearest;
+	if (!activeTab->nearestSpawninfo(NEAREST_COUNT, nearest)) {
+		wxLogMessage("Couldn't read the player's spawnPosition");
+		return;
+	}
+	if (nearest.empty()) {
+		wxLogMessage("No entities in this tab have a spawnPosition");
+		return;
+	}
+
+	// Prompt the user to choose one to jump to, nearest first
+	nearestEntities.clear();
+	wxMenu nearestMenu;
+	for (int i = 0, max = nearest.size(); i < max; i++) {
+		nearestEntities.push_back(std::string((*nearest[i])["entityDef"].getValue()));
+		nearestMenu.Append(i, nearestEntities[i]);
+	}
+
+	nearestMenu.Bind(wxEVT_COMMAND_MENU_SELECTED, &EntityFrame::onNearestEntityMenu, this);
+	PopupMenu(&nearestMenu);
+}
+
+void EntityFrame::onNearestEntityMenu(wxCommandEvent& event)
+{
+	wxLogMessage("Searching this tab for entity...");
+	activeTab->Parser->FilteredSearch("entityDef" + nearestEntities[event.GetId()], false, true, true);
+}
+
 void EntityFrame::onGetSpawnPosition(wxCommandEvent &event) 
 {
 	if(!Meathook::CopySpawnPosition())
@@ -892,6 +1129,7 @@ void EntityFrame::RefreshMHMenu()
 	mhMenu->Enable(MEATHOOK_RELOAD, online && game == game_darkages || (activeTab == mhTab && game == game_eternal)); // For simplicity, only enable this option when mhTab is the activeTab
 	mhMenu->Enable(MEATHOOK_OPENFILE, online && game != game_darkages);
 	mhMenu->Enable(MEATHOOK_GET_ENCOUNTER, online);
+	mhMenu->Enable(MEATHOOK_GET_NEAREST, online);
 	mhMenu->Enable(MEATHOOK_GET_SPAWNPOSITION, online);
 	mhMenu->Enable(MEATHOOK_GET_SPAWNPOSITION_FILTER, online);
 	mhMenu->Enable(MEATHOOK_GET_SPAWNORIENTATION, online);
@@ -4,7 +4,12 @@
 #include "wx/aui/auibook.h"
 #include "wx/display.h"
 #include "wx/timer.h"
+#include <thread>
+#include <atomic>
+#include <memory>
 
+class wxProgressDialog;
+class EntityParser;
 class EntityTab;
 class EntityFrame : public wxFrame
 {
@@ -17,6 +22,7 @@ class EntityFrame : public wxFrame
 	wxTextCtrl* log = nullptr;
 	wxStatusBar* statusbar = nullptr;
 	std::vector<std::string> activeEncounters;
+	std::vector<std::string> nearestEntities;
 
 	// Meathook
 	EntityTab* mhTab = nullptr;
@@ -24,6 +30,26 @@ class EntityFrame : public wxFrame
 	wxTimer mhStatusTimer;
 	wxString mhText_Preface;
 
+	// Files being read and parsed in the background
+	struct {
+		std::thread worker;
+		std::atomic<bool> cancel{false}; // Files that haven't started parsing are skipped
+		wxArrayString paths;
+		size_t opened = 0;
+		size_t finished = 0;             // Opened or failed
+		wxString failures;               // Names and errors of the files that couldn't be opened
+		wxProgressDialog* progress = nullptr;
+		wxTimer progressTimer;           // Keeps the dialog's cancel button and elapsed time responsive
+		bool updating = false;           // The dialog's Update is running queued callbacks
+		bool finishDeferred = false;     // finishOpenJob was called during an Update
+		std::shared_ptr<bool> alive = std::make_shared<bool>(true); // Queued callbacks hold weak references to this
+	} openJob;
+
+	void onFileParsed(size_t index, EntityParser* parsed, const std::string& error);
+	void updateOpenProgress(const wxString& message);
+	void finishOpenJob();
+	void stopOpenJob();
+
 	public:
 	EntityFrame();
 	~EntityFrame();
@@ -36,6 +62,7 @@ class EntityFrame : public wxFrame
 	void onFileNew(wxCommandEvent& event);
 	void openFiles(const wxArrayString& filepaths);
 	void onOpenConfig(wxCommandEvent& event);
+	void onOpenProgress(wxTimerEvent& event);
 	void onFileOpen(wxCommandEvent& event);
 	void onFileOpenFolder(wxCommandEvent& event);
 	void detectExternalEdits();
@@ -46,6 +73,8 @@ class EntityFrame : public wxFrame
 	void onFileSaveAs(wxCommandEvent& event);
 	void onReloadConfigFile(wxCommandEvent &event);
 	void onCompressCheck(wxCommandEvent& event);
+	void onCompressionSelect(wxCommandEvent& event);
+	void onCompressionBenchmark(wxCommandEvent& event);
 	void onNumberListCheck(wxCommandEvent& event);
 	void onExportDiff(wxCommandEvent& event);
 	void onImportDiff(wxCommandEvent& event);
@@ -59,6 +88,8 @@ class EntityFrame : public wxFrame
 	void onReloadMH(wxCommandEvent& event);
 	void onPrintActiveEncounters(wxCommandEvent &event);
 	void onActiveEncounterMenu(wxCommandEvent &event);
+	void onFindNearestEntities(wxCommandEvent &event);
+	void onNearestEntityMenu(wxCommandEvent &event);
 	void onGetSpawnPosition(wxCommandEvent &event);
 	void onGetSpawnOrientation(wxCommandEvent &event);
 	void onSpawnOffsetCheck(wxCommandEvent &event);
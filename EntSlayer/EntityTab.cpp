@@ -1,8 +1,10 @@
+#include <chrono>
 #include "wx/clipbrd.h"
 #include "wx/collpane.h"
 #include "wx/splitter.h"
 #include "EntityTab.h"
 #include "EntityEditor.h"
+#include "EntityTreeView.h"
 #include "FilterMenus.h"
 #include "Config.h"
 #include "Meathook.h"
@@ -75,23 +77,31 @@ wxBEGIN_EVENT_TABLE(EntityTab, wxPanel)
 	EVT_MENU_RANGE(TABID_MAXIMUM, MAXSHORT, onNodeContextAccelerator)
 wxEND_EVENT_TABLE()
 
+ParsingMode EntityTab::FileMode(const wxString& path)
+{
+	wxString lowercase = path.Lower();
+	if(lowercase.EndsWith(".entities"))
+		return ParsingMode::ENTITIES;
+	if(lowercase.EndsWith(".json"))
+		return ParsingMode::JSON;
+	return ParsingMode::PERMISSIVE;
+}
+
 EntityTab::EntityTab(wxWindow* parent, const wxString name, const wxString& path)
-	: wxPanel(parent, wxID_ANY), tabName(name), filePath(path)
+	: EntityTab(parent, name, path, path == "" ? new EntityParser()
+		: new EntityParser(std::string(path), FileMode(path), true))
+{
+}
+
+EntityTab::EntityTab(wxWindow* parent, const wxString name, const wxString& path, EntityParser* parsed)
+	: wxPanel(parent, wxID_ANY), tabName(name), filePath(path), Parser(parsed)
 {
-	/* Initialize parser */
-	if (path == "")
-		Parser = new EntityParser();
-	else  { // Todo: Hide filters if permissive mode is enabled?
-		ParsingMode mode = ParsingMode::PERMISSIVE;
+	/* Warn about files the parser isn't made for */
+	if (path != "") { // Todo: Hide filters if permissive mode is enabled?
+		ParsingMode mode = Parser->getMode();
 		wxString lowercase = filePath.Lower();
 
-		if(lowercase.EndsWith(".entities")) {
-			mode = ParsingMode::ENTITIES;
-		}
-		else if (lowercase.EndsWith(".json")) {
-			mode = ParsingMode::JSON;
-		}
-		else if (!lowercase.EndsWith(".txt") && !lowercase.EndsWith(".mapentities")) {
+		if (mode == ParsingMode::PERMISSIVE && !lowercase.EndsWith(".txt") && !lowercase.EndsWith(".mapentities")) {
 			wxLogMessage("WARNING: Unsupported filetype detected. Permissive parsing mode enabled. Please verify data integrity when done editing.");
 		}
 
@@ -99,8 +109,6 @@ EntityTab::EntityTab(wxWindow* parent, const wxString name, const wxString& path
 			wxLogMessage("WARNING: Non-entities file detected. Automatic list renumbering has been disabled (re-enable it in the 'Tab' menu)");
 			autoNumberLists = false;
 		}
-
-		Parser = new EntityParser(std::string(path), mode, true);
 		//openTime = std::filesystem::last_write_time(std::string(path));
 	}
 
@@ -166,6 +174,10 @@ EntityTab::EntityTab(wxWindow* parent, const wxString name, const wxString& path
 
 		/* Search Bar */
 		searchBar = new SearchBar(this, topWindow);
+		queryBar = new QueryBar(this, topWindow);
+		wxBoxSizer* searchColumn = new wxBoxSizer(wxVERTICAL);
+		searchColumn->Add(searchBar, 0, wxEXPAND);
+		searchColumn->Add(queryBar, 0, wxEXPAND | wxTOP, 10);
 
 		/* Assemble everything into sizers */
 		wxBoxSizer* firstRowSizer = new wxBoxSizer(wxHORIZONTAL);
@@ -185,7 +197,7 @@ EntityTab::EntityTab(wxWindow* parent, const wxString name, const wxString& path
 		secondRowSizer->Add(instanceidMenu->container, 33, wxALL, 10);
 		secondRowSizer->Add(textFilterSizer, 22, wxALL, 10);
 		secondRowSizer->Add(compact, 22, wxTOP | wxBOTTOM | wxLEFT, 10);
-		secondRowSizer->Add(searchBar, 22, wxTOP | wxBOTTOM | wxRIGHT, 10);
+		secondRowSizer->Add(searchColumn, 22, wxTOP | wxBOTTOM | wxRIGHT, 10);
 
 		/* Put everything together */
 		wxBoxSizer* topSizer = new wxBoxSizer(wxVERTICAL);
@@ -206,7 +218,7 @@ EntityTab::EntityTab(wxWindow* parent, const wxString name, const wxString& path
 	/* Initialize controls */
 	wxSplitterWindow* splitter = new wxSplitterWindow(this);
 	editor = new EntityEditor(splitter, wxID_ANY, wxDefaultPosition, wxSize(300, 300));
-	view = new wxDataViewCtrl(splitter, wxID_ANY, wxDefaultPosition, wxSize(300, 300), wxDV_MULTIPLE);
+	view = new EntityTreeView(splitter, wxID_ANY, wxDefaultPosition, wxSize(300, 300));
 	Parser->view = view;
 	view->GetMainWindow()->Bind(wxEVT_CHAR, &EntityTab::onDataviewChar, this);
 	view->GetMainWindow()->Bind(wxEVT_RIGHT_DOWN, &EntityTab::onViewRightMouseDown, this);
@@ -231,18 +243,6 @@ EntityTab::EntityTab(wxWindow* parent, const wxString name, const wxString& path
 	}
 	/* Initialize View */
 	{
-		// Column 0
-		wxDataViewTextRenderer* tr = new wxDataViewTextRenderer("string");
-		wxDataViewColumn* col = new wxDataViewColumn("Key", tr, 0, FromDIP(350), wxALIGN_LEFT, wxDATAVIEW_COL_RESIZABLE);
-		col->SetMinWidth(FromDIP(150));
-		view->AppendColumn(col);
-
-		// Column 1
-		tr = new wxDataViewTextRenderer("string");
-		col = new wxDataViewColumn("Value", tr, 1, FromDIP(350), wxALIGN_LEFT, wxDATAVIEW_COL_RESIZABLE);
-		col->SetMinWidth(FromDIP(150));
-		view->AppendColumn(col);
-
 		//#if wxUSE_DRAG_AND_DROP && wxUSE_UNICODE
 		//e_ctrl->EnableDragSource(wxDF_UNICODETEXT);
 		//e_ctrl->EnableDropTarget(wxDF_UNICODETEXT);
@@ -254,10 +254,20 @@ EntityTab::EntityTab(wxWindow* parent, const wxString name, const wxString& path
 	splitter->SetMinimumPaneSize(20);
 	splitter->SetSashGravity(0.5);
 	splitter->SplitVertically(view, editor);
+	savedQueries = new SavedQueries(this, this);
+	findAllResults = new FindAllResults(this, this);
+
+	wxBoxSizer* sideSizer = new wxBoxSizer(wxVERTICAL);
+	sideSizer->Add(savedQueries, 1, wxEXPAND);
+	sideSizer->Add(findAllResults, 2, wxEXPAND | wxTOP, 10);
+
+	wxBoxSizer* bottomSizer = new wxBoxSizer(wxHORIZONTAL);
+	bottomSizer->Add(sideSizer, 0, wxEXPAND | wxALL, 5);
+	bottomSizer->Add(splitter, 1, wxEXPAND | wxALL, 5);
 
 	wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
 	sizer->Add(topWrapper, 0, wxEXPAND | wxALL, 5);
-	sizer->Add(splitter, 1, wxEXPAND | wxALL, 5);
+	sizer->Add(bottomSizer, 1, wxEXPAND);
 	SetSizerAndFit(sizer);
 	NightMode(false);
 }
@@ -297,6 +307,9 @@ void EntityTab::NightMode(bool recursive) {
 	//searchBar->input->Refresh();
 	searchBar->label->SetForegroundColour(LabelColor);
 	searchBar->caseSensitiveCheck->SetForegroundColour(LabelColor);
+	queryBar->label->SetForegroundColour(LabelColor);
+	savedQueries->label->SetForegroundColour(LabelColor);
+	findAllResults->label->SetForegroundColour(LabelColor);
 
 	FilterCtrl* filters[] = {layerMenu, classMenu, inheritMenu, componentMenu, keyMenu, instanceidMenu};
 	for (int i = 0; i < sizeof(filters) / sizeof(filters[0]); i++) {
@@ -398,8 +411,8 @@ void EntityTab::onFilterClearAll(wxCommandEvent& event)
 	applyFilters(true);
 }
 
-/* Populates the Spawn Position Filter data from mh_spawninfo spawnposition clipboard data*/
-void EntityTab::filterSetSpawninfo()
+/* Reads the coordinates from mh_spawninfo spawnposition clipboard data */
+void readSpawninfo(std::string& x, std::string& y, std::string& z)
 {
 	// Todo: should probably add more safety checks
 	wxClipboard* clipboard = wxTheClipboard->Get();
@@ -411,19 +424,47 @@ void EntityTab::filterSetSpawninfo()
 	// We assume the clipboard only contains spawnPosition, not spawnOrientation too
 	size_t xIndex = text.find("x = ") + 4;
 	size_t xLen = text.find(';', xIndex) - xIndex;
-	std::string x = text.substr(xIndex, xLen);
+	x = text.substr(xIndex, xLen);
 
 	size_t yIndex = text.find("y = ") + 4;
 	size_t yLen = text.find(';', yIndex) - yIndex;
-	std::string y = text.substr(yIndex, yLen);
+	y = text.substr(yIndex, yLen);
 
 	size_t zIndex = text.find("z = ") + 4;
 	size_t zLen = text.find(';', zIndex) - zIndex;
-	std::string z = text.substr(zIndex, zLen);
+	z = text.substr(zIndex, zLen);
+}
 
+/* Populates the Spawn Position Filter data from mh_spawninfo spawnposition clipboard data*/
+void EntityTab::filterSetSpawninfo()
+{
+	std::string x, y, z;
+	readSpawninfo(x, y, z);
 	spawnMenu->setData(x, y, z);
 }
 
+/*
+* Finds the entities nearest to the mh_spawninfo spawnposition clipboard data
+* @return False if the clipboard's position couldn't be read
+*/
+bool EntityTab::nearestSpawninfo(size_t count, std::vector<EntNode*>& nearest)
+{
+	std::string x, y, z;
+	readSpawninfo(x, y, z);
+
+	float fx, fy, fz;
+	try {
+		fx = std::stof(x);
+		fy = std::stof(y);
+		fz = std::stof(z);
+	}
+	catch (std::exception) {
+		return false;
+	}
+	Parser->getFacets().Nearest(fx, fy, fz, count, nearest);
+	return true;
+}
+
 void EntityTab::applyFilters(bool clearAll)
 {
 	/*
@@ -440,31 +481,28 @@ void EntityTab::applyFilters(bool clearAll)
 		instanceidMenu->uncheckAll();
 		keyMenu->uncheckAll();
 		spawnMenu->deactivate();
+		queryBar->input->Clear();
 	}
 
-	Sphere newSphere;
-	bool filterSpawns = spawnMenu->activated() && spawnMenu->getData(newSphere);
+	std::vector<Sphere> spawnSpheres;
+	std::vector<Box> spawnBoxes;
+	bool filterSpawns = spawnMenu->activated() && spawnMenu->getData(spawnSpheres, spawnBoxes);
 
-	Parser->SetFilters(layerMenu->list, classMenu->list, inheritMenu->list, componentMenu->list, instanceidMenu->list,
-		filterSpawns, newSphere, keyMenu->list, caseSensCheck->IsChecked());
-	wxDataViewItem p(nullptr); // Todo: should try to improve this so we don't destroy entire root
-	wxDataViewItem r(root);
-	Parser->ItemDeleted(p, r);
-	Parser->ItemAdded(p, r);
-	view->Expand(r);
+	std::shared_ptr<const EntityQuery> query;
+	const std::string queryText(queryBar->input->GetValue());
+	if (queryText.find_first_not_of(" \t") != std::string::npos) {
+		try {
+			query = std::make_shared<const EntityQuery>(queryText);
+		}
+		catch (std::runtime_error& e) {
+			wxMessageBox(e.what(), "Query Failed", wxICON_WARNING | wxOK | wxCENTER, this);
+			return;
+		}
+	}
 
-	/*
-	* Weird issue reproduced by using shift-click to select a large block of nodes,
-	* deleting them, then changing the filters. Large block of unrelated nodes would
-	* become selected afterwards, and would be more "difficult" to deselect than normal
-	* (i.e. simply left clicking on one wouldn't deselect all the others). UnselectAll
-	* also doesn't seem to work on these, must instead set selections to nothing.
-	* 
-	* Todo: Monitor for more reports of this issue, see if it crops up elsewhere.
-	* Try to find the actual root cause instead of applying this bandaid fix
-	*/
-	wxDataViewItemArray empty;
-	view->SetSelections(empty);
+	// Applied in the background - the view refreshes once every entity has been checked
+	Parser->SetFilters(layerMenu->list, classMenu->list, inheritMenu->list, componentMenu->list, instanceidMenu->list,
+		filterSpawns, spawnSpheres, spawnBoxes, keyMenu->list, caseSensCheck->IsChecked(), query);
 }
 
 void EntityTab::SearchForward()
@@ -481,6 +519,8 @@ void EntityTab::reloadFile()
 {
 	try {
 		EntityParser* reloaded = new EntityParser(std::string(filePath), Parser->getMode(), true);
+		for(const EntityIndex::View& v : Parser->getFacets().GetViews())
+			reloaded->SaveView(v.name, v.query);
 		editor->SetActiveNode(nullptr);
 		Parser = reloaded;
 		root = reloaded->getRoot();
@@ -490,6 +530,8 @@ void EntityTab::reloadFile()
 		view->AssociateModel(reloaded);
 		view->Expand(wxDataViewItem(root));
 		applyFilters(false);
+		savedQueries->refresh();
+		findAllResults->refresh();
 	}
 	catch (std::runtime_error e) {
 		wxString msg = wxString::Format("File Reload Cancelled\n\n%s", e.what());
@@ -499,8 +541,10 @@ void EntityTab::reloadFile()
 
 /*
 * Returns true if the file was saved, otherwise false
+* @param forReload If true, the file is being saved so the game can reload it,
+* and is compressed with the tab's (faster) reload settings
 */
-bool EntityTab::saveFile()
+bool EntityTab::saveFile(bool forReload)
 {
 	if (filePath == "") return false;
 
@@ -510,7 +554,8 @@ bool EntityTab::saveFile()
 
 	if (Parser->FileUpToDate()) return false; // Need to check this when commitResult <= 0
 
-	Parser->WriteToFile(std::string(filePath), compressOnSave && !compressOnSave_ForceDisable);
+	Parser->WriteToFile(std::string(filePath), compressOnSave && !compressOnSave_ForceDisable, 
+		forReload ? reloadCompression : saveCompression);
 
 	if (commitResult < 0) // Logic Error: This won't pop up if editor is bugged while file is up to date
 		wxMessageBox("File was saved. But you must fix syntax errors before saving contents of text box.",
@@ -520,6 +565,72 @@ bool EntityTab::saveFile()
 	return true;
 }
 
+/*
+* Compresses the current tree with every level of the save compressor, logging
+* the throughput and ratio of each. The fastest level that actually compresses
+* becomes the tab's reload compression setting.
+*/
+void EntityTab::benchmarkCompression()
+{
+	int commitResult = CommitEdits();
+	if (commitResult < 0) {
+		wxLogMessage("Fix syntax errors before benchmarking compression");
+		return;
+	}
+	if (commitResult > 0)
+		editor->SetActiveNode(nullptr);
+
+	wxBusyCursor wait;
+	std::string raw = root->toString();
+	if (raw.empty())
+		return;
+
+	char* compressed = new char[raw.length() + 65536];
+	char* decompressed = new char[raw.length()];
+	const double megabytes = raw.length() / (1024.0 * 1024.0);
+	const int compressor = saveCompression.compressor;
+
+	wxLogMessage("Benchmarking %s compression (%.2f MB)", Oodle::CompressorName(compressor), megabytes);
+	int fastestLevel = -1;
+	double fastestSpeed = 0;
+	for (int level = Oodle::LEVEL_NONE; level < Oodle::LEVEL_COUNT; level++)
+	{
+		Oodle::CompressionSettings settings = {compressor, level};
+		size_t compressedSize = 0;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		bool success = Oodle::CompressBuffer(raw.data(), raw.length(), compressed, compressedSize, settings);
+		auto middle = std::chrono::high_resolution_clock::now();
+		success = success && Oodle::DecompressBuffer(compressed, compressedSize, decompressed, raw.length());
+		auto stop = std::chrono::high_resolution_clock::now();
+
+		if (!success) {
+			wxLogMessage("%-10s: Failed", Oodle::LevelName(level));
+			continue;
+		}
+
+		double compressSeconds = std::chrono::duration<double>(middle - start).count();
+		double decompressSeconds = std::chrono::duration<double>(stop - middle).count();
+		double compressSpeed = compressSeconds > 0 ? megabytes / compressSeconds : 0;
+		double decompressSpeed = decompressSeconds > 0 ? megabytes / decompressSeconds : 0;
+		wxLogMessage("%-10s: Compress %8.2f MB/s | Decompress %8.2f MB/s | Ratio %.3f", Oodle::LevelName(level),
+			compressSpeed, decompressSpeed, (double)compressedSize / raw.length());
+
+		// Level None only copies the input, so it's never picked for reloads
+		if (level != Oodle::LEVEL_NONE && compressedSize < raw.length() && compressSpeed > fastestSpeed) {
+			fastestSpeed = compressSpeed;
+			fastestLevel = level;
+		}
+	}
+	delete[] compressed;
+	delete[] decompressed;
+
+	if (fastestLevel >= 0) {
+		reloadCompression = {compressor, fastestLevel};
+		wxLogMessage("Reload saves will now use %s %s", Oodle::CompressorName(compressor), Oodle::LevelName(fastestLevel));
+	}
+}
+
 /*
 * Returns 0 if there was nothing to commit
 * Returns Positive value if commit was successful
@@ -530,11 +641,9 @@ int EntityTab::CommitEdits()
 	//wxLogMessage("CommitEdits");
 	if (!editor->Modified()) return 0;
 
+	// Only the parts of the node that changed are edited
 	EntNode* replacing = editor->Node();
-	EntNode* parent = replacing->getParent();
-	int replacingIndex = parent->getChildIndex(replacing);
-
-	ParseResult outcome = Parser->EditTree(std::string(editor->GetText()), parent, replacingIndex, 1, autoNumberLists, false);
+	ParseResult outcome = Parser->EditNodeText(std::string(editor->GetText()), replacing, autoNumberLists, false);
 	if (!outcome.success)
 	{
 		editor->setAnnotationError(outcome.errorLineNum, outcome.errorMessage);
@@ -688,7 +797,9 @@ void EntityTab::onNodeDoubleClick(wxDataViewEvent& event)
 void EntityTab::onExpandEntity(wxCommandEvent& event)
 {
 	// This is probably okay to do...
-	wxDataViewEvent temp(wxEVT_DATAVIEW_ITEM_ACTIVATED, view, view->GetCurrentItem());
+	wxDataViewEvent temp;
+	temp.SetEventType(wxEVT_DATAVIEW_ITEM_ACTIVATED);
+	temp.SetItem(view->GetCurrentItem());
 	onNodeDoubleClick(temp);
 }
 
@@ -890,9 +1001,8 @@ void EntityTab::onPaste(wxCommandEvent& event)
 
 void EntityTab::onSelectAllEntities(wxCommandEvent& event)
 {
-	wxDataViewItemArray rootChildren;
-	Parser->GetChildren(wxDataViewItem(root), rootChildren);
-	view->SetSelections(rootChildren);
+	view->UnselectAll();
+	view->SelectChildren(wxDataViewItem(root));
 }
 
 void EntityTab::onDeleteSelectedNodes(wxCommandEvent& event)
@@ -903,6 +1013,7 @@ void EntityTab::onDeleteSelectedNodes(wxCommandEvent& event)
 
 	int numDeletions = 0;
 	editor->SetActiveNode(nullptr);
+	EntityParser::NotificationBatch batch(Parser.get());
 	for (wxDataViewItem item : selections) {
 		EntNode* node = (EntNode*)item.GetID();
 		if (node == root)
@@ -1136,6 +1247,7 @@ void EntityTab::action_PropMovers()
 
 	wxLogMessage("Creating idMovers for %zu idProp2 entities. This may take some time - please be patient.", propsUsed.size());
 
+	EntityParser::NotificationBatch batch(Parser.get());
 	EntNode* version = root->ChildAt(0);
 	ParseResult result = Parser->EditTree(movers, root, 0, 0, false, true);
 	int moversAdded = root->getChildIndex(version);
@@ -1183,6 +1295,7 @@ void EntityTab::action_FixTraversals()
 	editor->SetActiveNode(nullptr);
 
 	int numNodes = 0;
+	EntityParser::NotificationBatch batch(Parser.get());
 	for (int i = 0, max = root->getChildCount(); i < max; i++) 
 	{
 		EntNode* entity = root->ChildAt(i);
@@ -1218,12 +1331,23 @@ void EntityTab::exportdiff()
 	if(diffdialog.ShowModal() == wxID_CANCEL)
 		return;
 	
+	std::unique_ptr<EntityParser> moddedparser;
 	try {
-		EntityParser moddedparser(moddeddialog.GetPath().ToStdString(), Parser->getMode(), false);
-		EntityDiff::Export(*Parser->getRoot(), *moddedparser.getRoot(), diffdialog.GetPath().ToStdString().c_str());
+		moddedparser.reset(new EntityParser(moddeddialog.GetPath().ToStdString(), Parser->getMode(), false));
 	}
 	catch (...) {
 		wxLogMessage("EntityDiff: Failed to parse modded file");
+		return;
+	}
+
+	// Exporting can fail on text a diff can't hold, such as a tree diff's verbatim strings containing %>
+	try {
+		if(Parser->getMode() == ParsingMode::ENTITIES)
+			EntityDiff::Export(*Parser->getRoot(), *moddedparser->getRoot(), diffdialog.GetPath().ToStdString().c_str());
+		else EntityDiff::ExportTree(*Parser->getRoot(), *moddedparser->getRoot(), diffdialog.GetPath().ToStdString().c_str());
+	}
+	catch (std::runtime_error& e) {
+		wxLogMessage("%s", e.what());
 	}
 }
 
@@ -1234,8 +1358,9 @@ void EntityTab::importdiff()
 		return;
 	}
 
-	wxFileDialog diffdialog(this, "Select Diff To Import", wxEmptyString, wxEmptyString,
-		"Diff Files|*.diff", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+	// Selecting multiple diffs merges them, skipping changes that conflict with each other
+	wxFileDialog diffdialog(this, "Select Diffs To Import", wxEmptyString, wxEmptyString,
+		"Diff Files|*.diff", wxFD_OPEN | wxFD_FILE_MUST_EXIST | wxFD_MULTIPLE);
 
 	if(diffdialog.ShowModal() == wxID_CANCEL)
 		return;
@@ -1246,11 +1371,40 @@ void EntityTab::importdiff()
 	if(logdialog.ShowModal() == wxID_CANCEL)
 		return;
 
-	try {
-		EntityParser diffdata(diffdialog.GetPath().ToStdString(), ParsingMode::PERMISSIVE, false);
-		EntityDiff::Import(*Parser, *diffdata.getRoot(), logdialog.GetPath().ToStdString().c_str(), filePath.ToStdString().c_str());
+	wxArrayString diffpaths;
+	diffdialog.GetPaths(diffpaths);
+
+	std::vector<std::unique_ptr<EntityParser>> diffdata;
+	std::vector<const EntNode*> diffs;
+	std::vector<std::string> diffnames;
+	for (const wxString& path : diffpaths) {
+		try {
+			diffdata.emplace_back(new EntityParser(path.ToStdString(), ParsingMode::PERMISSIVE, false));
+		}
+		catch (...) {
+			wxLogMessage("EntityDiff: Failed to parse diff file %s", path);
+			return;
+		}
+		diffs.push_back(diffdata.back()->getRoot());
+		diffnames.push_back(path.AfterLast(wxFILE_SEP_PATH).ToStdString());
 	}
-	catch (...) {
-		wxLogMessage("EntityDiff: Failed to parse diff file");
+
+	// Tree diffs don't have entities to check for conflicts, so they're applied one after another
+	std::string logpath = logdialog.GetPath().ToStdString();
+	std::vector<const EntNode*> entitydiffs;
+	std::vector<std::string> entitydiffnames;
+	EntityParser::NotificationBatch batch(Parser.get());
+	for (size_t i = 0; i < diffs.size(); i++) {
+		if (EntityDiff::IsTreeDiff(*diffs[i]))
+			EntityDiff::ImportTree(*Parser, *diffs[i], logpath.c_str(), filePath.ToStdString().c_str());
+		else {
+			entitydiffs.push_back(diffs[i]);
+			entitydiffnames.push_back(diffnames[i]);
+		}
 	}
+
+	if (entitydiffs.size() == 1)
+		EntityDiff::Import(*Parser, *entitydiffs[0], logpath.c_str(), filePath.ToStdString().c_str());
+	else if(entitydiffs.size() > 1)
+		EntityDiff::ImportMany(*Parser, entitydiffs, entitydiffnames, logpath.c_str(), filePath.ToStdString().c_str());
 }
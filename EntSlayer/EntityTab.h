@@ -5,9 +5,13 @@ class EntityParser;
 class wxGenericCollapsiblePane;
 class wxCollapsiblePaneEvent;
 class EntityEditor;
+class EntityTreeView;
 class FilterCtrl;
 class SpawnFilter;
 class SearchBar;
+class QueryBar;
+class SavedQueries;
+class FindAllResults;
 class EntityTab : public wxPanel
 {
 	public:
@@ -16,6 +20,8 @@ class EntityTab : public wxPanel
 	//std::filesystem::file_time_type openTime = std::filesystem::file_time_type::min();
 	bool compressOnSave;
 	bool compressOnSave_ForceDisable = false; // If true, disables compression regardless of setting
+	Oodle::CompressionSettings saveCompression;   // Used by regular saves
+	Oodle::CompressionSettings reloadCompression = {Oodle::COMPRESSOR_KRAKEN, Oodle::LEVEL_SUPERFAST}; // Used when saving for a level reload
 	bool autoNumberLists = true;
 
 	FilterCtrl* layerMenu;
@@ -27,6 +33,9 @@ class EntityTab : public wxPanel
 	wxCheckBox* caseSensCheck;
 	SpawnFilter* spawnMenu;
 	SearchBar* searchBar;
+	QueryBar* queryBar;
+	SavedQueries* savedQueries; // Side panel
+	FindAllResults* findAllResults; // Side panel
 	wxGenericCollapsiblePane* topWrapper; // Filter pane
 
 	wxMenu viewMenu;
@@ -34,10 +43,16 @@ class EntityTab : public wxPanel
 
 	EntNode* root;
 	wxObjectDataPtr<EntityParser> Parser; // Need this or model leaks when tab destroyed
-	wxDataViewCtrl* view;
+	EntityTreeView* view;
 	EntityEditor* editor;
 
 	EntityTab(wxWindow* parent, const wxString name, const wxString& path = "");
+
+	/* Builds a tab around a parser that's already read the file at path. The tab takes ownership of it */
+	EntityTab(wxWindow* parent, const wxString name, const wxString& path, EntityParser* parsed);
+
+	/* The mode a file should be parsed in, based on its extension */
+	static ParsingMode FileMode(const wxString& path);
 	void NightMode(bool recursive);
 	bool IsNewAndUntouched();
 	bool UnsavedChanges();
@@ -48,11 +63,13 @@ class EntityTab : public wxPanel
 	void onFilterRefresh(wxCommandEvent& event);
 	void onFilterClearAll(wxCommandEvent& event);
 	void filterSetSpawninfo();
+	bool nearestSpawninfo(size_t count, std::vector<EntNode*>& nearest);
 	void applyFilters(bool clearAll);
 	void SearchForward();
 	void SearchBackward();
 	void reloadFile();
-	bool saveFile();
+	bool saveFile(bool forReload = false);
+	void benchmarkCompression();
 	int CommitEdits();
 	void UndoRedo(bool undo);
 	void onDataviewChar(wxKeyEvent &event);
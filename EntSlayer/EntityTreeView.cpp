@@ -0,0 +1,987 @@
+#include "wx/dcbuffer.h"
+#include "wx/renderer.h"
+#include <algorithm>
+#include "EntityTreeView.h"
+#include "EntityParser.h"
+
+wxBEGIN_EVENT_TABLE(EntityTreeView, wxVScrolledWindow)
+	EVT_PAINT(EntityTreeView::onPaint)
+	EVT_LEFT_DOWN(EntityTreeView::onLeftDown)
+	EVT_LEFT_UP(EntityTreeView::onLeftUp)
+	EVT_LEFT_DCLICK(EntityTreeView::onLeftDoubleClick)
+	EVT_RIGHT_UP(EntityTreeView::onRightUp)
+	EVT_MOTION(EntityTreeView::onMotion)
+	EVT_MOUSE_CAPTURE_LOST(EntityTreeView::onCaptureLost)
+	EVT_SET_FOCUS(EntityTreeView::onFocus)
+	EVT_KILL_FOCUS(EntityTreeView::onFocus)
+	EVT_CHAR(EntityTreeView::onChar)
+wxEND_EVENT_TABLE()
+
+/*
+* Row List
+*/
+
+EntityTreeRows::Row EntityTreeRows::at(size_t index) const
+{
+	const Entry* e = top;
+	while (true) {
+		size_t leftCount = countOf(e->left);
+		if(index == leftCount)
+			return e->row;
+		if (index < leftCount)
+			e = e->left;
+		else {
+			index -= leftCount + 1;
+			e = e->right;
+		}
+	}
+}
+
+size_t EntityTreeRows::indexOf(const EntNode* node) const
+{
+	auto found = entries.find(node);
+	if(found == entries.end())
+		return npos;
+
+	const Entry* e = found->second;
+	size_t index = countOf(e->left);
+	for(; e->parent != nullptr; e = e->parent)
+		if(e == e->parent->right)
+			index += countOf(e->parent->left) + 1;
+	return index;
+}
+
+size_t EntityTreeRows::subtreeEnd(size_t index) const
+{
+	// The node's descendants are the rows after it that are deeper than it is
+	size_t end = firstAtMost(top, 0, index + 1, at(index).depth);
+	return end == npos ? size() : end;
+}
+
+/* Index of the first row at or after from with a depth no greater than depth, or npos */
+size_t EntityTreeRows::firstAtMost(const Entry* t, size_t offset, size_t from, int depth) const
+{
+	if(t == nullptr || t->minDepth > depth || offset + t->count <= from)
+		return npos;
+
+	size_t index = offset + countOf(t->left);
+	if (from < index) {
+		size_t found = firstAtMost(t->left, offset, from, depth);
+		if(found != npos)
+			return found;
+	}
+	if(index >= from && t->row.depth <= depth)
+		return index;
+	return firstAtMost(t->right, index + 1, from, depth);
+}
+
+void EntityTreeRows::assign(const std::vector<Row>& newRows)
+{
+	clear();
+	insert(0, newRows);
+}
+
+void EntityTreeRows::insert(size_t index, const std::vector<Row>& newRows)
+{
+	if(newRows.empty())
+		return;
+
+	Entry* middle = build(newRows.data(), newRows.size());
+	middle->parent = nullptr;
+	Entry *left, *right;
+	split(top, index, left, right);
+	top = merge(merge(left, middle), right);
+	top->parent = nullptr;
+}
+
+void EntityTreeRows::erase(size_t index, size_t count, std::vector<EntNode*>& removed)
+{
+	if(count == 0)
+		return;
+
+	Entry *left, *middle, *right;
+	split(top, index, left, middle);
+	split(middle, count, middle, right);
+	top = merge(left, right);
+	if(top != nullptr)
+		top->parent = nullptr;
+	destroy(middle, &removed);
+}
+
+void EntityTreeRows::clear()
+{
+	destroy(top, nullptr);
+	top = nullptr;
+	entries.clear();
+}
+
+void EntityTreeRows::update(Entry* e)
+{
+	e->count = 1;
+	e->minDepth = e->row.depth;
+	Entry* children[2] = {e->left, e->right};
+	for (Entry* c : children) {
+		if(c == nullptr)
+			continue;
+		e->count += c->count;
+		e->minDepth = std::min(e->minDepth, c->minDepth);
+		c->parent = e;
+	}
+}
+
+/* Splits the first index rows of t into left, and the rest into right */
+void EntityTreeRows::split(Entry* t, size_t index, Entry*& left, Entry*& right)
+{
+	if (t == nullptr) {
+		left = right = nullptr;
+		return;
+	}
+
+	size_t leftCount = countOf(t->left);
+	if (index <= leftCount) {
+		split(t->left, index, left, t->left);
+		right = t;
+	}
+	else {
+		split(t->right, index - leftCount - 1, t->right, right);
+		left = t;
+	}
+	update(t);
+	if(left != nullptr)
+		left->parent = nullptr;
+	if(right != nullptr)
+		right->parent = nullptr;
+}
+
+/*
+* Joins two trees, with left's rows first. The root is picked with odds in proportion to each
+* tree's size, which keeps the tree's depth logarithmic without storing priorities
+*/
+EntityTreeRows::Entry* EntityTreeRows::merge(Entry* left, Entry* right)
+{
+	if(left == nullptr)
+		return right;
+	if(right == nullptr)
+		return left;
+
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	if (seed % (left->count + right->count) < left->count) {
+		left->right = merge(left->right, right);
+		update(left);
+		return left;
+	}
+	right->left = merge(left, right->left);
+	update(right);
+	return right;
+}
+
+/* Builds a balanced tree from a run of rows */
+EntityTreeRows::Entry* EntityTreeRows::build(const Row* first, size_t count)
+{
+	if(count == 0)
+		return nullptr;
+
+	size_t middle = count / 2;
+	Entry* e = new Entry{first[middle], 1, 0, nullptr, nullptr, nullptr};
+	entries[first[middle].node] = e;
+	e->left = build(first, middle);
+	e->right = build(first + middle + 1, count - middle - 1);
+	update(e);
+	return e;
+}
+
+void EntityTreeRows::destroy(Entry* t, std::vector<EntNode*>* removed)
+{
+	std::vector<Entry*> stack;
+	if(t != nullptr)
+		stack.push_back(t);
+	while (!stack.empty()) {
+		Entry* e = stack.back();
+		stack.pop_back();
+		if(e->left != nullptr)
+			stack.push_back(e->left);
+		if(e->right != nullptr)
+			stack.push_back(e->right);
+		if (removed != nullptr) {
+			removed->push_back(e->row.node);
+			entries.erase(e->row.node);
+		}
+		delete e;
+	}
+}
+
+/*
+* Receives the parser's change notifications. Added and deleted nodes are spliced into the rows
+* or out of them. Clearing and resorting the model rebuilds the rows the next time they're needed
+*/
+class EntityTreeView::Notifier : public wxDataViewModelNotifier
+{
+	EntityTreeView* owner;
+
+	public:
+	Notifier(EntityTreeView* p_owner) : owner(p_owner) {}
+
+	bool ItemAdded(const wxDataViewItem& parent, const wxDataViewItem& item) override
+	{
+		wxDataViewItemArray items;
+		items.Add(item);
+		owner->addRows((EntNode*)parent.GetID(), items);
+		return true;
+	}
+
+	bool ItemsAdded(const wxDataViewItem& parent, const wxDataViewItemArray& items) override
+	{
+		owner->addRows((EntNode*)parent.GetID(), items);
+		return true;
+	}
+
+	// Deleted items may only be filtered out, so they keep their expansion. Freed
+	// nodes were already forgotten by the parser, before their memory could be reused
+	bool ItemDeleted(const wxDataViewItem& parent, const wxDataViewItem& item) override
+	{
+		owner->removeNodeRows((EntNode*)item.GetID());
+		return true;
+	}
+
+	bool ItemsDeleted(const wxDataViewItem& parent, const wxDataViewItemArray& items) override
+	{
+		for(const wxDataViewItem& item : items)
+			owner->removeNodeRows((EntNode*)item.GetID());
+		return true;
+	}
+
+	bool ItemChanged(const wxDataViewItem& item) override
+	{
+		owner->Refresh();
+		return true;
+	}
+
+	bool ItemsChanged(const wxDataViewItemArray& items) override
+	{
+		owner->Refresh();
+		return true;
+	}
+
+	bool ValueChanged(const wxDataViewItem& item, unsigned int col) override
+	{
+		owner->Refresh();
+		return true;
+	}
+
+	bool Cleared() override
+	{
+		owner->markOutdated();
+		return true;
+	}
+
+	void Resort() override
+	{
+		owner->markOutdated();
+	}
+};
+
+EntityTreeView::EntityTreeView(wxWindow* parent, wxWindowID id, const wxPoint& pos, const wxSize& size)
+	: wxVScrolledWindow(parent, id, pos, size, wxWANTS_CHARS | wxBORDER_THEME)
+{
+	SetBackgroundStyle(wxBG_STYLE_PAINT);
+	rowHeight = GetCharHeight() + FromDIP(4);
+	indent = FromDIP(16);
+	keyWidth = FromDIP(350);
+	minColumnWidth = FromDIP(150);
+
+	// The header is painted over the top of the window, so scrolling must repaint instead of moving pixels
+	EnablePhysicalScrolling(false);
+	SetRowCount(1);
+}
+
+EntityTreeView::~EntityTreeView()
+{
+	AssociateModel(nullptr);
+}
+
+void EntityTreeView::AssociateModel(EntityParser* p_model)
+{
+	if (model != nullptr) {
+		if(model->view == this)
+			model->view = nullptr;
+		model->RemoveNotifier(notifier); // Deletes the notifier
+		model->DecRef();
+	}
+
+	model = p_model;
+	notifier = nullptr;
+	if (model != nullptr) {
+		model->IncRef();
+		notifier = new Notifier(this);
+		model->AddNotifier(notifier);
+	}
+
+	expanded.clear();
+	selected.clear();
+	current = nullptr;
+	currentRow = 0;
+	anchorRow = 0;
+	markOutdated();
+}
+
+/*
+* Row Management
+*/
+
+void EntityTreeView::markOutdated()
+{
+	rowsOutdated = true;
+	Refresh();
+}
+
+void EntityTreeView::ForgetNode(EntNode* node)
+{
+	expanded.erase(node);
+	removeNodeRows(node);
+}
+
+/* Removes the rows of a node and it's descendants, without reading the node since it may already be freed */
+void EntityTreeView::removeNodeRows(EntNode* node)
+{
+	selected.erase(node);
+	if(current == node)
+		current = nullptr;
+
+	size_t index = rowsOutdated ? EntityTreeRows::npos : rows.indexOf(node);
+	if (index != EntityTreeRows::npos) {
+		removeRows(index, rows.subtreeEnd(index) - index);
+		rowsChanged();
+	}
+}
+
+void EntityTreeView::ensureRows()
+{
+	if(rowsOutdated)
+		buildRows();
+}
+
+void EntityTreeView::buildRows()
+{
+	rowsOutdated = false;
+	std::vector<Row> list;
+	if (model != nullptr) {
+		list.push_back({model->getRoot(), 0});
+		collectRows(model->getRoot(), 0, list);
+	}
+	rows.assign(list);
+
+	// Nodes inside collapsed or filtered-out parents can't stay selected
+	for (auto iter = selected.begin(); iter != selected.end(); ) {
+		if(!rows.contains(*iter))
+			iter = selected.erase(iter);
+		else iter++;
+	}
+	if(current != nullptr && !rows.contains(current))
+		current = nullptr;
+	rowsChanged();
+}
+
+/* Lists the rows below a node - it's filtered-in descendants inside expanded nodes */
+void EntityTreeView::collectRows(EntNode* node, int depth, std::vector<Row>& list)
+{
+	if(expanded.count(node) == 0)
+		return;
+
+	// Depth-first, pushing children in reverse so they're listed in order
+	std::vector<Row> stack;
+	EntNode** children = node->getChildBuffer();
+	for(int i = node->getChildCount() - 1; i >= 0; i--)
+		if(children[i]->isFilteredSelf())
+			stack.push_back({children[i], depth + 1});
+
+	while (!stack.empty()) {
+		Row row = stack.back();
+		stack.pop_back();
+		list.push_back(row);
+		if(expanded.count(row.node) == 0)
+			continue;
+
+		children = row.node->getChildBuffer();
+		for(int i = row.node->getChildCount() - 1; i >= 0; i--)
+			if(children[i]->isFilteredSelf())
+				stack.push_back({children[i], row.depth + 1});
+	}
+}
+
+/*
+* Splices in the rows of children that were added or filtered in. Each run of new children goes
+* in front of the next sibling that already has a row, or at the end of the parent's rows
+*/
+void EntityTreeView::addRows(EntNode* parent, const wxDataViewItemArray& items)
+{
+	if(rowsOutdated || expanded.count(parent) == 0)
+		return;
+	size_t parentRow = rows.indexOf(parent);
+	if(parentRow == EntityTreeRows::npos)
+		return;
+
+	std::unordered_set<const EntNode*> adding;
+	for (const wxDataViewItem& item : items) {
+		EntNode* node = (EntNode*)item.GetID();
+		if(node->isFilteredSelf() && !rows.contains(node))
+			adding.insert(node);
+	}
+	if(adding.empty())
+		return;
+
+	// Scans the children only as far as the sibling after the last new one
+	int depth = rows.at(parentRow).depth + 1;
+	size_t remaining = adding.size();
+	std::vector<Row> pending;
+	EntNode** children = parent->getChildBuffer();
+	for (int i = 0, max = parent->getChildCount(); i < max && (remaining > 0 || !pending.empty()); i++) {
+		EntNode* child = children[i];
+		if(!child->isFilteredSelf())
+			continue;
+
+		if (adding.count(child) > 0) {
+			pending.push_back({child, depth});
+			collectRows(child, depth, pending);
+			remaining--;
+		}
+		else if (!pending.empty()) {
+			size_t index = rows.indexOf(child);
+			if (index != EntityTreeRows::npos) {
+				rows.insert(index, pending);
+				pending.clear();
+			}
+		}
+	}
+	if(!pending.empty())
+		rows.insert(rows.subtreeEnd(rows.indexOf(parent)), pending);
+	rowsChanged();
+}
+
+/* Removes a run of rows, along with the selection and focus of their nodes */
+void EntityTreeView::removeRows(size_t index, size_t count)
+{
+	std::vector<EntNode*> removed;
+	rows.erase(index, count, removed);
+	for (EntNode* node : removed) {
+		selected.erase(node);
+		if(current == node)
+			current = nullptr;
+	}
+}
+
+/* Re-finds the focused row and resizes the scrolled area after rows are added or removed */
+void EntityTreeView::rowsChanged()
+{
+	// If the current node vanished, keyboard navigation carries on from the same row
+	if(current != nullptr)
+		currentRow = rows.indexOf(current);
+
+	size_t lastRow = rows.empty() ? 0 : rows.size() - 1;
+	currentRow = std::min(currentRow, lastRow);
+	anchorRow = std::min(anchorRow, lastRow);
+
+	// One extra unit makes room for the header
+	if(GetRowCount() != rows.size() + 1)
+		SetRowCount(rows.size() + 1);
+	Refresh();
+}
+
+void EntityTreeView::expandNode(EntNode* node)
+{
+	if(!expanded.insert(node).second || rowsOutdated)
+		return;
+
+	size_t index = rows.indexOf(node);
+	if (index != EntityTreeRows::npos) {
+		std::vector<Row> list;
+		collectRows(node, rows.at(index).depth, list);
+		rows.insert(index + 1, list);
+		rowsChanged();
+	}
+}
+
+void EntityTreeView::collapseNode(EntNode* node)
+{
+	if(expanded.erase(node) == 0 || rowsOutdated)
+		return;
+
+	size_t index = rows.indexOf(node);
+	if (index != EntityTreeRows::npos) {
+		removeRows(index + 1, rows.subtreeEnd(index) - index - 1);
+		rowsChanged();
+	}
+}
+
+/* Expands the node's ancestors from the root down, so each is spliced in below the last */
+void EntityTreeView::expandAncestors(EntNode* node)
+{
+	std::vector<EntNode*> ancestors;
+	for(EntNode* parent = node->getParent(); parent != nullptr; parent = parent->getParent())
+		if(expanded.count(parent) == 0)
+			ancestors.push_back(parent);
+
+	for(auto iter = ancestors.rbegin(); iter != ancestors.rend(); iter++)
+		expandNode(*iter);
+}
+
+void EntityTreeView::toggle(size_t row)
+{
+	EntNode* node = rows.at(row).node;
+	if(expanded.count(node) > 0)
+		collapseNode(node);
+	else expandNode(node);
+}
+
+void EntityTreeView::makeRowVisible(size_t row)
+{
+	size_t begin = GetVisibleRowsBegin();
+	size_t fullRows = std::max(1, GetClientSize().y / rowHeight - 1); // Less the header
+	if(row < begin)
+		ScrollToRow(row);
+	else if(row >= begin + fullRows)
+		ScrollToRow(row + 1 - fullRows);
+}
+
+void EntityTreeView::setCurrent(size_t row)
+{
+	current = rows.at(row).node;
+	currentRow = row;
+	makeRowVisible(row);
+	Refresh();
+}
+
+void EntityTreeView::selectRange(size_t from, size_t to)
+{
+	if(from > to)
+		std::swap(from, to);
+	for(size_t i = from; i <= to; i++)
+		selected.insert(rows.at(i).node);
+}
+
+bool EntityTreeView::sendEvent(wxEventType type, EntNode* node)
+{
+	wxDataViewEvent event;
+	event.SetEventType(type);
+	event.SetId(GetId());
+	event.SetEventObject(this);
+	event.SetItem(wxDataViewItem(node));
+	return GetEventHandler()->ProcessEvent(event);
+}
+
+int EntityTreeView::hitRow(int y)
+{
+	// Rows are drawn one row lower than wxVScrolledWindow places them, below the header
+	if(y < rowHeight)
+		return -1;
+	int row = VirtualHitTest(y - rowHeight);
+	if(row == wxNOT_FOUND || (size_t)row >= rows.size())
+		return -1;
+	return row;
+}
+
+bool EntityTreeView::hitsExpander(size_t row, int x)
+{
+	Row r = rows.at(row);
+	int left = r.depth * indent;
+	return x >= left && x < left + indent && r.node->IsContainer();
+}
+
+bool EntityTreeView::hitsDivider(int x)
+{
+	return std::abs(x - keyWidth) <= FromDIP(3);
+}
+
+/*
+* wxDataViewCtrl Interface
+*/
+
+void EntityTreeView::Expand(const wxDataViewItem& item)
+{
+	EntNode* node = (EntNode*)item.GetID();
+	expandAncestors(node);
+	expandNode(node);
+}
+
+void EntityTreeView::Collapse(const wxDataViewItem& item)
+{
+	collapseNode((EntNode*)item.GetID());
+}
+
+bool EntityTreeView::IsExpanded(const wxDataViewItem& item)
+{
+	ensureRows();
+	EntNode* node = (EntNode*)item.GetID();
+	return expanded.count(node) > 0 && rows.contains(node);
+}
+
+void EntityTreeView::EnsureVisible(const wxDataViewItem& item)
+{
+	EntNode* node = (EntNode*)item.GetID();
+	expandAncestors(node);
+	ensureRows();
+
+	size_t index = rows.indexOf(node);
+	if(index != EntityTreeRows::npos)
+		makeRowVisible(index);
+}
+
+wxDataViewItem EntityTreeView::GetCurrentItem()
+{
+	ensureRows();
+	return wxDataViewItem(current);
+}
+
+void EntityTreeView::SetCurrentItem(const wxDataViewItem& item)
+{
+	ensureRows();
+	EntNode* node = (EntNode*)item.GetID();
+	size_t index = rows.indexOf(node);
+	if (index != EntityTreeRows::npos) {
+		current = node;
+		currentRow = index;
+		Refresh();
+	}
+}
+
+void EntityTreeView::Select(const wxDataViewItem& item)
+{
+	EntNode* node = (EntNode*)item.GetID();
+	expandAncestors(node);
+	ensureRows();
+
+	size_t index = rows.indexOf(node);
+	if (index != EntityTreeRows::npos) {
+		selected.insert(node);
+		current = node;
+		currentRow = index;
+		Refresh();
+	}
+}
+
+void EntityTreeView::UnselectAll()
+{
+	selected.clear();
+	Refresh();
+}
+
+void EntityTreeView::SetSelections(const wxDataViewItemArray& items)
+{
+	selected.clear();
+	for (const wxDataViewItem& item : items)
+		expandAncestors((EntNode*)item.GetID());
+	ensureRows();
+
+	for (const wxDataViewItem& item : items) {
+		EntNode* node = (EntNode*)item.GetID();
+		if(rows.contains(node))
+			selected.insert(node);
+	}
+	Refresh();
+}
+
+void EntityTreeView::SelectChildren(const wxDataViewItem& item)
+{
+	ensureRows();
+	EntNode* node = (EntNode*)item.GetID();
+	if(expanded.count(node) == 0 || !rows.contains(node))
+		return;
+
+	EntNode** children = node->getChildBuffer();
+	for(int i = 0, max = node->getChildCount(); i < max; i++)
+		if(children[i]->isFilteredSelf())
+			selected.insert(children[i]);
+	Refresh();
+}
+
+int EntityTreeView::GetSelections(wxDataViewItemArray& items)
+{
+	ensureRows();
+	items.Clear();
+	if(selected.empty())
+		return 0;
+
+	std::vector<std::pair<size_t, EntNode*>> ordered;
+	ordered.reserve(selected.size());
+	for(EntNode* node : selected)
+		ordered.push_back({rows.indexOf(node), node});
+	std::sort(ordered.begin(), ordered.end());
+
+	items.Alloc(ordered.size());
+	for(const auto& pair : ordered)
+		items.Add(wxDataViewItem(pair.second));
+	return (int)items.GetCount();
+}
+
+bool EntityTreeView::IsSelected(const wxDataViewItem& item)
+{
+	// Freed nodes are forgotten right away, so this is accurate without rebuilding the rows.
+	// Callers can check it between the edits of a large group without paying for a rebuild each time
+	return selected.count((EntNode*)item.GetID()) > 0;
+}
+
+bool EntityTreeView::HasSelection()
+{
+	ensureRows();
+	return !selected.empty();
+}
+
+/*
+* Events
+*/
+
+void EntityTreeView::onPaint(wxPaintEvent& event)
+{
+	wxAutoBufferedPaintDC dc(this);
+	ensureRows();
+
+	wxSize size = GetClientSize();
+	dc.SetBackground(wxBrush(GetBackgroundColour()));
+	dc.Clear();
+	dc.SetFont(GetFont());
+
+	wxRendererNative& renderer = wxRendererNative::Get();
+	wxColour highlight = wxSystemSettings::GetColour(wxSYS_COLOUR_HIGHLIGHT);
+	wxColour highlightText = wxSystemSettings::GetColour(wxSYS_COLOUR_HIGHLIGHTTEXT);
+	int buttonSize = std::min(indent, rowHeight) - FromDIP(4);
+	int textOffset = (rowHeight - dc.GetCharHeight()) / 2;
+	int padding = FromDIP(4);
+	wxVariant label;
+
+	// Rows are scrolled whole, so the first visible row is always drawn just below the header
+	size_t last = std::min(GetVisibleRowsEnd(), rows.size());
+	int y = rowHeight;
+	for (size_t r = GetVisibleRowsBegin(); r < last; r++, y += rowHeight) {
+		const Row row = rows.at(r);
+		wxDataViewItem item(row.node);
+		wxRect rowRect(0, y, size.x, rowHeight);
+
+		if (selected.count(row.node) > 0) {
+			dc.SetPen(*wxTRANSPARENT_PEN);
+			dc.SetBrush(wxBrush(highlight));
+			dc.DrawRectangle(rowRect);
+			dc.SetTextForeground(highlightText);
+		}
+		else dc.SetTextForeground(GetForegroundColour());
+
+		int x = row.depth * indent;
+		if (row.node->IsContainer()) {
+			wxRect button(x + (indent - buttonSize) / 2, y + (rowHeight - buttonSize) / 2, buttonSize, buttonSize);
+			renderer.DrawTreeItemButton(this, dc, button, expanded.count(row.node) > 0 ? wxCONTROL_EXPANDED : 0);
+		}
+		x += indent;
+
+		if (x < keyWidth - padding) {
+			model->GetValue(label, item, 0);
+			wxDCClipper clip(dc, wxRect(x, y, keyWidth - padding - x, rowHeight));
+			dc.DrawText(label.GetString(), x, y + textOffset);
+		}
+		if (keyWidth + padding < size.x) {
+			model->GetValue(label, item, 1);
+			wxDCClipper clip(dc, wxRect(keyWidth + padding, y, size.x - keyWidth - padding, rowHeight));
+			dc.DrawText(label.GetString(), keyWidth + padding, y + textOffset);
+		}
+
+		if(row.node == current && HasFocus())
+			renderer.DrawFocusRect(this, dc, rowRect);
+	}
+
+	dc.SetPen(wxPen(wxSystemSettings::GetColour(wxSYS_COLOUR_3DSHADOW)));
+	dc.DrawLine(keyWidth, rowHeight, keyWidth, size.y);
+
+	// Column header - it's divider is dragged to resize the columns like the rows' divider
+	wxHeaderButtonParams params;
+	params.m_labelFont = GetFont();
+	params.m_labelText = "Key";
+	renderer.DrawHeaderButton(this, dc, wxRect(0, 0, keyWidth, rowHeight), 0, wxHDR_SORT_ICON_NONE, &params);
+	params.m_labelText = "Value";
+	renderer.DrawHeaderButton(this, dc, wxRect(keyWidth, 0, std::max(size.x - keyWidth, 0), rowHeight), 0, wxHDR_SORT_ICON_NONE, &params);
+}
+
+void EntityTreeView::onLeftDown(wxMouseEvent& event)
+{
+	SetFocus();
+	ensureRows();
+	if (hitsDivider(event.GetX())) {
+		resizingColumn = true;
+		CaptureMouse();
+		return;
+	}
+	if(event.GetY() < rowHeight) // Header
+		return;
+
+	int hit = hitRow(event.GetY());
+	if (hit < 0) {
+		if (!selected.empty()) {
+			selected.clear();
+			Refresh();
+			sendEvent(wxEVT_DATAVIEW_SELECTION_CHANGED, nullptr);
+		}
+		return;
+	}
+
+	size_t row = hit;
+	if (hitsExpander(row, event.GetX())) {
+		toggle(row);
+		return;
+	}
+
+	EntNode* node = rows.at(row).node;
+	if (event.ShiftDown()) {
+		if(!event.ControlDown())
+			selected.clear();
+		selectRange(anchorRow, row);
+	}
+	else if (event.ControlDown()) {
+		if(selected.erase(node) == 0)
+			selected.insert(node);
+		anchorRow = row;
+	}
+	else {
+		selected.clear();
+		selected.insert(node);
+		anchorRow = row;
+	}
+	setCurrent(row);
+	sendEvent(wxEVT_DATAVIEW_SELECTION_CHANGED, node);
+}
+
+void EntityTreeView::onLeftUp(wxMouseEvent& event)
+{
+	if (resizingColumn) {
+		resizingColumn = false;
+		ReleaseMouse();
+	}
+}
+
+void EntityTreeView::onLeftDoubleClick(wxMouseEvent& event)
+{
+	ensureRows();
+	int hit = hitRow(event.GetY());
+	if(hit < 0 || hitsDivider(event.GetX()))
+		return;
+
+	size_t row = hit;
+	if(hitsExpander(row, event.GetX()) || !sendEvent(wxEVT_DATAVIEW_ITEM_ACTIVATED, rows.at(row).node))
+		toggle(row);
+}
+
+void EntityTreeView::onRightUp(wxMouseEvent& event)
+{
+	ensureRows();
+	int hit = hitRow(event.GetY());
+	sendEvent(wxEVT_DATAVIEW_ITEM_CONTEXT_MENU, hit < 0 ? nullptr : rows.at(hit).node);
+}
+
+void EntityTreeView::onMotion(wxMouseEvent& event)
+{
+	if (resizingColumn) {
+		int width = GetClientSize().x;
+		keyWidth = std::max(minColumnWidth, std::min(event.GetX(), width - minColumnWidth));
+		Refresh();
+	}
+	else SetCursor(hitsDivider(event.GetX()) ? wxCursor(wxCURSOR_SIZEWE) : wxNullCursor);
+}
+
+void EntityTreeView::onCaptureLost(wxMouseCaptureLostEvent& event)
+{
+	resizingColumn = false;
+}
+
+void EntityTreeView::onFocus(wxFocusEvent& event)
+{
+	Refresh();
+	event.Skip();
+}
+
+void EntityTreeView::onChar(wxKeyEvent& event)
+{
+	ensureRows();
+	if (rows.empty()) {
+		event.Skip();
+		return;
+	}
+
+	size_t from = currentRow;
+	size_t lastRow = rows.size() - 1;
+	size_t page = std::max(3, GetClientSize().y / rowHeight) - 2; // Less the header
+	size_t to = from;
+	EntNode* node = rows.at(from).node;
+
+	switch (event.GetKeyCode())
+	{
+		case WXK_UP:
+		to = from > 0 ? from - 1 : 0;
+		break;
+
+		case WXK_DOWN:
+		to = std::min(from + 1, lastRow);
+		break;
+
+		case WXK_PAGEUP:
+		to = from > page ? from - page : 0;
+		break;
+
+		case WXK_PAGEDOWN:
+		to = std::min(from + page, lastRow);
+		break;
+
+		case WXK_HOME:
+		to = 0;
+		break;
+
+		case WXK_END:
+		to = lastRow;
+		break;
+
+		case WXK_LEFT: // Collapse, or move up to the parent
+		if (expanded.count(node) > 0 && node->IsContainer()) {
+			toggle(from);
+			return;
+		}
+		else {
+			size_t parentRow = rows.indexOf(node->getParent());
+			if(parentRow == EntityTreeRows::npos)
+				return;
+			to = parentRow;
+		}
+		break;
+
+		case WXK_RIGHT: // Expand, or move down to the first child
+		if (expanded.count(node) == 0) {
+			if(node->IsContainer())
+				toggle(from);
+			return;
+		}
+		if(from == lastRow || rows.at(from + 1).depth <= rows.at(from).depth)
+			return;
+		to = from + 1;
+		break;
+
+		case WXK_RETURN: case WXK_NUMPAD_ENTER:
+		if(current != nullptr)
+			sendEvent(wxEVT_DATAVIEW_ITEM_ACTIVATED, current);
+		return;
+
+		default:
+		event.Skip();
+		return;
+	}
+
+	// Control only moves the focus, leaving the selection as it is
+	if (event.ControlDown()) {
+		setCurrent(to);
+		return;
+	}
+
+	selected.clear();
+	if(event.ShiftDown())
+		selectRange(anchorRow, to);
+	else {
+		selected.insert(rows.at(to).node);
+		anchorRow = to;
+	}
+	setCurrent(to);
+	sendEvent(wxEVT_DATAVIEW_SELECTION_CHANGED, rows.at(to).node);
+}
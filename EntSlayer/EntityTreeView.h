@@ -0,0 +1,163 @@
+#include "wx/wx.h"
+#include "wx/vscroll.h"
+#include "wx/dataview.h"
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+class EntNode;
+class EntityParser;
+
+/*
+* The tree view's flattened rows, stored in a randomized binary tree ordered by row position.
+* Rows are found by position, and a node's row by the node, in logarithmic time. A run of rows
+* is inserted or erased without shifting or renumbering the rows after it
+*/
+class EntityTreeRows
+{
+	public:
+	struct Row {
+		EntNode* node;
+		int depth;
+	};
+	static const size_t npos = SIZE_MAX;
+
+	private:
+	struct Entry {
+		Row row;
+		size_t count;   // Rows in this subtree
+		int minDepth;   // Smallest depth in this subtree
+		Entry* left;
+		Entry* right;
+		Entry* parent;
+	};
+
+	Entry* top = nullptr;
+	std::unordered_map<const EntNode*, Entry*> entries;
+	uint64_t seed = 88172645463325252ULL; // Randomizes merges
+
+	public:
+	EntityTreeRows() = default;
+	EntityTreeRows(const EntityTreeRows&) = delete;
+	EntityTreeRows& operator=(const EntityTreeRows&) = delete;
+	~EntityTreeRows() { clear(); }
+
+	size_t size() const { return top == nullptr ? 0 : top->count; }
+	bool empty() const { return top == nullptr; }
+	bool contains(const EntNode* node) const { return entries.count(node) > 0; }
+	Row at(size_t index) const;
+	size_t indexOf(const EntNode* node) const;      // npos if the node has no row
+	size_t subtreeEnd(size_t index) const;          // Index after the last row below this row's node
+
+	void assign(const std::vector<Row>& newRows);
+	void insert(size_t index, const std::vector<Row>& newRows);
+	void erase(size_t index, size_t count, std::vector<EntNode*>& removed);
+	void clear();
+
+	private:
+	static size_t countOf(const Entry* e) { return e == nullptr ? 0 : e->count; }
+	void update(Entry* e);
+	void split(Entry* t, size_t index, Entry*& left, Entry*& right);
+	Entry* merge(Entry* left, Entry* right);
+	Entry* build(const Row* first, size_t count);
+	size_t firstAtMost(const Entry* t, size_t offset, size_t from, int depth) const;
+	void destroy(Entry* t, std::vector<EntNode*>* removed);
+};
+
+/*
+* Owner-drawn tree of an EntityParser's nodes. Every expanded, filtered-in node is kept in one
+* flattened list of rows, and only the rows on screen are painted. Expanding, collapsing and the
+* model's add and delete notifications splice the affected node's rows in or out, so they cost
+* time in proportion to the rows that change rather than every visible row.
+*
+* Implements the parts of wxDataViewCtrl's interface the editor uses, and sends the same
+* wxDataViewEvents for selection changes, activations and context menus
+*/
+class EntityTreeView : public wxVScrolledWindow
+{
+	private:
+	typedef EntityTreeRows::Row Row;
+
+	class Notifier;
+
+	EntityParser* model = nullptr;
+	Notifier* notifier = nullptr;                    // Owned by the model
+
+	EntityTreeRows rows;
+	bool rowsOutdated = true;                        // Set when the rows must be rebuilt from scratch
+
+	std::unordered_set<const EntNode*> expanded;     // Kept for nodes whose parents are collapsed
+	std::unordered_set<EntNode*> selected;           // Pruned when their rows are removed
+	EntNode* current = nullptr;                      // Node with the keyboard focus
+	size_t currentRow = 0;                           // Where the focus was when rows last changed
+	size_t anchorRow = 0;                            // Shift selections extend from this row
+
+	int rowHeight = 0;                               // Also the height of the column header
+	int indent = 0;
+	int keyWidth = 0;                                // Width of the key column
+	int minColumnWidth = 0;
+	bool resizingColumn = false;
+
+	public:
+	EntityTreeView(wxWindow* parent, wxWindowID id = wxID_ANY,
+		const wxPoint& pos = wxDefaultPosition,
+		const wxSize& size = wxDefaultSize);
+	~EntityTreeView();
+
+	wxWindow* GetMainWindow() { return this; }
+	void AssociateModel(EntityParser* p_model);
+
+	/* Drops a node that's being freed from the view's state and rows, since it's memory may be reused */
+	void ForgetNode(EntNode* node);
+
+	void Expand(const wxDataViewItem& item);      // Also expands the item's ancestors
+	void Collapse(const wxDataViewItem& item);
+	bool IsExpanded(const wxDataViewItem& item);
+	void EnsureVisible(const wxDataViewItem& item);
+
+	wxDataViewItem GetCurrentItem();
+	void SetCurrentItem(const wxDataViewItem& item);
+	void Select(const wxDataViewItem& item);      // Adds to the selection and makes the item current
+	void UnselectAll();
+	void SetSelections(const wxDataViewItemArray& items);
+	void SelectChildren(const wxDataViewItem& item);
+	int GetSelections(wxDataViewItemArray& items); // In row order
+	bool IsSelected(const wxDataViewItem& item);
+	bool HasSelection();
+
+	private:
+	void markOutdated();
+	void ensureRows();
+	void buildRows();
+	void collectRows(EntNode* node, int depth, std::vector<Row>& list);
+	void addRows(EntNode* parent, const wxDataViewItemArray& items);
+	void removeRows(size_t index, size_t count);
+	void removeNodeRows(EntNode* node);
+	void rowsChanged();
+	void expandNode(EntNode* node);
+	void collapseNode(EntNode* node);
+	void expandAncestors(EntNode* node);
+	void toggle(size_t row);
+	void makeRowVisible(size_t row);
+	void setCurrent(size_t row);
+	void selectRange(size_t from, size_t to);
+	bool sendEvent(wxEventType type, EntNode* node);
+	int hitRow(int y);
+	bool hitsExpander(size_t row, int x);
+	bool hitsDivider(int x);
+
+	virtual wxCoord OnGetRowHeight(size_t row) const override { return rowHeight; }
+
+	void onPaint(wxPaintEvent& event);
+	void onLeftDown(wxMouseEvent& event);
+	void onLeftUp(wxMouseEvent& event);
+	void onLeftDoubleClick(wxMouseEvent& event);
+	void onRightUp(wxMouseEvent& event);
+	void onMotion(wxMouseEvent& event);
+	void onCaptureLost(wxMouseCaptureLostEvent& event);
+	void onFocus(wxFocusEvent& event);
+	void onChar(wxKeyEvent& event);
+
+	wxDECLARE_EVENT_TABLE();
+};
@@ -138,18 +138,45 @@ SpawnFilter::SpawnFilter(EntityTab* tab, wxWindow* parent)
 	toggle->Bind(wxEVT_CHECKBOX, &SpawnFilter::onCheckbox, this);
 	Add(toggle, 0, wxBOTTOM, 2);
 
-	const wxString names[4] = {"x", "y", "z", "r"};
-	for (int i = 0; i < 4; i++)
+	const wxString shapes[2] = {"Sphere", "Box"};
+	shape = new wxChoice(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, 2, shapes);
+	shape->SetSelection(0);
+	shape->Bind(wxEVT_CHOICE, &SpawnFilter::onShape, this);
+	Add(shape, 0, wxLEFT | wxBOTTOM, 5);
+
+	const wxString names[7] = {"x", "y", "z", "r", "x2", "y2", "z2"};
+	for (int i = 0; i < 7; i++)
 	{
-		wxBoxSizer* row = new wxBoxSizer(wxHORIZONTAL);
-		labels[i] = new wxStaticText(parent, wxID_ANY, names[i], wxDefaultPosition, wxSize(8, -1));
+		rows[i] = new wxBoxSizer(wxHORIZONTAL);
+		labels[i] = new wxStaticText(parent, wxID_ANY, names[i], wxDefaultPosition, wxSize(14, -1));
 		inputs[i] = new wxTextCtrl(parent, wxID_ANY);
 		inputs[i]->Bind(wxEVT_TEXT, &SpawnFilter::onInputText, this);
 
-		row->Add(labels[i], 0, wxLEFT | wxRIGHT, 5);
-		row->Add(inputs[i], 0, wxLEFT | wxRIGHT, 5);
-		Add(row);
+		rows[i]->Add(labels[i], 0, wxLEFT | wxRIGHT, 5);
+		rows[i]->Add(inputs[i], 0, wxLEFT | wxRIGHT, 5);
+		Add(rows[i]);
 	}
+
+	/*
+	* Regions added to the list are kept when the inputs change - an entity passes
+	* if it's inside any of them, or inside the region currently typed in
+	*/
+	wxBoxSizer* listButtons = new wxBoxSizer(wxHORIZONTAL);
+	{
+		wxButton* addButton = new wxButton(parent, wxID_ANY, "Add Region", wxDefaultPosition, wxDefaultSize, wxBU_EXACTFIT);
+		addButton->Bind(wxEVT_BUTTON, &SpawnFilter::onAddRegion, this);
+
+		wxButton* removeButton = new wxButton(parent, wxID_ANY, "Remove", wxDefaultPosition, wxDefaultSize, wxBU_EXACTFIT);
+		removeButton->Bind(wxEVT_BUTTON, &SpawnFilter::onRemoveRegion, this);
+
+		listButtons->Add(addButton, 0, wxRIGHT, 5);
+		listButtons->Add(removeButton);
+	}
+	regionList = new wxListBox(parent, wxID_ANY, wxDefaultPosition, wxSize(-1, 60), 0, NULL, wxLB_SINGLE | wxLB_HSCROLL);
+	Add(listButtons, 0, wxLEFT | wxTOP, 5);
+	Add(regionList, 0, wxEXPAND | wxLEFT | wxRIGHT | wxTOP, 5);
+
+	showShapeInputs();
 }
 
 bool SpawnFilter::activated() 
@@ -162,17 +189,64 @@ void SpawnFilter::deactivate()
 	toggle->SetValue(false);
 }
 
-bool SpawnFilter::getData(Sphere& sphere) 
+/* Shows the radius for spheres, or the opposite corner for boxes */
+void SpawnFilter::showShapeInputs()
+{
+	bool box = shape->GetSelection() == 1;
+	Show(rows[3], !box);
+	for(int i = 4; i < 7; i++)
+		Show(rows[i], box);
+}
+
+/*
+* Converts the inputs into a sphere or box, depending on the selected shape
+* @throws std::exception if a field isn't a number
+*/
+void SpawnFilter::readInputs(std::vector<Sphere>& spheres, std::vector<Box>& boxes)
 {
-	wxString stringX = inputs[0]->GetValue(),
-		stringY = inputs[1]->GetValue(),
-		stringZ = inputs[2]->GetValue(),
-		stringR = inputs[3]->GetValue();
+	float values[7];
+	bool box = shape->GetSelection() == 1;
+	for (int i = 0; i < 7; i++) {
+		if((i == 3 && box) || (i > 3 && !box))
+			continue;
+		values[i] = stof(std::string(inputs[i]->GetValue()));
+	}
+
+	if (box) {
+		Box b;
+		b.minX = std::min(values[0], values[4]);
+		b.minY = std::min(values[1], values[5]);
+		b.minZ = std::min(values[2], values[6]);
+		b.maxX = std::max(values[0], values[4]);
+		b.maxY = std::max(values[1], values[5]);
+		b.maxZ = std::max(values[2], values[6]);
+		boxes.push_back(b);
+	}
+	else {
+		Sphere s;
+		s.x = values[0];
+		s.y = values[1];
+		s.z = values[2];
+		s.r = values[3];
+		spheres.push_back(s);
+	}
+}
+
+bool SpawnFilter::getData(std::vector<Sphere>& spheres, std::vector<Box>& boxes)
+{
+	spheres = savedSpheres;
+	boxes = savedBoxes;
+
+	// Blank inputs are ignored once there are regions in the list
+	bool blank = true;
+	for(int i = 0; i < 7; i++)
+		if(IsShown(rows[i]) && !inputs[i]->IsEmpty())
+			blank = false;
+	if(blank && regionList->GetCount() > 0)
+		return true;
+
 	try { // Todo: Ensure this function is as thorough as needed
-		sphere.x = stof(std::string(stringX));
-		sphere.y = stof(std::string(stringY));
-		sphere.z = stof(std::string(stringZ));
-		sphere.r = stof(std::string(stringR));
+		readInputs(spheres, boxes);
 	}
 	catch (std::exception) {
 		toggle->SetValue(false);
@@ -185,9 +259,15 @@ bool SpawnFilter::getData(Sphere& sphere)
 
 void SpawnFilter::setData(const std::string& x, const std::string& y, const std::string& z)
 {
-	inputs[0]->SetValue(x);
-	inputs[1]->SetValue(y);
-	inputs[2]->SetValue(z);
+	// The spawn position is the center of a sphere
+	if (shape->GetSelection() != 0) {
+		shape->SetSelection(0);
+		showShapeInputs();
+		shape->GetParent()->Layout();
+	}
+	inputs[0]->ChangeValue(x);
+	inputs[1]->ChangeValue(y);
+	inputs[2]->ChangeValue(z);
 	
 	if(toggle->IsChecked())
 		owner->applyFilters(false);
@@ -203,6 +283,56 @@ void SpawnFilter::onInputText(wxCommandEvent& event) {
 	event.Skip();
 }
 
+void SpawnFilter::onShape(wxCommandEvent& event) {
+	showShapeInputs();
+	shape->GetParent()->Layout();
+	if (toggle->IsChecked())
+		owner->applyFilters(false);
+}
+
+void SpawnFilter::onAddRegion(wxCommandEvent& event) 
+{
+	size_t sphereCount = savedSpheres.size(), boxCount = savedBoxes.size();
+	try {
+		readInputs(savedSpheres, savedBoxes);
+	}
+	catch (std::exception) {
+		wxMessageBox("Could not convert one or more fields to numbers",
+			"Adding Region Failed", wxICON_WARNING | wxOK);
+		return;
+	}
+
+	if (savedSpheres.size() > sphereCount) {
+		const Sphere& s = savedSpheres.back();
+		regionList->Insert(wxString::Format("Sphere (%g, %g, %g) r %g", s.x, s.y, s.z, s.r), (unsigned int)sphereCount);
+	}
+	else {
+		const Box& b = savedBoxes.back();
+		regionList->Insert(wxString::Format("Box (%g, %g, %g) to (%g, %g, %g)", b.minX, b.minY, b.minZ,
+			b.maxX, b.maxY, b.maxZ), (unsigned int)(sphereCount + boxCount));
+	}
+
+	for(int i = 0; i < 7; i++)
+		inputs[i]->ChangeValue("");
+	if (toggle->IsChecked())
+		owner->applyFilters(false);
+}
+
+void SpawnFilter::onRemoveRegion(wxCommandEvent& event) 
+{
+	int selection = regionList->GetSelection();
+	if(selection == wxNOT_FOUND)
+		return;
+
+	if((size_t)selection < savedSpheres.size())
+		savedSpheres.erase(savedSpheres.begin() + selection);
+	else savedBoxes.erase(savedBoxes.begin() + (selection - savedSpheres.size()));
+	regionList->Delete(selection);
+
+	if (toggle->IsChecked())
+		owner->applyFilters(false);
+}
+
 SearchBar::SearchBar(EntityTab* tab, wxWindow* parent) 
 	: wxBoxSizer(wxVERTICAL), owner(tab)
 {
@@ -211,11 +341,13 @@ SearchBar::SearchBar(EntityTab* tab, wxWindow* parent)
 		wxDefaultSize, wxTE_PROCESS_ENTER);
 	wxButton* btnNext = new wxButton(parent, wxID_ANY, ">", wxDefaultPosition, wxSize(23, 23));
 	wxButton* btnBack = new wxButton(parent, wxID_ANY, "<", wxDefaultPosition, wxSize(23, 23));
+	wxButton* btnFindAll = new wxButton(parent, wxID_ANY, "Find All");
 	caseSensitiveCheck = new wxCheckBox(parent, wxID_ANY, "Case Sensitive");
 
 	input->Bind(wxEVT_TEXT_ENTER, &SearchBar::onButtonNext, this);
 	btnNext->Bind(wxEVT_BUTTON, &SearchBar::onButtonNext, this);
 	btnBack->Bind(wxEVT_BUTTON, &SearchBar::onButtonBack, this);
+	btnFindAll->Bind(wxEVT_BUTTON, &SearchBar::onButtonFindAll, this);
 
 	wxSizer* topRow = new wxBoxSizer(wxHORIZONTAL);
 	topRow->Add(label, 0);
@@ -223,7 +355,12 @@ SearchBar::SearchBar(EntityTab* tab, wxWindow* parent)
 	topRow->Add(btnBack);
 	topRow->Add(btnNext);
 	Add(topRow, 1, wxEXPAND);
-	Add(caseSensitiveCheck);
+
+	wxSizer* bottomRow = new wxBoxSizer(wxHORIZONTAL);
+	bottomRow->Add(caseSensitiveCheck, 0, wxALIGN_CENTER_VERTICAL);
+	bottomRow->AddStretchSpacer();
+	bottomRow->Add(btnFindAll);
+	Add(bottomRow, 0, wxEXPAND);
 }
 
 void SearchBar::initiateSearch(bool backwards) 
@@ -242,4 +379,198 @@ void SearchBar::onButtonNext(wxCommandEvent& event)
 void SearchBar::onButtonBack(wxCommandEvent& event)
 {
 	initiateSearch(true);
+}
+
+void SearchBar::onButtonFindAll(wxCommandEvent& event)
+{
+	owner->Parser->FindAll(std::string(input->GetValue()), caseSensitiveCheck->IsChecked(), false);
+}
+
+QueryBar::QueryBar(EntityTab* tab, wxWindow* parent)
+	: wxBoxSizer(wxHORIZONTAL), owner(tab)
+{
+	label = new wxStaticText(parent, wxID_ANY, "Query");
+	input = new wxTextCtrl(parent, wxID_ANY, wxEmptyString, wxDefaultPosition,
+		wxDefaultSize, wxTE_PROCESS_ENTER);
+	input->SetToolTip("Press Enter to apply. Example: class == idAI2 and entityDef/edit/spawnPosition/x > 100");
+	input->Bind(wxEVT_TEXT_ENTER, &QueryBar::onEnter, this);
+
+	Add(label, 0);
+	Add(input, 1, wxEXPAND | wxLEFT, 5);
+}
+
+void QueryBar::onEnter(wxCommandEvent& event)
+{
+	owner->applyFilters(false);
+}
+
+SavedQueries::SavedQueries(EntityTab* tab, wxWindow* parent)
+	: wxPanel(parent), owner(tab)
+{
+	label = new wxStaticText(this, wxID_ANY, "Saved Queries");
+	list = new wxListBox(this, wxID_ANY, wxDefaultPosition, wxSize(180, -1), 0, NULL, wxLB_SINGLE | wxLB_HSCROLL);
+	list->SetToolTip("Double click to filter by a query");
+	wxButton* saveButton = new wxButton(this, wxID_ANY, "Save Query");
+	wxButton* deleteButton = new wxButton(this, wxID_ANY, "Delete");
+
+	list->Bind(wxEVT_LISTBOX_DCLICK, &SavedQueries::onDoubleClick, this);
+	saveButton->Bind(wxEVT_BUTTON, &SavedQueries::onSave, this);
+	deleteButton->Bind(wxEVT_BUTTON, &SavedQueries::onDelete, this);
+	Bind(wxEVT_IDLE, &SavedQueries::onIdle, this);
+
+	wxBoxSizer* buttons = new wxBoxSizer(wxHORIZONTAL);
+	buttons->Add(saveButton, 1);
+	buttons->Add(deleteButton, 1, wxLEFT, 5);
+
+	wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
+	sizer->Add(label);
+	sizer->Add(list, 1, wxEXPAND | wxTOP | wxBOTTOM, 5);
+	sizer->Add(buttons, 0, wxEXPAND);
+	SetSizerAndFit(sizer);
+}
+
+void SavedQueries::refresh()
+{
+	const EntityIndex& index = owner->Parser->getFacets();
+	shownRevision = index.ViewsRevision();
+
+	wxArrayString items;
+	for (const EntityIndex::View& v : index.GetViews())
+		items.push_back(wxString::Format("%s (%zu)", wxString(v.name), v.count));
+
+	int selection = list->GetSelection();
+	list->Freeze();
+	list->Set(items);
+	if(selection != wxNOT_FOUND && selection < (int)items.size())
+		list->SetSelection(selection);
+	list->Thaw();
+}
+
+void SavedQueries::onIdle(wxIdleEvent& event)
+{
+	// Checking the revision is cheap enough to do whenever the application is idle
+	if(owner->Parser->getFacets().ViewsRevision() != shownRevision)
+		refresh();
+	event.Skip();
+}
+
+void SavedQueries::onSave(wxCommandEvent& event)
+{
+	const std::string text(owner->queryBar->input->GetValue());
+	std::shared_ptr<const EntityQuery> query;
+	try {
+		query = std::make_shared<const EntityQuery>(text);
+	}
+	catch (std::runtime_error& e) {
+		wxMessageBox(e.what(), "Saving Query Failed", wxICON_WARNING | wxOK | wxCENTER, this);
+		return;
+	}
+
+	wxString name = wxGetTextFromUser("Query: " + text, "Save Query", wxEmptyString, this);
+	if(name.IsEmpty())
+		return;
+	owner->Parser->SaveView(std::string(name), query);
+	refresh();
+}
+
+void SavedQueries::onDelete(wxCommandEvent& event)
+{
+	int selection = list->GetSelection();
+	const auto& views = owner->Parser->getFacets().GetViews();
+	if(selection == wxNOT_FOUND || selection >= (int)views.size())
+		return;
+	owner->Parser->RemoveView(views[selection].name);
+	refresh();
+}
+
+void SavedQueries::onDoubleClick(wxCommandEvent& event)
+{
+	int selection = event.GetSelection();
+	const auto& views = owner->Parser->getFacets().GetViews();
+	if(selection == wxNOT_FOUND || selection >= (int)views.size())
+		return;
+	owner->queryBar->input->ChangeValue(views[selection].query->getText());
+	owner->applyFilters(false);
+}
+
+// Filling a list box gets slow past a few thousand items
+const size_t FindAllResults::MAX_SHOWN = 5000;
+
+FindAllResults::FindAllResults(EntityTab* tab, wxWindow* parent)
+	: wxPanel(parent), owner(tab)
+{
+	label = new wxStaticText(this, wxID_ANY, "Find All");
+	list = new wxListBox(this, wxID_ANY, wxDefaultPosition, wxSize(180, -1), 0, NULL, wxLB_SINGLE | wxLB_HSCROLL);
+	wxButton* clearButton = new wxButton(this, wxID_ANY, "Clear Results");
+
+	list->Bind(wxEVT_LISTBOX, &FindAllResults::onSelect, this);
+	clearButton->Bind(wxEVT_BUTTON, &FindAllResults::onClear, this);
+	Bind(wxEVT_IDLE, &FindAllResults::onIdle, this);
+
+	wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
+	sizer->Add(label);
+	sizer->Add(list, 1, wxEXPAND | wxTOP | wxBOTTOM, 5);
+	sizer->Add(clearButton, 0, wxEXPAND);
+	SetSizerAndFit(sizer);
+}
+
+void FindAllResults::refresh()
+{
+	EntityParser* parser = owner->Parser.get();
+	const std::vector<EntNode*>& results = parser->FindAllResults();
+	shownRevision = parser->FindAllRevision();
+
+	list->Freeze();
+	if (shownPass != parser->FindAllPass()) {
+		shownPass = parser->FindAllPass();
+		shownCount = 0;
+		list->Clear();
+	}
+
+	// Only the results found since the last refresh are added
+	wxArrayString items;
+	for (size_t max = std::min(results.size(), MAX_SHOWN); shownCount < max; shownCount++) {
+		EntNode* node = results[shownCount];
+		EntNode* entity = node->getEntity();
+		wxString item;
+		if(entity != nullptr && entity != node)
+			item = (*entity)["entityDef"].getValueWX() + ": ";
+		item.append(node->getNameWX());
+		if(node->ValueLength() > 0)
+			item.append(" = " + node->getValueWX());
+		items.push_back(item);
+	}
+	if(!items.empty())
+		list->Append(items);
+	list->Thaw();
+
+	wxString status = wxString::Format("Find All: %zu results", results.size());
+	if(results.size() > MAX_SHOWN)
+		status.append(wxString::Format(" (first %zu shown)", MAX_SHOWN));
+	if(parser->FindAllRunning())
+		status.append("...");
+	label->SetLabel(status);
+}
+
+void FindAllResults::onIdle(wxIdleEvent& event)
+{
+	if(owner->Parser->FindAllRevision() != shownRevision || owner->Parser->FindAllPass() != shownPass)
+		refresh();
+	event.Skip();
+}
+
+void FindAllResults::onSelect(wxCommandEvent& event)
+{
+	// A stale list may still be shown if the results were cleared since the last refresh
+	int selection = event.GetSelection();
+	EntityParser* parser = owner->Parser.get();
+	if(shownPass != parser->FindAllPass() || selection == wxNOT_FOUND || selection >= (int)parser->FindAllResults().size())
+		return;
+	parser->RevealNode(parser->FindAllResults()[selection]);
+}
+
+void FindAllResults::onClear(wxCommandEvent& event)
+{
+	owner->Parser->ClearFindAll();
+	refresh();
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "wx/combo.h"
 #include <set>
 #include <string_view>
+#include <vector>
 
 class FilterListCombo : public wxCheckListBox, public wxComboPopup
 {
@@ -38,6 +39,7 @@ class FilterListCombo : public wxCheckListBox, public wxComboPopup
 
 class EntityTab;
 struct Sphere;
+struct Box;
 class FilterCtrl : public wxComboCtrl
 {
 	public:
@@ -62,18 +64,31 @@ class SpawnFilter : public wxBoxSizer
 	public:
 	EntityTab* owner;
 	wxCheckBox* toggle;
-	wxTextCtrl* inputs[4];
-	wxStaticText* labels[4];
+	wxChoice* shape;
+	wxTextCtrl* inputs[7]; // x, y, z, r - or the box's opposite corner in place of r
+	wxStaticText* labels[7];
+	wxBoxSizer* rows[7];
+	wxListBox* regionList;
+	std::vector<Sphere> savedSpheres; // Listed first in regionList, followed by the boxes
+	std::vector<Box> savedBoxes;
 	
 	public:
 	SpawnFilter(EntityTab* tab, wxWindow* parent);
-	bool getData(Sphere& sphere);
+	bool getData(std::vector<Sphere>& spheres, std::vector<Box>& boxes);
 	void setData(const std::string& x, const std::string& y, const std::string &z);
 	bool activated();
 	void deactivate();
 
+	private:
+	void readInputs(std::vector<Sphere>& spheres, std::vector<Box>& boxes);
+	void showShapeInputs();
+
+	public:
 	void onCheckbox(wxCommandEvent &event);
 	void onInputText(wxCommandEvent &event);
+	void onShape(wxCommandEvent &event);
+	void onAddRegion(wxCommandEvent &event);
+	void onRemoveRegion(wxCommandEvent &event);
 };
 
 class SearchBar : public wxBoxSizer
@@ -89,4 +104,62 @@ class SearchBar : public wxBoxSizer
 	void initiateSearch(bool backwards);
 	void onButtonNext(wxCommandEvent& event);
 	void onButtonBack(wxCommandEvent& event);
+	void onButtonFindAll(wxCommandEvent& event);
+};
+
+class QueryBar : public wxBoxSizer
+{
+	public:
+	wxStaticText* label;
+	EntityTab* owner;
+	wxTextCtrl* input;
+
+	public:
+	QueryBar(EntityTab* tab, wxWindow* parent);
+	void onEnter(wxCommandEvent& event);
+};
+
+/*
+* Lists the tab's saved queries with how many entities each matches. The counts
+* are kept up to date by the parser's index, so the panel only redraws when they change
+*/
+class SavedQueries : public wxPanel
+{
+	public:
+	wxStaticText* label;
+	EntityTab* owner;
+	wxListBox* list;
+	uint64_t shownRevision = UINT64_MAX;
+
+	public:
+	SavedQueries(EntityTab* tab, wxWindow* parent);
+	void refresh();
+	void onIdle(wxIdleEvent& event);
+	void onSave(wxCommandEvent& event);
+	void onDelete(wxCommandEvent& event);
+	void onDoubleClick(wxCommandEvent& event);
+};
+
+/*
+* Lists the nodes found by the parser's Find All search. Results are appended as the
+* search finds them, and the list is emptied whenever the parser clears them
+*/
+class FindAllResults : public wxPanel
+{
+	public:
+	wxStaticText* label;
+	EntityTab* owner;
+	wxListBox* list;
+	uint64_t shownPass = UINT64_MAX;
+	uint64_t shownRevision = UINT64_MAX;
+	size_t shownCount = 0;
+
+	static const size_t MAX_SHOWN;
+
+	public:
+	FindAllResults(EntityTab* tab, wxWindow* parent);
+	void refresh();
+	void onIdle(wxIdleEvent& event);
+	void onSelect(wxCommandEvent& event);
+	void onClear(wxCommandEvent& event);
 };
\ No newline at end of file
@@ -2,10 +2,15 @@
 #include "EntityDiff.h"
 #include "EntityLogger.h"
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include "EntityParser.h"
+#include "EntityQuery.h"
+#include "WorkerPool.h"
 
 typedef EntNode entnode;
 typedef std::unordered_map<std::string, entnode*> nodemap_t;
@@ -22,14 +27,14 @@ void entdiff_buildnodemap(const entnode& root, nodemap_t& map, prefixlist_t& pre
 	for (int i = 0; i < root.getChildCount(); i++) {
 		entnode& e = root[i];
 
-		if (e["entityDef"]["systemVars"]["entityType"].getValueUQ() == "idWorldspawn") {
+		if (EntityFields::Path(e, "entityDef/systemVars/entityType").getValueUQ() == "idWorldspawn") {
 			int submapindex = 0;
 			e.ValueInt(submapindex, 0, 9999);
 
 			if(prefixes.size() <= submapindex)
 				prefixes.resize(submapindex + 1);
 
-			prefixes[submapindex] = e["entityDef"]["edit"]["entityPrefix"].getValueUQ();
+			prefixes[submapindex] = EntityFields::Path(e, "entityDef/edit/entityPrefix").getValueUQ();
 			UseSubmapIndices = true;
 		}
 	}
@@ -38,7 +43,7 @@ void entdiff_buildnodemap(const entnode& root, nodemap_t& map, prefixlist_t& pre
 	for (int i = 0; i < root.getChildCount(); i++) {
 		entnode& e = root[i];
 
-		std::string_view entityname = e["entityDef"].getValue();
+		std::string_view entityname = EntityFields::Name(e);
 		if (entityname.length() == 0)
 			continue;
 
@@ -60,22 +65,57 @@ void entdiff_buildnodemap(const entnode& root, nodemap_t& map, prefixlist_t& pre
 	}
 }
 
-// Returns true if nodes are equivalent in all meaningful ways
+/*
+* Returns true if the nodes are identical subtrees, going by their hashes alone so unchanged
+* entities and properties are skipped in constant time. A 64-bit collision would leave a change
+* out of the diff, but the odds of one are negligible next to the cost of comparing every
+* unchanged subtree in full. Matches that discard a change outright (rename detection and
+* duplicate changes) are confirmed with EntNode::SameTree instead
+*/
 bool entdiff_compare(const EntNode& a, const EntNode& b)
 {
-	#define diffcheck(OP) if(!(OP)) return false;
+	return a.getHash() == b.getHash();
+}
 
-	diffcheck(a.getFlags() == b.getFlags());
-	diffcheck(a.getChildCount() == b.getChildCount()); 
-	diffcheck(a.NameLength() == b.NameLength()); 
-	diffcheck(memcmp(a.NamePtr(), b.NamePtr(), a.NameLength()) == 0);
-	diffcheck(a.ValueLength() == b.ValueLength());
-	diffcheck(memcmp(a.ValuePtr(), b.ValuePtr(), a.ValueLength()) == 0);
+/*
+* Hash of an entity that ignores the name of it's entityDef,
+* so a renamed entity can be matched to it's original
+*/
+uint64_t entdiff_renamehash(const entnode& entity)
+{
+	uint64_t h = EntNode::HashNode(entity.getFlags(), entity.getName(), entity.getValue(), nullptr, 0);
+	for (int i = 0; i < entity.getChildCount(); i++) {
+		const entnode& child = entity[i];
+		uint64_t childhash = child.getHash();
+		if(child.getName() == "entityDef")
+			childhash = EntNode::HashNode(child.getFlags(), child.getName(), "", child.getChildBuffer(), child.getChildCount());
+		h = (h ^ childhash) * 0x100000001b3ULL;
+	}
+	return h;
+}
 
+/*
+* Confirms a match between entities with the same rename hash. A renamed entity is written
+* without it's contents, so a false match would lose every change made to it
+*/
+bool entdiff_comparerenamed(const entnode& a, const entnode& b)
+{
+	#define diffcheck(OP) if(!(OP)) return false;
+
+	const uint16_t formatting = EntNode::NF_Comma | EntNode::NF_NoIndent;
+	diffcheck((a.getFlags() & ~formatting) == (b.getFlags() & ~formatting));
+	diffcheck(a.getName() == b.getName());
+	diffcheck(a.getValue() == b.getValue());
+	diffcheck(a.getChildCount() == b.getChildCount());
 	for (int i = 0; i < a.getChildCount(); i++) {
-		diffcheck(entdiff_compare(*a.ChildAt(i), *b.ChildAt(i)));
+		if (a[i].getName() == "entityDef" && b[i].getName() == "entityDef") {
+			diffcheck((a[i].getFlags() & ~formatting) == (b[i].getFlags() & ~formatting));
+			diffcheck(a[i].getChildCount() == b[i].getChildCount());
+			for(int k = 0; k < a[i].getChildCount(); k++)
+				diffcheck(EntNode::SameTree(a[i][k], b[i][k]));
+		}
+		else diffcheck(EntNode::SameTree(a[i], b[i]));
 	}
-
 	return true;
 }
 
@@ -93,12 +133,250 @@ void entdiff_writepropstack(propstack_t& stack, std::string& writeto) {
 
 }
 
-void entdiff_builddiffs(const EntNode& vanilla, const EntNode& modded, std::string& deleted, std::string& added, std::string& edited, propstack_t& propstack)
+/*
+* Finds a node's children by name, returning the first match like EntNode::operator[]
+* Wide nodes are indexed with a hash map so matching two of them isn't quadratic
+*/
+class entdiff_childlookup
+{
+	const entnode& node;
+	std::unordered_map<std::string_view, const entnode*> map;
+
+	public:
+	entdiff_childlookup(const entnode& n) : node(n)
+	{
+		if(node.getChildCount() < 16)
+			return;
+		map.reserve(node.getChildCount());
+		for(int i = 0; i < node.getChildCount(); i++)
+			map.emplace(node[i].getName(), &node[i]);
+	}
+
+	const entnode& operator[](std::string_view name) const
+	{
+		if(map.empty())
+			return node[name];
+		const auto& iter = map.find(name);
+		return iter == map.end() ? *EntNode::SEARCH_404 : *iter->second;
+	}
+};
+
+bool entdiff_isitem(const entnode& node)
+{
+	return node.getName().substr(0, 5) == "item[";
+}
+
+/*
+* Nodes whose items are kept numbered by fixListNumberings. Their items
+* are diffed as a sequence instead of being matched by name
+*/
+bool entdiff_islist(const entnode& node)
+{
+	// Indiana Jones component ids aren't renumbered, so they're matched by name
+	if(node.getName() == "components")
+		return false;
+	for (int i = 0; i < node.getChildCount(); i++)
+		if(entdiff_isitem(node[i]))
+			return true;
+	return false;
+}
+
+/*
+* Myers' O((N+M)D) difference algorithm. Flags the elements of each sequence
+* that are part of their longest common subsequence. Sequences that differ by
+* more than maxedits elements fall back to only matching their common prefix and suffix
+*/
+void entdiff_lcs(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b, std::vector<bool>& akept, std::vector<bool>& bkept)
+{
+	const int maxedits = 1024;
+	akept.assign(a.size(), false);
+	bkept.assign(b.size(), false);
+
+	// Trim the common prefix and suffix
+	int start = 0, aend = (int)a.size(), bend = (int)b.size();
+	while (start < aend && start < bend && a[start] == b[start]) {
+		akept[start] = bkept[start] = true;
+		start++;
+	}
+	while (aend > start && bend > start && a[aend - 1] == b[bend - 1]) {
+		akept[--aend] = bkept[--bend] = true;
+	}
+
+	const int N = aend - start, M = bend - start;
+	if(N == 0 || M == 0)
+		return;
+
+	// v[k + offset] is the furthest x reached on diagonal k = x - y
+	const int maxd = N + M < maxedits ? N + M : maxedits;
+	const int offset = maxd + 1;
+	std::vector<int> v(2 * offset + 1, 0);
+	std::vector<std::vector<int>> trace; // v for diagonals [-d - 1, d + 1] before each step d
+
+	int found = -1;
+	for (int d = 0; d <= maxd && found < 0; d++)
+	{
+		trace.emplace_back(v.begin() + offset - d - 1, v.begin() + offset + d + 2);
+		for (int k = -d; k <= d; k += 2)
+		{
+			int x;
+			if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+				x = v[offset + k + 1];
+			else x = v[offset + k - 1] + 1;
+			int y = x - k;
+			while (x < N && y < M && a[start + x] == b[start + y]) {
+				x++;
+				y++;
+			}
+			v[offset + k] = x;
+			if (x >= N && y >= M) {
+				found = d;
+				break;
+			}
+		}
+	}
+	if(found < 0)
+		return;
+
+	// Walk back through the trace, flagging the diagonal snakes
+	int x = N, y = M;
+	for (int d = found; d >= 0; d--)
+	{
+		const std::vector<int>& prev = trace[d];
+		auto prevx = [&](int k) {return prev[k + d + 1];};
+		int k = x - y;
+		int prevk = (k == -d || (k != d && prevx(k - 1) < prevx(k + 1))) ? k + 1 : k - 1;
+		int startx = d == 0 ? 0 : prevx(prevk);
+		int starty = d == 0 ? 0 : startx - prevk;
+
+		while (x > startx && y > starty) {
+			akept[start + --x] = true;
+			bkept[start + --y] = true;
+		}
+		x = startx;
+		y = starty;
+	}
+}
+
+void entdiff_builddiffs(const EntNode& vanilla, const EntNode& modded, std::string& deleted, std::string& added, 
+	std::string& edited, std::string& inserted, propstack_t& propstack);
+
+/*
+* Both trees have the node, and it's flags are the same
+* Check to ensure their values are equal
+*/
+void entdiff_diffmatched(const EntNode& vnode, const EntNode& mnode, std::string_view name, std::string& deleted, std::string& added,
+	std::string& edited, std::string& inserted, propstack_t& propstack)
+{
+	if(entdiff_compare(vnode, mnode))
+		return;
+
+	propstack.push_back(name);
+	if (vnode.getValue() != mnode.getValue()) 
+	{
+		entdiff_writepropstack(propstack, edited);
+		edited.append(" = ");
+		edited.append(mnode.getValue());
+		edited.push_back('\n');
+	}
+	entdiff_builddiffs(vnode, mnode, deleted, added, edited, inserted, propstack);
+	propstack.pop_back();
+}
+
+/*
+* Diffs the items of a list as a sequence, so reordering or inserting
+* items doesn't turn the rest of the list into edits. Items that aren't part of the
+* common subsequence are deleted by their vanilla name, then inserted at their modded
+* position. Import renumbers the list after inserting, so later paths use modded numbering
+*/
+void entdiff_difflist(const EntNode& vanilla, const EntNode& modded, std::string& deleted, std::string& added,
+	std::string& edited, std::string& inserted, propstack_t& propstack)
+{
+	std::vector<const entnode*> vitems, mitems;
+	std::vector<uint64_t> vkeys, mkeys;
+
+	// Item numbers are excluded from the hash so renumbered items still match
+	for (int i = 0; i < vanilla.getChildCount(); i++) {
+		const entnode& item = vanilla[i];
+		if(!entdiff_isitem(item)) continue;
+		vitems.push_back(&item);
+		vkeys.push_back(EntNode::HashNode(item.getFlags(), "", item.getValue(), item.getChildBuffer(), item.getChildCount()));
+	}
+	for (int i = 0; i < modded.getChildCount(); i++) {
+		const entnode& item = modded[i];
+		if(!entdiff_isitem(item)) continue;
+		mitems.push_back(&item);
+		mkeys.push_back(EntNode::HashNode(item.getFlags(), "", item.getValue(), item.getChildBuffer(), item.getChildCount()));
+	}
+
+	std::vector<bool> vkept, mkept;
+	entdiff_lcs(vkeys, mkeys, vkept, mkept);
+
+	std::string insertedThisNode;
+	std::string itemtext, positionname;
+	size_t v = 0, m = 0;
+	while (v < vitems.size() || m < mitems.size())
+	{
+		if (v < vitems.size() && m < mitems.size() && vkept[v] && mkept[m]) {
+			v++;
+			m++;
+			continue;
+		}
+
+		// Gather the changed items between two matched ones
+		size_t vend = v, mend = m;
+		while(vend < vitems.size() && !vkept[vend]) vend++;
+		while(mend < mitems.size() && !mkept[mend]) mend++;
+
+		for (; v < vend || m < mend; v++, m++)
+		{
+			positionname = "item[" + std::to_string(m) + ']';
+
+			// An item edited in place keeps it's name before and after renumbering,
+			// so the same paths are valid for deleting and editing it's properties
+			if (v < vend && m < mend && vitems[v]->getName() == positionname && vitems[v]->getFlags() == mitems[m]->getFlags()) {
+				entdiff_diffmatched(*vitems[v], *mitems[m], vitems[v]->getName(), deleted, added, edited, inserted, propstack);
+				continue;
+			}
+
+			if (v < vend) {
+				propstack.push_back(vitems[v]->getName());
+				entdiff_writepropstack(propstack, deleted);
+				deleted.push_back('\n');
+				propstack.pop_back();
+			}
+			if (m < mend) {
+				itemtext.clear();
+				mitems[m]->generateText(itemtext);
+				insertedThisNode.append(positionname);
+				insertedThisNode.append(itemtext, mitems[m]->getName().length());
+				insertedThisNode.push_back('\n');
+			}
+		}
+		v = vend;
+		m = mend;
+	}
+
+	// Nested lists are written first, so their paths are resolved before this list is renumbered
+	if (insertedThisNode.length() > 0) {
+		entdiff_writepropstack(propstack, inserted);
+		inserted.append(" = {");
+		inserted.append(insertedThisNode);
+		inserted.append("}\n");
+	}
+}
+
+void entdiff_builddiffs(const EntNode& vanilla, const EntNode& modded, std::string& deleted, std::string& added, 
+	std::string& edited, std::string& inserted, propstack_t& propstack)
 {
+	const bool islist = entdiff_islist(vanilla) || entdiff_islist(modded);
+	const entdiff_childlookup vlookup(vanilla), mlookup(modded);
+
 	// Case 1: Identify nodes that have been deleted from the vanilla file
 	for (int i = 0; i < vanilla.getChildCount(); i++) {
+		if(islist && entdiff_isitem(vanilla[i]))
+			continue;
 		std::string_view name = vanilla[i].getName();
-		const entnode& mnode = modded[name];
+		const entnode& mnode = mlookup[name];
 
 		// A difference in node flags suggests things like going from a simple key = value node, to an object node
 		// or vice versa. This is too complex to handle via Case 3, so we create both a deleted and an added node
@@ -115,8 +393,10 @@ void entdiff_builddiffs(const EntNode& vanilla, const EntNode& modded, std::stri
 
 	for (int i = 0; i < modded.getChildCount(); i++) {
 		const entnode& mnode = modded[i];
+		if(islist && entdiff_isitem(mnode))
+			continue;
 		std::string_view name = mnode.getName();
-		const entnode& vnode = vanilla[name];
+		const entnode& vnode = vlookup[name];
 
 		// Case 2: Newly added nodes
 		// Do a flag check to finish handling the edge case explained above
@@ -125,22 +405,13 @@ void entdiff_builddiffs(const EntNode& vanilla, const EntNode& modded, std::stri
 			addedThisNode.push_back('\n');
 		}
 
-		// Case 3: Both trees have the node, and it's flags are the same
-		// Check to ensure their values are equal
-		else {
-			propstack.push_back(name);
-			if (vnode.getValue() != mnode.getValue()) 
-			{
-				entdiff_writepropstack(propstack, edited);
-				edited.append(" = ");
-				edited.append(mnode.getValue());
-				edited.push_back('\n');
-			}
-			entdiff_builddiffs(vnode, mnode, deleted, added, edited, propstack);
-			propstack.pop_back();
-		}
+		// Case 3: Both trees have the node
+		else entdiff_diffmatched(vnode, mnode, name, deleted, added, edited, inserted, propstack);
 	}
 
+	if(islist)
+		entdiff_difflist(vanilla, modded, deleted, added, edited, inserted, propstack);
+
 	// Consolidate into a single node
 	if (addedThisNode.length() > 0) {
 		entdiff_writepropstack(propstack, added);
@@ -152,7 +423,7 @@ void entdiff_builddiffs(const EntNode& vanilla, const EntNode& modded, std::stri
 
 void entdiff_getlookupname(const entnode& entity, const prefixlist_t& prefixes, std::string& writeto)
 {
-	std::string_view entityname = entity["entityDef"].getValue();
+	std::string_view entityname = EntityFields::Name(entity);
 	if (entityname.length() == 0)
 		return;
 
@@ -164,138 +435,298 @@ void entdiff_getlookupname(const entnode& entity, const prefixlist_t& prefixes,
 	writeto.append(entityname);
 }
 
-void EntityDiff::Export(const EntNode& vanilla, const EntNode& modded, const char* outputpath)
+/*
+* Opens an entity's diff entry with it's name, prefix and the adjacent entities it's anchored to
+*/
+void entdiff_writeheader(const char* type, const entnode& modded, int i, const prefixlist_t& moddedprefix, 
+	std::string_view lookupname, std::string_view entityname, int submapindex, std::string& output)
 {
-	nodemap_t vanillamap, moddedmap;
-	prefixlist_t vanillaprefix, moddedprefix;
-	bool __dummy;
+	output.append(type);
+	output.append(" \"");
+	output.append(lookupname);
+	output.append("\" {\n");
+
+	output.append("\tname = \"");
+	output.append(entityname);
+	output.append("\"\n\tprefix = \"");
+	output.append(moddedprefix[submapindex]);
+
+	output.append("\"\n\tplaceafter = \"");
+	if (i != 0) {
+		entdiff_getlookupname(modded[i - 1], moddedprefix, output);
+	}
 
-	entdiff_buildnodemap(vanilla, vanillamap, vanillaprefix, __dummy);
-	entdiff_buildnodemap(modded, moddedmap, moddedprefix, __dummy);
+	output.append("\"\n\tplacebefore = \"");
+	if (i != modded.getChildCount() - 1) {
+		entdiff_getlookupname(modded[i + 1], moddedprefix, output);
+	}
+	output.append("\"\n");
+}
 
-	std::string output;
-	output.reserve(1000000);
+enum class entdiff_type
+{
+	vanilla,
+	added,
+	modified,
+	renamed
+};
+
+/*
+* Writes the diff entry for one entity of the modded file, if it has one
+* Only reads the trees and maps, so many entities can be exported simultaneously
+* @param moved If true, the entity is out of order relative to the vanilla file
+* @return The type of entry written
+*/
+entdiff_type entdiff_exportentity(const entnode& modded, int i, const nodemap_t& vanillamap, const prefixlist_t& moddedprefix, 
+	const std::string* renamedfrom, bool moved, std::string& output)
+{
+	const entnode& current = modded[i];
 
-	output.append("delete = {\n");
+	std::string_view entityname = EntityFields::Name(current);
+	if (entityname.length() == 0)
+		return entdiff_type::vanilla;
 
-	// First: Gather deleted entities
-	// We don't need to care about order so we can iterate through the map
-	for (const auto& pair : vanillamap) {
-		auto iter = moddedmap.find(pair.first);
-		if (iter == moddedmap.end())
-		{
-			output.append("\t\"");
-			output.append(pair.first);
-			output.append("\"\n");
-		}
-	}
-	output.append("}\n");
+	int submapindex = 0;
+	current.ValueInt(submapindex, 0, 9999);
 
-	// Second: Gather modified entities
-	// We do need to care about ordering due to placebefore/placeafter
-	for (int i = 0; i < modded.getChildCount(); i++) {
-		const entnode& current = modded[i];
+	std::string lookupname = moddedprefix[submapindex];
+	lookupname.push_back('@');
+	lookupname.append(entityname);
 
-		std::string_view entityname = current["entityDef"].getValue();
-		if (entityname.length() == 0)
-			continue;
+	// If this is a new entity, include it
+	const auto& iter = vanillamap.find(lookupname);
 
-		int submapindex = 0;
-		current.ValueInt(submapindex, 0, 9999);
+	typedef entdiff_type enttype;
+	enttype etype;
 
-		std::string lookupname = moddedprefix[submapindex];
-		lookupname.push_back('@');
-		lookupname.append(entityname);
+	if (renamedfrom != nullptr) {
+		etype = enttype::renamed;
+	}
+	else if (iter == vanillamap.end()) {
+		etype = enttype::added;
+	}
+	else {
+		etype = entdiff_compare(current, *iter->second) ? enttype::vanilla : enttype::modified;
+	}
 
-		// If this is a new entity, include it
-		const auto& iter = vanillamap.find(lookupname);
+	switch (etype)
+	{
+		case enttype::vanilla:
+		break;
 
-		enum class enttype
-		{
-			vanilla,
-			added,
-			modified
-		} etype;
+		case enttype::added:
+		entdiff_writeheader("added", modded, i, moddedprefix, lookupname, entityname, submapindex, output);
+		break;
 
-		if (iter == vanillamap.end()) {
-			etype = enttype::added;
-		}
-		else {
-			etype = entdiff_compare(current, *iter->second) ? enttype::vanilla : enttype::modified;
-		}
+		case enttype::modified:
+		entdiff_writeheader("edited", modded, i, moddedprefix, lookupname, entityname, submapindex, output);
+		break;
 
-		switch (etype)
-		{
-			case enttype::vanilla:
-			continue;
+		case enttype::renamed:
+		entdiff_writeheader("renamed", modded, i, moddedprefix, lookupname, entityname, submapindex, output);
+		break;
+	}
 
-			case enttype::added:
-			output.append("added \"");
-			break;
+	// Renamed entities are otherwise identical to the original
+	if (etype == enttype::renamed)
+	{
+		output.append("\trenamedfrom = \"");
+		output.append(*renamedfrom);
+		output.append("\"\n");
+	}
 
-			case enttype::modified:
-			output.append("edited \"");
-			break;
+	// For new entities, include everything
+	if (etype == enttype::added)
+	{
+		output.append("\tnewtext = {\n");
+		// Skip the entity {} wrapper to omit the subindex
+		for (int e_iter = 0; e_iter < current.getChildCount(); e_iter++) {
+			current[e_iter].generateText(output, 2);
+			output.push_back('\n');
 		}
+		output.append("\t}\n");
+	}
 
-		output.append(lookupname);
-		output.append("\" {\n");
+	// For Modified Entities, run the in-depth diff checker 
+	else if (etype == enttype::modified)
+	{
+		std::string deletions = "deleted = {";
+		std::string inserted = "inserted = {";
+		std::string added = "added = {";
+		std::string edited = "edited = {";
+		propstack_t propstack;
 
-		output.append("\tname = \"");
-		output.append(entityname);
-		output.append("\"\n\tprefix = \"");
-		output.append(moddedprefix[submapindex]);
+		const entnode& vanilla = *iter->second;
+		entdiff_builddiffs(vanilla, current, deletions, added, edited, inserted, propstack);
 
-		// todo: placeafter/placebefore
-		output.append("\"\n\tplaceafter = \"");
-		if (i != 0) {
-			entdiff_getlookupname(modded[i - 1], moddedprefix, output);
-		}
+		deletions.append("}\n");
+		inserted.append("}\n");
+		added.append("}\n");
+		edited.append("}\n");
+		output.append(deletions);
+		output.append(inserted);
+		output.append(added);
+		output.append(edited);
+	}
+	if(etype != enttype::vanilla)
+		output.append("}\n");
 
-		output.append("\"\n\tplacebefore = \"");
-		if (i != modded.getChildCount() - 1) {
-			entdiff_getlookupname(modded[i + 1], moddedprefix, output);
-		}
-		output.append("\"\n");
+	// Moves come after any rename, so they use the entity's new name
+	if (moved) {
+		entdiff_writeheader("moved", modded, i, moddedprefix, lookupname, entityname, submapindex, output);
+		output.append("}\n");
+	}
+	return etype;
+}
+
+/*
+* Flags the elements of a sequence that aren't part of it's longest increasing subsequence
+* Patience sorting, O(n log n)
+*/
+void entdiff_unsorted(const std::vector<int>& sequence, std::vector<bool>& unsorted)
+{
+	std::vector<int> tails;                              // Index of the smallest tail of each subsequence length
+	std::vector<int> previous(sequence.size(), -1);      // Preceding element in the subsequence ending at each index
+	for (size_t i = 0; i < sequence.size(); i++) {
+		auto pos = std::lower_bound(tails.begin(), tails.end(), sequence[i], 
+			[&](int index, int value) {return sequence[index] < value;});
+		if(pos != tails.begin())
+			previous[i] = *(pos - 1);
+		if(pos == tails.end())
+			tails.push_back((int)i);
+		else *pos = (int)i;
+	}
 
+	unsorted.assign(sequence.size(), true);
+	for(int i = tails.empty() ? -1 : tails.back(); i >= 0; i = previous[i])
+		unsorted[i] = false;
+}
 
-		// For new entities, include everything
-		if (etype == enttype::added)
-		{
-			output.append("\tnewtext = {\n");
-			// Skip the entity {} wrapper to omit the subindex
-			for (int e_iter = 0; e_iter < current.getChildCount(); e_iter++) {
-				current[e_iter].generateText(output, 2);
-				output.push_back('\n');
+EntityDiff::ExportStats EntityDiff::Export(const EntNode& vanilla, const EntNode& modded, const char* outputpath, unsigned maxThreads)
+{
+	ExportStats stats;
+	nodemap_t vanillamap, moddedmap;
+	prefixlist_t vanillaprefix, moddedprefix;
+	bool __dummy[2];
+
+	WorkerPool::ParallelFor(2, [&](size_t i) {
+		if(i == 0)
+			entdiff_buildnodemap(vanilla, vanillamap, vanillaprefix, __dummy[0]);
+		else entdiff_buildnodemap(modded, moddedmap, moddedprefix, __dummy[1]);
+	}, maxThreads);
+
+	// Match entities that only exist in the modded file to identical, deleted vanilla entities
+	std::unordered_map<uint64_t, std::vector<const std::string*>> renamecandidates;
+	std::unordered_set<std::string> renamedvanilla;
+	std::vector<const std::string*> renamedfrom(modded.getChildCount(), nullptr);
+	for (const auto& pair : vanillamap) {
+		if(moddedmap.find(pair.first) == moddedmap.end())
+			renamecandidates[entdiff_renamehash(*pair.second)].push_back(&pair.first);
+	}
+	if (!renamecandidates.empty()) {
+		std::string lookupname;
+		for (int i = 0; i < modded.getChildCount(); i++) {
+			lookupname.clear();
+			entdiff_getlookupname(modded[i], moddedprefix, lookupname);
+			if(lookupname.empty() || vanillamap.find(lookupname) != vanillamap.end())
+				continue;
+
+			auto iter = renamecandidates.find(entdiff_renamehash(modded[i]));
+			if(iter == renamecandidates.end())
+				continue;
+			std::vector<const std::string*>& candidates = iter->second;
+			for (size_t c = candidates.size(); c-- > 0; ) {
+				if(!entdiff_comparerenamed(*vanillamap.at(*candidates[c]), modded[i]))
+					continue;
+				renamedfrom[i] = candidates[c];
+				renamedvanilla.insert(*candidates[c]);
+				candidates.erase(candidates.begin() + c);
+				break;
 			}
-			output.append("\t}\n");
 		}
+	}
 
-		// For Modified Entities, run the in-depth diff checker 
-		else if (etype == enttype::modified)
-		{
-			std::string deletions = "deleted = {";
-			std::string added = "added = {";
-			std::string edited = "edited = {";
-			propstack_t propstack;
+	// Entities kept from the vanilla file are moved if they aren't part of the
+	// longest run that's still in vanilla order. Everything else is anchored to them
+	std::vector<bool> moved(modded.getChildCount(), false);
+	{
+		std::unordered_map<const entnode*, int> vanillaindex;
+		vanillaindex.reserve(vanilla.getChildCount());
+		for(int i = 0; i < vanilla.getChildCount(); i++)
+			vanillaindex.emplace(&vanilla[i], i);
+
+		std::vector<int> order, orderentity; // Vanilla index of each kept entity, and it's modded index
+		std::string lookupname;
+		for (int i = 0; i < modded.getChildCount(); i++) {
+			lookupname.clear();
+			entdiff_getlookupname(modded[i], moddedprefix, lookupname);
+			if(lookupname.empty())
+				continue;
+
+			auto iter = vanillamap.find(renamedfrom[i] == nullptr ? lookupname : *renamedfrom[i]);
+			if(iter == vanillamap.end())
+				continue;
+			order.push_back(vanillaindex[iter->second]);
+			orderentity.push_back(i);
+		}
 
-			const entnode& vanilla = *iter->second;
-			entdiff_builddiffs(vanilla, current, deletions, added, edited, propstack);
+		std::vector<bool> unsorted;
+		entdiff_unsorted(order, unsorted);
+		for(size_t i = 0; i < order.size(); i++)
+			moved[orderentity[i]] = unsorted[i];
+	}
+
+	std::string output;
+	output.reserve(1000000);
+
+	output.append("delete = {\n");
 
-			deletions.append("}\n");
-			added.append("}\n");
-			edited.append("}\n");
-			output.append(deletions);
-			output.append(added);
-			output.append(edited);
+	// First: Gather deleted entities
+	// We don't need to care about order so we can iterate through the map
+	for (const auto& pair : vanillamap) {
+		auto iter = moddedmap.find(pair.first);
+		if (iter == moddedmap.end() && renamedvanilla.find(pair.first) == renamedvanilla.end())
+		{
+			output.append("\t\"");
+			output.append(pair.first);
+			output.append("\"\n");
+			stats.deleted++;
 		}
-		output.append("}\n");
 	}
+	output.append("}\n");
+
+	// Second: Gather modified entities
+	// We do need to care about ordering due to placebefore/placeafter, so
+	// each entity gets it's own buffer and they're concatenated in file order
+	std::vector<std::string> entityoutput(modded.getChildCount());
+	std::vector<entdiff_type> entitytypes(modded.getChildCount());
+	WorkerPool::ParallelFor(entityoutput.size(), [&](size_t i) {
+		entitytypes[i] = entdiff_exportentity(modded, (int)i, vanillamap, moddedprefix, renamedfrom[i], moved[i], entityoutput[i]);
+	}, maxThreads);
+
+	for (size_t i = 0; i < entitytypes.size(); i++) {
+		switch (entitytypes[i]) {
+			case entdiff_type::added: stats.added++; break;
+			case entdiff_type::modified: stats.edited++; break;
+			case entdiff_type::renamed: stats.renamed++; break;
+			default: break;
+		}
+		if(moved[i])
+			stats.moved++;
+	}
+
+	size_t totallength = output.length();
+	for(const std::string& s : entityoutput)
+		totallength += s.length();
+	output.reserve(totallength);
+	for(const std::string& s : entityoutput)
+		output.append(s);
 
 	std::ofstream writer(outputpath, std::ios_base::binary);
 	writer << output;
 	writer.close();
 	EntityLogger::log("EntityDiff Exported Successfully");
+	return stats;
 }
 
 void entdiff_logwarning(std::ofstream& logfile, std::string_view lookupname, std::string_view propname, std::string_view msg)
@@ -311,6 +742,12 @@ void entdiff_logwarning(std::ofstream& logfile, std::string_view lookupname, std
 	logfile << logmsg << "\n";
 }
 
+// For edits that are already present in the file. Only written to the log file
+void entdiff_lognote(std::ofstream& logfile, std::string_view lookupname, std::string_view propname, std::string_view msg)
+{
+	logfile << "NOTE: " << lookupname << ":" << propname << " " << msg << "\n";
+}
+
 entnode* entdiff_getproperty(entnode& entity, std::string_view propstring)
 {
 	if(propstring.empty())
@@ -336,14 +773,41 @@ entnode* entdiff_getproperty(entnode& entity, std::string_view propstring)
 	return currentnode;
 }
 
-void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* LOGPATH, const char* FILEPATH)
+/*
+* Child index of the root an entity should be inserted at, to place it after
+* it's placeafter entity or before it's placebefore entity. -1 if neither exist
+*/
+int entdiff_anchorindex(const entnode& root, const entnode& current, const nodemap_t& nodemap)
 {
-	// Allow for writing to same log with append flag
-	std::ofstream logfile(LOGPATH, std::ios_base::binary | std::ios_base::app);
-	logfile << "\n\nImport Log For " << FILEPATH << "\n======\n";
+	// Entities are placed in modded file order, so the entity before this one is already in place.
+	// The first entity has none, and the entity after it may still be waiting to move, so it goes
+	// before every entity instead (but after the version header)
+	std::string_view placeafter = current["placeafter"].getValueUQ();
+	if (placeafter.empty()) {
+		int index = 0;
+		while(index < root.getChildCount() && root[index].getName() != "entity")
+			index++;
+		return index;
+	}
 
-	EntityLogger::log("Importing Entity Diff. This may take some time");
+	auto iter = nodemap.find(std::string(placeafter));
+	if(iter != nodemap.end())
+		return root.getChildIndex(iter->second) + 1;
+
+	iter = nodemap.find(std::string(current["placebefore"].getValueUQ()));
+	if(iter != nodemap.end())
+		return root.getChildIndex(iter->second);
+	return -1;
+}
 
+/*
+* Applies a list of diffs to the parser's tree in a single pass. Every diff's deleted
+* entities are removed first, then their other entries are applied in order
+* @param excluded Diff entries and properties to skip
+*/
+void entdiff_apply(EntityParser& parser, const std::vector<const entnode*>& diffs, const std::unordered_set<const entnode*>& excluded, 
+	std::ofstream& logfile)
+{
 	entnode& root = *parser.getRoot();
 	nodemap_t nodemap;
 	prefixlist_t prefixlist;
@@ -362,10 +826,13 @@ void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* L
 	}
 
 	// Step 1: Import Deleted Entities
+	for (const entnode* diff : diffs)
 	{
-		const entnode& deleted = diff["delete"];
+		const entnode& deleted = (*diff)["delete"];
 
 		for (int i = 0; i < deleted.getChildCount(); i++) {
+			if(excluded.count(&deleted[i]))
+				continue;
 			std::string_view name = deleted[i].getNameUQ();
 			auto iter = nodemap.find(std::string(name));
 
@@ -386,10 +853,55 @@ void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* L
 		}
 	}
 
+	// Added entities are copied directly from the diff's nodes. Consecutive
+	// entities anchored to one another are inserted as a single edit
+	struct pendingentity {
+		const entnode* newtext;
+		std::string_view lookupname;
+		std::string submapvalue;
+	};
+	std::vector<pendingentity> pendingadds;
+	std::vector<NodeCopy> copies;
+	int pendingindex = 0;
+
+	auto flushadds = [&]() {
+		if(pendingadds.empty())
+			return;
+		copies.clear();
+		for(const pendingentity& e : pendingadds)
+			copies.emplace_back(e.newtext, EntNode::NFC_ObjSimple, "entity", e.submapvalue);
+		parseresult = parser.EditTreeCopy(copies, &root, pendingindex, 0, false, true);
+
+		// If the run can't be inserted, retry each entity alone so only the invalid ones are skipped
+		const bool batched = parseresult.success;
+		int inserted = 0;
+		for (size_t i = 0; i < pendingadds.size(); i++) {
+			if(!batched && pendingadds.size() > 1)
+				parseresult = parser.EditTreeCopy({copies[i]}, &root, pendingindex + inserted, 0, false, true);
+
+			if (parseresult.success) {
+				nodemap[std::string(pendingadds[i].lookupname)] = &root[pendingindex + inserted];
+				inserted++;
+			}
+			else entdiff_logwarning(logfile, pendingadds[i].lookupname, "", "Parser failed to add entity");
+		}
+		pendingadds.clear();
+	};
+
 	// Step 2+3: Import new entities and modified entities
-	for (int diffiter = 0; diffiter < diff.getChildCount(); diffiter++)
+	for (const entnode* diff : diffs)
+	for (int diffiter = 0; diffiter < diff->getChildCount(); diffiter++)
 	{
-		const entnode& current = diff[diffiter];
+		const entnode& current = (*diff)[diffiter];
+		if(excluded.count(&current))
+			continue;
+
+		// Everything but the next entity of a run needs the pending entities to be in the tree
+		if (!pendingadds.empty()) {
+			if(current.getName() != "added" || current["placeafter"].getValueUQ() != pendingadds.back().lookupname)
+				flushadds();
+		}
+
 		if (current.getName() == "added")
 		{
 			std::string_view lookupname = current.getValueUQ();
@@ -397,7 +909,14 @@ void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* L
 			{
 				auto iter = nodemap.find(std::string(lookupname));
 				if (iter != nodemap.end()) {
-					entdiff_logwarning(logfile, lookupname, "", "Added entity already exists! Skipping");
+					const entnode& existing = *iter->second;
+					const entnode& newtext = current["newtext"];
+					uint64_t addedhash = EntNode::HashNode(existing.getFlags(), existing.getName(), existing.getValue(), 
+						newtext.getChildBuffer(), newtext.getChildCount());
+
+					if(addedhash == existing.getHash())
+						entdiff_lognote(logfile, lookupname, "", "Added entity is already in the file");
+					else entdiff_logwarning(logfile, lookupname, "", "Added entity already exists! Skipping");
 					continue;
 				}
 			}
@@ -415,55 +934,73 @@ void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* L
 			}
 
 			// Determine insertion index by anchoring entity to it's adjacent entities
-			int insertionindex = root.getChildCount();
-			{
-				std::string_view adjacentname = current["placeafter"].getValueUQ();
-				auto iter = nodemap.find(std::string(adjacentname));
-
-				if (iter == nodemap.end()) {
-					adjacentname = current["placebefore"].getValueUQ();
-					iter = nodemap.find(std::string(adjacentname));
-				}
-
-				if (iter == nodemap.end()) {
+			// An entity anchored to the previous pending entity joins it's run
+			if (pendingadds.empty()) {
+				pendingindex = entdiff_anchorindex(root, current, nodemap);
+				if (pendingindex < 0) {
 					entdiff_logwarning(logfile, lookupname, "", "Failed to find adjacent entities. Placing at end of file.");
-				}
-				else {
-					insertionindex = root.getChildIndex(iter->second);
+					pendingindex = root.getChildCount();
 				}
 			}
 
-			// Generate the text we'll be adding to the node tree
-			{
-				textbuffer.clear();
-				textbuffer.append("entity ");
+			// The newtext node becomes the entity, so it's copied with the entity's name and flags
+			// Must ensure we do not insert submap indices for Eternal entities
+			pendingadds.push_back({&current["newtext"], lookupname, UseSubmapIndices ? std::to_string(submapindex) : ""});
+		}
 
-				// Must ensure we do not insert submap indices for Eternal entities
-				if (UseSubmapIndices) {
-					textbuffer.append(std::to_string(submapindex));
-				}
 
-				textbuffer.append(" {\n");
-				const entnode& newtext = current["newtext"];
-				for (int i = 0; i < newtext.getChildCount(); i++) {
-					newtext[i].generateText(textbuffer);
-					textbuffer.push_back('\n');
-				}
-				textbuffer.push_back('}');
-			}
 
-			// Finalize
-			parseresult = parser.EditTree(textbuffer, &root, insertionindex, 0, false, true);
-			if (parseresult.success) {
-				nodemap[std::string(lookupname)] = &root[insertionindex];
+		else if (current.getName() == "renamed")
+		{
+			std::string_view lookupname = current.getValueUQ();
+			std::string_view oldname = current["renamedfrom"].getValueUQ();
+
+			const auto& iter = nodemap.find(std::string(oldname));
+			if (iter == nodemap.end()) {
+				if(nodemap.find(std::string(lookupname)) != nodemap.end())
+					entdiff_lognote(logfile, lookupname, "", "Entity has already been renamed");
+				else entdiff_logwarning(logfile, lookupname, "", "Renamed entity does not exist in file");
+				continue;
 			}
-			else {
-				entdiff_logwarning(logfile, lookupname, "", "Parser failed to add entity");
+			if (nodemap.find(std::string(lookupname)) != nodemap.end()) {
+				entdiff_logwarning(logfile, lookupname, "", "Cannot rename entity to a name that already exists! Skipping");
+				continue;
 			}
 
+			entnode* entity = iter->second;
+			entnode& entitydef = (*entity)["entityDef"];
+			textbuffer.clear();
+			textbuffer.append(entitydef.getName());
+			textbuffer.append(current["name"].getValueUQ());
+			parser.EditText(textbuffer, &entitydef, entitydef.NameLength(), true);
+
+			nodemap.erase(iter);
+			nodemap[std::string(lookupname)] = entity;
 		}
 
+		else if (current.getName() == "moved")
+		{
+			std::string_view lookupname = current.getValueUQ();
+
+			const auto& iter = nodemap.find(std::string(lookupname));
+			if (iter == nodemap.end()) {
+				entdiff_logwarning(logfile, lookupname, "", "Moved entity does not exist in file");
+				continue;
+			}
+
+			int childindex = root.getChildIndex(iter->second);
+			int insertionindex = entdiff_anchorindex(root, current, nodemap);
+			if (insertionindex < 0) {
+				entdiff_logwarning(logfile, lookupname, "", "Failed to find adjacent entities. Entity was not moved.");
+				continue;
+			}
 
+			// Account for the entity's own slot being vacated
+			if(childindex < insertionindex)
+				insertionindex--;
+			if(childindex != insertionindex)
+				parser.EditPosition(&root, childindex, insertionindex, true);
+		}
 
 		else if (current.getName() == "edited")
 		{
@@ -482,6 +1019,8 @@ void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* L
 			const entnode& deletions = current["deleted"];
 			for (int deliter = 0; deliter < deletions.getChildCount(); deliter++)
 			{
+				if(excluded.count(&deletions[deliter]))
+					continue;
 				std::string_view propstring = deletions[deliter].getNameUQ();
 
 				entnode* propnode = entdiff_getproperty(entity, propstring);
@@ -497,6 +1036,50 @@ void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* L
 				}
 			}
 
+			// Insert list items at their position in the modded list
+			const entnode& insertions = current["inserted"];
+			for (int insiter = 0; insiter < insertions.getChildCount(); insiter++)
+			{
+				const entnode& currentlist = insertions[insiter];
+				if(excluded.count(&currentlist))
+					continue;
+				std::string_view propstring = currentlist.getNameUQ();
+
+				entnode* propnode = entdiff_getproperty(entity, propstring);
+				if (propnode == EntNode::SEARCH_404) {
+					entdiff_logwarning(logfile, lookupname, propstring, "Cannot insert items into list that no longer exists! Skipping");
+					continue;
+				}
+
+				for (int itemiter = 0; itemiter < currentlist.getChildCount(); itemiter++) {
+					const entnode& item = currentlist[itemiter];
+					int position = 0;
+					std::string_view itemname = item.getName();
+					if(itemname.length() > 6)
+						position = std::atoi(std::string(itemname.substr(5, itemname.length() - 6)).c_str());
+
+					// Find the child index of the item currently at this position
+					int insertionindex = -1, itemcount = 0, lastitem = -1;
+					for (int i = 0; i < propnode->getChildCount() && insertionindex < 0; i++) {
+						if(!entdiff_isitem((*propnode)[i]))
+							continue;
+						if(itemcount++ == position)
+							insertionindex = i;
+						lastitem = i;
+					}
+					if(insertionindex < 0)
+						insertionindex = lastitem < 0 ? propnode->getChildCount() : lastitem + 1;
+
+					parseresult = parser.EditTreeCopy({NodeCopy(&item)}, propnode, insertionindex, 0, false, true);
+					if (!parseresult.success) {
+						entdiff_logwarning(logfile, lookupname, propstring, "Parser failed to insert list item");
+					}
+				}
+
+				// Later paths use the modded file's numbering
+				parser.fixListNumberings(propnode, false, true);
+			}
+
 			// Add New Properties
 			const entnode& additions = current["added"];
 			for (int additer = 0; additer < additions.getChildCount(); additer++)
@@ -509,26 +1092,32 @@ void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* L
 					entdiff_logwarning(logfile, lookupname, propstring, "Cannot add data to property that no longer exists! Skipping");
 				}
 				else {
-					textbuffer.clear();
+					copies.clear();
 
 					// Iterate through all the properties we're adding
 					for (int addpropiter = 0; addpropiter < currentadd.getChildCount(); addpropiter++) {
+						if(excluded.count(&currentadd[addpropiter]))
+							continue;
 						std::string_view newpropname = currentadd[addpropiter].getName();
 						
 						// Check that each property we're adding doesn't already exist in the new file
-						if (&(*propnode)[newpropname] != EntNode::SEARCH_404) {
+						const entnode& existing = (*propnode)[newpropname];
+						if (&existing != EntNode::SEARCH_404) {
 							std::string debugstring(propstring);
 							debugstring.push_back('@');
 							debugstring.append(newpropname);
-							entdiff_logwarning(logfile, lookupname, debugstring, "Cannot add property that already exists! Skipping");
+							if(entdiff_compare(existing, currentadd[addpropiter]))
+								entdiff_lognote(logfile, lookupname, debugstring, "Added property is already in the file");
+							else entdiff_logwarning(logfile, lookupname, debugstring, "Cannot add property that already exists! Skipping");
 						}
 						else {
-							currentadd[addpropiter].generateText(textbuffer);
-							textbuffer.push_back('\n');
+							copies.emplace_back(&currentadd[addpropiter]);
 						}
 					}
 
-					parseresult = parser.EditTree(textbuffer, propnode, propnode->getChildCount(), 0, false, true);
+					if(copies.empty())
+						continue;
+					parseresult = parser.EditTreeCopy(copies, propnode, propnode->getChildCount(), 0, false, true);
 					if (!parseresult.success) {
 						entdiff_logwarning(logfile, lookupname, propstring, "Parser failed to add data to subproperties");
 					}
@@ -539,12 +1128,17 @@ void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* L
 			const entnode& edits = current["edited"];
 			for (int edititer = 0; edititer < edits.getChildCount(); edititer++)
 			{
+				if(excluded.count(&edits[edititer]))
+					continue;
 				std::string_view propstring = edits[edititer].getNameUQ();
 				
 				entnode* propnode = entdiff_getproperty(entity, propstring);
 				if (propnode == EntNode::SEARCH_404) {
 					entdiff_logwarning(logfile, lookupname, propstring, "Cannot edit property that no longer exists! Skipping");
 				}
+				else if (propnode->getValue() == edits[edititer].getValue()) {
+					entdiff_lognote(logfile, lookupname, propstring, "Edit is already applied");
+				}
 				else {
 					textbuffer.clear();
 					textbuffer.append(propnode->getName());
@@ -558,6 +1152,535 @@ void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* L
 		}
 	}
 
+	flushadds();
+
+	// Every edit is undone and redone as one group
+	#if entityparser_history
 	parser.PushGroupCommand();
+	#endif
+}
+
+void EntityDiff::Import(EntityParser& parser, const EntNode& diff, const char* LOGPATH, const char* FILEPATH)
+{
+	// Allow for writing to same log with append flag
+	std::ofstream logfile(LOGPATH, std::ios_base::binary | std::ios_base::app);
+	logfile << "\n\nImport Log For " << FILEPATH << "\n======\n";
+
+	EntityLogger::log("Importing Entity Diff. This may take some time");
+	entdiff_apply(parser, {&diff}, {}, logfile);
 	EntityLogger::log("EntityDiff Imported Successfully");
 }
+
+/*
+* One change a diff makes to an entity. Changes from different diffs conflict if they
+* touch the same path or one touches an ancestor of the other's path. Whole-entity changes 
+* use the empty path and moves use "#position", so moves only conflict with whole-entity changes
+*/
+struct entdiff_touch {
+	const entnode* op;    // Diff node skipped if this change isn't applied
+	size_t diffindex;
+	uint64_t content;     // Equal for identical changes, which are applied once instead of conflicting
+
+	// What content was hashed from: a node, or else a pair of values
+	const entnode* contentnode;
+	std::string_view contentvalues[2];
+
+	/* Equal content hashes are confirmed, since only one of two identical changes is applied */
+	bool sameContent(const entdiff_touch& other) const
+	{
+		if(content != other.content || (contentnode == nullptr) != (other.contentnode == nullptr))
+			return false;
+		if(contentnode != nullptr)
+			return EntNode::SameTree(*contentnode, *other.contentnode);
+		return contentvalues[0] == other.contentvalues[0] && contentvalues[1] == other.contentvalues[1];
+	}
+};
+typedef std::unordered_map<std::string, std::vector<entdiff_touch>> touchmap_t; // Property path -> changes
+typedef std::unordered_map<std::string, touchmap_t> entitytouchmap_t;           // Lookup name -> changes
+
+void entdiff_indexdiff(const entnode& diff, size_t diffindex, entitytouchmap_t& touches)
+{
+	const entnode& deleted = diff["delete"];
+	for (int i = 0; i < deleted.getChildCount(); i++) {
+		touches[std::string(deleted[i].getNameUQ())][""].push_back({&deleted[i], diffindex, 0, nullptr, {}});
+	}
+
+	std::string path;
+	for (int diffiter = 0; diffiter < diff.getChildCount(); diffiter++)
+	{
+		const entnode& current = diff[diffiter];
+		std::string_view type = current.getName();
+		if(type != "added" && type != "renamed" && type != "moved" && type != "edited")
+			continue;
+		touchmap_t& entity = touches[std::string(current.getValueUQ())];
+
+		if (type == "added") {
+			const entnode& newtext = current["newtext"];
+			entity[""].push_back({&current, diffindex, newtext.getHash(), &newtext, {}});
+		}
+		else if (type == "renamed") {
+			std::string_view name = current["name"].getValue(), renamedfrom = current["renamedfrom"].getValue();
+			uint64_t content = EntNode::HashNode(0, name, renamedfrom, nullptr, 0);
+			entity[""].push_back({&current, diffindex, content, nullptr, {name, renamedfrom}});
+			touches[std::string(current["renamedfrom"].getValueUQ())][""].push_back({&current, diffindex, content, nullptr, {name, renamedfrom}});
+		}
+		else if (type == "moved") {
+			std::string_view after = current["placeafter"].getValue(), before = current["placebefore"].getValue();
+			uint64_t content = EntNode::HashNode(0, after, before, nullptr, 0);
+			entity["#position"].push_back({&current, diffindex, content, nullptr, {after, before}});
+		}
+		else if (type == "edited") {
+			for (const char* section : {"deleted", "inserted", "edited"}) {
+				const entnode& changes = current[section];
+				for (int i = 0; i < changes.getChildCount(); i++)
+					entity[std::string(changes[i].getNameUQ())].push_back({&changes[i], diffindex, changes[i].getHash(), &changes[i], {}});
+			}
+
+			const entnode& additions = current["added"];
+			for (int i = 0; i < additions.getChildCount(); i++) {
+				const entnode& parent = additions[i];
+				for (int k = 0; k < parent.getChildCount(); k++) {
+					path = parent.getNameUQ();
+					if(!path.empty())
+						path.push_back('@');
+					path.append(parent[k].getName());
+					entity[path].push_back({&parent[k], diffindex, parent[k].getHash(), &parent[k], {}});
+				}
+			}
+		}
+	}
+}
+
+/*
+* Excludes conflicting changes to an entity from every diff, and duplicate changes from all but the first diff making them
+*/
+void entdiff_findconflicts(std::string_view lookupname, const touchmap_t& entity, const std::vector<std::string>& diffnames, 
+	std::unordered_set<const entnode*>& excluded, std::ofstream& logfile, size_t& conflicts)
+{
+	// Nothing can conflict when only one diff changes this entity
+	size_t firstdiff = entity.begin()->second.front().diffindex;
+	bool multiplediffs = false;
+	for (const auto& pair : entity)
+		for (const entdiff_touch& t : pair.second)
+			multiplediffs |= t.diffindex != firstdiff;
+	if(!multiplediffs)
+		return;
+
+	// Identical changes are removed first, so they never conflict with anything
+	std::unordered_set<const entnode*> duplicates;
+	for (const auto& pair : entity)
+	{
+		const std::vector<entdiff_touch>& touches = pair.second;
+		for (size_t i = 0; i < touches.size(); i++) for (size_t k = 0; k < i; k++) {
+			if (touches[i].diffindex != touches[k].diffindex && touches[i].sameContent(touches[k])) {
+				duplicates.insert(touches[i].op);
+				entdiff_lognote(logfile, lookupname, pair.first, "Identical change from multiple diffs is applied once");
+				break;
+			}
+		}
+	}
+
+	std::string message;
+	for (const auto& pair : entity)
+	{
+		const std::string& path = pair.first;
+
+		// Compare against changes to this path and each of it's ancestors
+		size_t ancestorlength = path.length();
+		for (bool done = false; !done; )
+		{
+			const auto& ancestor = entity.find(path.substr(0, ancestorlength));
+			if (ancestor != entity.end()) for (const entdiff_touch& t : pair.second) for (const entdiff_touch& a : ancestor->second)
+			{
+				if(t.diffindex == a.diffindex || duplicates.count(t.op) || duplicates.count(a.op))
+					continue;
+				if(ancestorlength == path.length() && t.diffindex < a.diffindex) // Each pair at the same path is visited twice
+					continue;
+
+				excluded.insert(t.op);
+				excluded.insert(a.op);
+				conflicts++;
+				message = "Conflicting changes from ";
+				message.append(diffnames[a.diffindex]);
+				message.append(" and ");
+				message.append(diffnames[t.diffindex]);
+				message.append(". Skipping both");
+				entdiff_logwarning(logfile, lookupname, path, message);
+			}
+
+			if (ancestorlength == 0)
+				done = true;
+			else {
+				size_t separator = path.rfind('@', ancestorlength - 1);
+				ancestorlength = separator == std::string::npos ? 0 : separator;
+			}
+		}
+	}
+	excluded.insert(duplicates.begin(), duplicates.end());
+}
+
+void EntityDiff::ImportMany(EntityParser& parser, const std::vector<const EntNode*>& diffs, const std::vector<std::string>& diffnames,
+	const char* LOGPATH, const char* FILEPATH)
+{
+	std::ofstream logfile(LOGPATH, std::ios_base::binary | std::ios_base::app);
+	logfile << "\n\nImport Log For " << FILEPATH << "\n======\n";
+	for(const std::string& name : diffnames)
+		logfile << "Merging " << name << "\n";
+
+	EntityLogger::log("Importing " + std::to_string(diffs.size()) + " Entity Diffs. This may take some time");
+
+	// Index every diff's changes by entity and property path, then find conflicts before editing anything
+	entitytouchmap_t touches;
+	for(size_t i = 0; i < diffs.size(); i++)
+		entdiff_indexdiff(*diffs[i], i, touches);
+
+	std::unordered_set<const entnode*> excluded;
+	size_t conflicts = 0;
+	for (const auto& pair : touches)
+		entdiff_findconflicts(pair.first, pair.second, diffnames, excluded, logfile, conflicts);
+	if(conflicts > 0)
+		EntityLogger::log("EntityDiff: " + std::to_string(conflicts) + " conflicting changes were skipped. Check the log for details");
+
+	entdiff_apply(parser, diffs, excluded, logfile);
+	EntityLogger::log("EntityDiffs Imported Successfully");
+}
+
+/*
+* Tree Diffs
+* 
+* Structure-agnostic diffs for JSON and permissive files. A tree diff is a list of operations,
+* written in the order they're applied so every path is valid when it's operation runs:
+* 
+* edit <%path%> { value = <%new value%> }
+* replace <%path%> { hash = [hash of the replaced node] text = <%new node%> }
+* delete <%path%> { hash = [hash of the deleted node] }
+* insert <%parent path%> { at = [index] after = <%preceding sibling%> text = <%new nodes%> }
+* 
+* Objects whose children have unique names are keyed: their children are matched by name
+* and path segments are the child's name. Everything else (i.e. arrays) is diffed as a sequence
+* of child hashes, and path segments are the child's index in the form [i]. Within a node, 
+* the edits and replacements of it's children come first, then deletions by descending index, 
+* then insertions by ascending index. So sequence indices stay valid while they're applied
+*/
+
+bool entdiff_treekeyed(const entnode& node)
+{
+	if(node.getFlags() & EntNode::NF_Brackets)
+		return false;
+
+	// JSON roots hold a single value, which can only be replaced
+	if(node.getParent() == nullptr && node.getChildCount() <= 1)
+		return false;
+
+	std::unordered_set<std::string_view> names;
+	names.reserve(node.getChildCount());
+	for (int i = 0; i < node.getChildCount(); i++) {
+		std::string_view name = node[i].getName();
+
+		// Names that can't be written as a path segment force the node to be a sequence
+		if(name.empty() || name[0] == '[' || name.find('@') != std::string_view::npos || name.find("%>") != std::string_view::npos)
+			return false;
+		if(!names.insert(name).second)
+			return false;
+	}
+	return true;
+}
+
+void entdiff_treewritepath(const std::vector<std::string>& path, std::string& writeto)
+{
+	writeto.append("<%");
+	for (size_t i = 0; i < path.size(); i++) {
+		if(i > 0)
+			writeto.push_back('@');
+		writeto.append(path[i]);
+	}
+	writeto.append("%>");
+}
+
+void entdiff_treewriteverbatim(std::string_view text, std::string& writeto)
+{
+	if(text.find("%>") != std::string_view::npos)
+		throw std::runtime_error("EntityDiff: Cannot write text containing %> to a tree diff");
+	writeto.append("<%");
+	writeto.append(text);
+	writeto.append("%>");
+}
+
+struct entdiff_treestats {
+	size_t edited = 0;
+	size_t replaced = 0;
+	size_t deleted = 0;
+	size_t inserted = 0;
+};
+
+/*
+* Aligns children [v, vend) of vanilla with children [m, mend) of modded by their keys.
+* Matched pairs are passed to matched(), and each run of unmatched children between them to unmatched()
+*/
+template <typename Matched, typename Unmatched>
+void entdiff_treealign(const std::vector<uint64_t>& vkeys, const std::vector<uint64_t>& mkeys, int v, int vend, int m, int mend,
+	const Matched& matched, const Unmatched& unmatched)
+{
+	std::vector<uint64_t> a(vkeys.begin() + v, vkeys.begin() + vend), b(mkeys.begin() + m, mkeys.begin() + mend);
+	std::vector<bool> akept, bkept;
+	entdiff_lcs(a, b, akept, bkept);
+
+	int i = 0, j = 0;
+	const int alen = (int)a.size(), blen = (int)b.size();
+	while (i < alen || j < blen)
+	{
+		if (i < alen && j < blen && akept[i] && bkept[j]) {
+			matched(v + i++, m + j++);
+			continue;
+		}
+
+		int iend = i, jend = j;
+		while(iend < alen && !akept[iend]) iend++;
+		while(jend < blen && !bkept[jend]) jend++;
+		unmatched(v + i, v + iend, m + j, m + jend);
+		i = iend;
+		j = jend;
+	}
+}
+
+/*
+* Writes the operations turning vanilla into modded. The path of both nodes is on the stack
+*/
+void entdiff_treediff(const entnode& vanilla, const entnode& modded, std::vector<std::string>& path, 
+	std::string& output, entdiff_treestats& stats)
+{
+	if (vanilla.getValue() != modded.getValue()) {
+		output.append("edit ");
+		entdiff_treewritepath(path, output);
+		output.append(" {\n\tvalue = ");
+		entdiff_treewriteverbatim(modded.getValue(), output);
+		output.append("\n}\n");
+		stats.edited++;
+	}
+
+	// Keyed children are matched by name and flags, sequence children by their contents.
+	// Children left unmatched are then matched by name alone, so changes to their flags
+	// or contents don't cost a deletion and insertion
+	const bool keyed = entdiff_treekeyed(vanilla) && entdiff_treekeyed(modded);
+	std::vector<uint64_t> vkeys(vanilla.getChildCount()), mkeys(modded.getChildCount());
+	std::vector<uint64_t> vnames(vanilla.getChildCount()), mnames(modded.getChildCount());
+	for (int i = 0; i < vanilla.getChildCount(); i++) {
+		const entnode& n = vanilla[i];
+		vkeys[i] = keyed ? EntNode::HashNode(n.getFlags(), n.getName(), "", nullptr, 0) : n.getHash();
+		vnames[i] = EntNode::HashNode(0, n.getName(), "", nullptr, 0);
+	}
+	for (int i = 0; i < modded.getChildCount(); i++) {
+		const entnode& n = modded[i];
+		mkeys[i] = keyed ? EntNode::HashNode(n.getFlags(), n.getName(), "", nullptr, 0) : n.getHash();
+		mnames[i] = EntNode::HashNode(0, n.getName(), "", nullptr, 0);
+	}
+
+	auto pushsegment = [&](int v) {
+		path.push_back(keyed ? std::string(vanilla[v].getName()) : '[' + std::to_string(v) + ']');
+	};
+
+	auto recurse = [&](int v, int m) {
+		if(entdiff_compare(vanilla[v], modded[m]))
+			return;
+		pushsegment(v);
+		entdiff_treediff(vanilla[v], modded[m], path, output, stats);
+		path.pop_back();
+	};
+
+	// Replacing a node keeps the indices of it's siblings, so it's written in place
+	std::string text;
+	auto replace = [&](int v, int m) {
+		text.clear();
+		modded[m].generateText(text);
+		pushsegment(v);
+		output.append("replace ");
+		entdiff_treewritepath(path, output);
+		output.append(" {\n\thash = ");
+		output.append(std::to_string(vanilla[v].getHash()));
+		output.append("\n\ttext = ");
+		entdiff_treewriteverbatim(text, output);
+		output.append("\n}\n");
+		path.pop_back();
+		stats.replaced++;
+	};
+
+	std::vector<int> deleted, inserted;
+	entdiff_treealign(vkeys, mkeys, 0, vanilla.getChildCount(), 0, modded.getChildCount(), recurse,
+		[&](int v, int vend, int m, int mend) {
+		entdiff_treealign(vnames, mnames, v, vend, m, mend, 
+			[&](int v, int m) {
+				if(vanilla[v].getFlags() == modded[m].getFlags())
+					recurse(v, m);
+				else replace(v, m);
+			},
+			[&](int v, int vend, int m, int mend) {
+				// Sequences replace what they can, keyed nodes stay matched by name
+				for (; v < vend || m < mend; v++, m++) {
+					if (!keyed && v < vend && m < mend) {
+						replace(v, m);
+						continue;
+					}
+					if(v < vend)
+						deleted.push_back(v);
+					if(m < mend)
+						inserted.push_back(m);
+				}
+			});
+	});
+
+	for (auto iter = deleted.rbegin(); iter != deleted.rend(); ++iter) {
+		pushsegment(*iter);
+		output.append("delete ");
+		entdiff_treewritepath(path, output);
+		output.append(" {\n\thash = ");
+		output.append(std::to_string(vanilla[*iter].getHash()));
+		output.append("\n}\n");
+		path.pop_back();
+		stats.deleted++;
+	}
+
+	// Consecutive insertions are written as one operation
+	for (size_t i = 0; i < inserted.size(); )
+	{
+		size_t end = i + 1;
+		while(end < inserted.size() && inserted[end] == inserted[end - 1] + 1)
+			end++;
+
+		text.clear();
+		for (size_t k = i; k < end; k++) {
+			modded[inserted[k]].generateText(text);
+			text.push_back('\n');
+		}
+
+		output.append("insert ");
+		entdiff_treewritepath(path, output);
+		output.append(" {\n\tat = ");
+		output.append(std::to_string(inserted[i]));
+		if (keyed && inserted[i] > 0) {
+			output.append("\n\tafter = ");
+			entdiff_treewriteverbatim(modded[inserted[i] - 1].getName(), output);
+		}
+		output.append("\n\ttext = ");
+		entdiff_treewriteverbatim(text, output);
+		output.append("\n}\n");
+		stats.inserted += end - i;
+		i = end;
+	}
+}
+
+void EntityDiff::ExportTree(const EntNode& vanilla, const EntNode& modded, const char* outputpath)
+{
+	std::string output = "treediff {\n}\n";
+	std::vector<std::string> path;
+	entdiff_treestats stats;
+	entdiff_treediff(vanilla, modded, path, output, stats);
+
+	std::ofstream writer(outputpath, std::ios_base::binary);
+	writer << output;
+	writer.close();
+	EntityLogger::log("Tree Diff Exported Successfully: " + std::to_string(stats.edited) + " edits, " + std::to_string(stats.replaced)
+		+ " replacements, " + std::to_string(stats.deleted) + " deletions, " + std::to_string(stats.inserted) + " insertions");
+}
+
+bool EntityDiff::IsTreeDiff(const EntNode& diff)
+{
+	return &diff["treediff"] != EntNode::SEARCH_404;
+}
+
+/*
+* Finds the node at a tree diff path
+* @return SEARCH_404 if a segment doesn't exist
+*/
+entnode* entdiff_treeresolve(entnode& root, std::string_view path)
+{
+	entnode* current = &root;
+	while (!path.empty() && current != EntNode::SEARCH_404)
+	{
+		size_t separator = path.find('@');
+		std::string_view segment = path.substr(0, separator);
+		path = separator == std::string_view::npos ? std::string_view() : path.substr(separator + 1);
+
+		if (segment.length() > 2 && segment.front() == '[' && segment.back() == ']') {
+			int index = atoi(std::string(segment.substr(1, segment.length() - 2)).c_str());
+			current = index >= 0 && index < current->getChildCount() ? current->ChildAt(index) : EntNode::SEARCH_404;
+		}
+		else current = &(*current)[segment];
+	}
+	return current;
+}
+
+void EntityDiff::ImportTree(EntityParser& parser, const EntNode& diff, const char* LOGPATH, const char* FILEPATH)
+{
+	std::ofstream logfile(LOGPATH, std::ios_base::binary | std::ios_base::app);
+	logfile << "\n\nImport Log For " << FILEPATH << "\n======\n";
+	EntityLogger::log("Importing Tree Diff. This may take some time");
+
+	entnode& root = *parser.getRoot();
+	std::string textbuffer;
+	for (int i = 0; i < diff.getChildCount(); i++)
+	{
+		const entnode& op = diff[i];
+		std::string_view type = op.getName();
+		std::string_view path = op.getValueUQ();
+		if(type == "treediff")
+			continue;
+
+		entnode* node = entdiff_treeresolve(root, path);
+		if (node == EntNode::SEARCH_404) {
+			entdiff_logwarning(logfile, type, path, "Node no longer exists! Skipping");
+			continue;
+		}
+
+		if (type == "edit")
+		{
+			std::string_view value = op["value"].getValueUQ();
+			if (node->getValue() == value) {
+				entdiff_lognote(logfile, type, path, "Edit is already applied");
+				continue;
+			}
+			textbuffer.clear();
+			textbuffer.append(node->getName());
+			textbuffer.append(value);
+			parser.EditText(textbuffer, node, node->NameLength(), true);
+		}
+		else if (type == "delete" || type == "replace")
+		{
+			uint64_t hash = strtoull(std::string(op["hash"].getValue()).c_str(), nullptr, 10);
+			if (node->getHash() != hash) {
+				entdiff_logwarning(logfile, type, path, "Node was changed since the diff was made! Skipping");
+				continue;
+			}
+			entnode* parent = node->getParent();
+			std::string_view text = type == "replace" ? op["text"].getValueUQ() : "";
+			ParseResult parseresult = parser.EditTree(text, parent, parent->getChildIndex(node), 1, false, true);
+			if (!parseresult.success) {
+				std::string msg = "Could not replace node (diff line " + std::to_string(parseresult.errorLineNum) + "): " + parseresult.errorMessage;
+				entdiff_logwarning(logfile, type, path, msg);
+			}
+		}
+		else if (type == "insert")
+		{
+			int index = atoi(std::string(op["at"].getValue()).c_str());
+			const entnode& after = op["after"];
+			if (&after != EntNode::SEARCH_404) {
+				const entnode& anchor = (*node)[after.getValueUQ()];
+				if(&anchor != EntNode::SEARCH_404)
+					index = node->getChildIndex(&anchor) + 1;
+			}
+			if(index < 0 || index > node->getChildCount())
+				index = node->getChildCount();
+
+			ParseResult parseresult = parser.EditTree(op["text"].getValueUQ(), node, index, 0, false, true);
+			if (!parseresult.success) {
+				std::string msg = "Could not insert nodes (diff line " + std::to_string(parseresult.errorLineNum) + "): " + parseresult.errorMessage;
+				entdiff_logwarning(logfile, type, path, msg);
+			}
+		}
+		else entdiff_logwarning(logfile, type, path, "Unknown operation! Skipping");
+	}
+
+	#if entityparser_history
+	parser.PushGroupCommand();
+	#endif
+	EntityLogger::log("Tree Diff Imported Successfully");
+}
@@ -1,7 +1,40 @@
+#include <vector>
+#include <string>
+
 class EntNode;
 class EntityParser;
 
 namespace EntityDiff {
-	void Export(const EntNode& vanilla, const EntNode& modded, const char* outputpath);
+	/* Number of entities given each type of entry in an exported diff */
+	struct ExportStats {
+		size_t deleted = 0;
+		size_t added = 0;
+		size_t edited = 0;
+		size_t renamed = 0;
+		size_t moved = 0;
+	};
+
+	/*
+	* @param maxThreads Upper limit on the threads comparing entities. 0 to use every core
+	*/
+	ExportStats Export(const EntNode& vanilla, const EntNode& modded, const char* outputpath, unsigned maxThreads = 0);
 	void Import(EntityParser& parser, const EntNode& diff, const char* LOGPATH, const char* FILENAME);
+
+	/*
+	* Imports several diffs in one pass. Changes that conflict between diffs are found up front
+	* and skipped, identical changes are applied once, and everything else is applied together
+	* @param diffnames Name of each diff, for the log
+	*/
+	void ImportMany(EntityParser& parser, const std::vector<const EntNode*>& diffs, const std::vector<std::string>& diffnames,
+		const char* LOGPATH, const char* FILENAME);
+
+	/*
+	* Structure-agnostic diffs for JSON and permissive files, which don't have entityDef names
+	* to match. Objects are matched by their children's names, and arrays are diffed as sequences
+	*/
+	void ExportTree(const EntNode& vanilla, const EntNode& modded, const char* outputpath);
+	void ImportTree(EntityParser& parser, const EntNode& diff, const char* LOGPATH, const char* FILENAME);
+
+	/* True if the diff was written by ExportTree */
+	bool IsTreeDiff(const EntNode& diff);
 }
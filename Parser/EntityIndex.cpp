@@ -0,0 +1,427 @@
+#include "EntityIndex.h"
+#include "EntityNode.h"
+#include "EntityQuery.h"
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+const std::string_view EntityIndex::NO_LAYERS = "No Layers";
+const std::string_view EntityIndex::NO_COMPONENTS = "No Components";
+const float EntityIndex::CELL_SIZE = 512.0f;
+
+/* Cell coordinates are clamped to 21 bits so all three fit in one key */
+const int32_t CELL_LIMIT = (1 << 20) - 1;
+
+int32_t entindex_cell(float coordinate)
+{
+	float cell = std::floor(coordinate / EntityIndex::CELL_SIZE);
+	if(cell < -CELL_LIMIT)
+		return -CELL_LIMIT;
+	if(cell > CELL_LIMIT)
+		return CELL_LIMIT;
+	return (int32_t)cell;
+}
+
+uint64_t entindex_cellkey(int32_t x, int32_t y, int32_t z)
+{
+	const uint64_t mask = (1ULL << 21) - 1;
+	return ((uint64_t)(x + CELL_LIMIT) & mask) << 42 | ((uint64_t)(y + CELL_LIMIT) & mask) << 21 
+		| ((uint64_t)(z + CELL_LIMIT) & mask);
+}
+
+/*
+* Parses a coordinate the way std::stof would, without allocating or throwing
+* @return False if the value doesn't begin with a finite number
+*/
+bool entindex_parsefloat(std::string_view value, float& result)
+{
+	char buffer[64];
+	std::string fallback;
+	const char* text = buffer;
+	if (value.length() < sizeof(buffer)) {
+		memcpy(buffer, value.data(), value.length());
+		buffer[value.length()] = '\0';
+	}
+	else {
+		fallback = std::string(value);
+		text = fallback.c_str();
+	}
+
+	char* end;
+	errno = 0;
+	result = strtof(text, &end);
+	return end != text && errno != ERANGE && std::isfinite(result);
+}
+
+void EntityIndex::addValue(Facet facet, std::string_view value, size_t slot)
+{
+	auto iter = facets[facet].find(value);
+	if (iter == facets[facet].end()) {
+		Posting* p = new Posting;
+		p->value = std::string(value);
+		iter = facets[facet].emplace(p->value, p).first;
+	}
+
+	// An entity with a repeated value (i.e. the same layer twice) is only counted once
+	Posting* posting = iter->second.get();
+	if(posting->entities.test(slot))
+		return;
+	posting->entities.set(slot);
+	posting->count++;
+	slotValues[slot].push_back(posting);
+}
+
+void EntityIndex::Build(const EntNode& root)
+{
+	Clear();
+	entities.reserve(root.getChildCount());
+	slotValues.reserve(root.getChildCount());
+	positions.reserve(root.getChildCount());
+	slotOf.reserve(root.getChildCount());
+	for(int i = 0; i < root.getChildCount(); i++)
+		Add(root.ChildAt(i));
+}
+
+void EntityIndex::Clear()
+{
+	for(auto& facet : facets)
+		facet.clear();
+	slotOf.clear();
+	entities.clear();
+	slotValues.clear();
+	freeSlots.clear();
+	positions.clear();
+	grid.clear();
+	text.Clear();
+	textIndexed = false;
+	for (View& v : views) {
+		v.entities.clear();
+		v.count = 0;
+	}
+	viewsRevision++;
+}
+
+void EntityIndex::Add(EntNode* entity)
+{
+	size_t slot;
+	if (freeSlots.empty()) {
+		slot = entities.size();
+		entities.push_back(entity);
+		slotValues.emplace_back();
+		positions.emplace_back();
+	}
+	else {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+		entities[slot] = entity;
+	}
+	slotOf[entity] = slot;
+
+	EntNode& entityDef = (*entity)["entityDef"];
+	{
+		std::string_view className = EntityFields::Class(*entity);
+		if(!className.empty())
+			addValue(FACET_CLASS, className, slot);
+	}
+	{
+		EntNode& inheritNode = entityDef["inherit"];
+		if(inheritNode.ValueLength() > 0)
+			addValue(FACET_INHERIT, inheritNode.getValueUQ(), slot);
+	}
+	{
+		EntNode& idNode = (*entity)["instanceId"];
+		if(idNode.ValueLength() > 0)
+			addValue(FACET_INSTANCEID, idNode.getValue(), slot);
+	}
+	{
+		EntNode& layerNode = (*entity)["layers"];
+		if(layerNode.getChildCount() == 0)
+			addValue(FACET_LAYER, NO_LAYERS, slot);
+		for(int i = 0; i < layerNode.getChildCount(); i++)
+			addValue(FACET_LAYER, layerNode[i].getNameUQ(), slot);
+	}
+	{
+		EntNode& compNode = EntityFields::Path(entityDef, "edit/components");
+		if(compNode.getChildCount() == 0)
+			addValue(FACET_COMPONENT, NO_COMPONENTS, slot);
+		for (int i = 0; i < compNode.getChildCount(); i++) {
+			EntNode& className = compNode[i]["className"];
+			if(className.ValueLength() > 0)
+				addValue(FACET_COMPONENT, className.getValueUQ(), slot);
+		}
+	}
+	addPosition(*entity, slot);
+	if(textIndexed)
+		text.Add(slot, *entity);
+	for (View& v : views) {
+		if(!v.query->Matches(*entity))
+			continue;
+		v.entities.set(slot);
+		v.count++;
+		viewsRevision++;
+	}
+}
+
+void EntityIndex::Remove(const EntNode* entity)
+{
+	auto iter = slotOf.find(entity);
+	if(iter == slotOf.end())
+		return;
+	size_t slot = iter->second;
+	slotOf.erase(iter);
+
+	for (Posting* p : slotValues[slot]) {
+		p->entities.reset(slot);
+		p->count--;
+	}
+	slotValues[slot].clear();
+	removePosition(slot);
+	if(textIndexed)
+		text.Remove(slot);
+	for (View& v : views) {
+		if(!v.entities.test(slot))
+			continue;
+		v.entities.reset(slot);
+		v.count--;
+		viewsRevision++;
+	}
+	entities[slot] = nullptr;
+	freeSlots.push_back(slot);
+}
+
+void EntityIndex::Update(EntNode* entity)
+{
+	auto iter = slotOf.find(entity);
+	if(iter == slotOf.end())
+		return;
+
+	// The entity gets it's slot back, so views only changed if it's membership did
+	size_t slot = iter->second;
+	uint64_t revision = viewsRevision;
+	std::vector<bool> inViews(views.size());
+	for(size_t i = 0; i < views.size(); i++)
+		inViews[i] = views[i].entities.test(slot);
+
+	Remove(entity);
+	Add(entity);
+
+	bool changed = false;
+	for(size_t i = 0; i < views.size(); i++)
+		changed |= inViews[i] != views[i].entities.test(slot);
+	if(!changed)
+		viewsRevision = revision;
+}
+
+void EntityIndex::Match(Facet facet, const std::vector<std::string>& values, EntityBitset& result) const
+{
+	result.clear();
+	for (const std::string& v : values) {
+		auto iter = facets[facet].find(v);
+		if(iter != facets[facet].end())
+			result.OrWith(iter->second->entities);
+	}
+}
+
+size_t EntityIndex::ValueCount(Facet facet, std::string_view value) const
+{
+	auto iter = facets[facet].find(value);
+	return iter == facets[facet].end() ? 0 : iter->second->count;
+}
+
+void EntityIndex::GetValues(Facet facet, std::set<std::string_view>& result) const
+{
+	for (const auto& pair : facets[facet])
+		if(pair.second->count > 0)
+			result.insert(pair.first);
+}
+
+void EntityIndex::IndexText()
+{
+	if(textIndexed)
+		return;
+	for(size_t slot = 0; slot < entities.size(); slot++)
+		if(entities[slot] != nullptr)
+			text.Add(slot, *entities[slot]);
+	textIndexed = true;
+}
+
+bool EntityIndex::MatchText(const std::vector<std::string>& keys, EntityBitset& result) const
+{
+	result.clear();
+	if(!textIndexed)
+		return false;
+
+	EntityBitset candidates;
+	for (const std::string& key : keys) {
+		if(!text.Candidates(key, candidates))
+			return false;
+		result.OrWith(candidates);
+	}
+	return true;
+}
+
+void EntityIndex::addPosition(const EntNode& entity, size_t slot)
+{
+	// If a coordinate is undefined, it's assumed to be 0
+	Position& p = positions[slot];
+	p = Position();
+	EntNode& positionNode = EntityFields::Path(entity, "entityDef/edit/spawnPosition");
+	p.state = &positionNode == EntNode::SEARCH_404 ? POSITION_DEFAULT : POSITION_DEFINED;
+
+	struct { const char* name; float& coordinate; } axes[] = {
+		{"x", p.x}, {"y", p.y}, {"z", p.z}
+	};
+	for (const auto& axis : axes) {
+		EntNode& coordinateNode = positionNode[axis.name];
+		if(&coordinateNode == EntNode::SEARCH_404)
+			continue;
+		if (!entindex_parsefloat(coordinateNode.getValue(), axis.coordinate)) {
+			p.state = POSITION_INVALID;
+			return;
+		}
+	}
+	grid[entindex_cellkey(entindex_cell(p.x), entindex_cell(p.y), entindex_cell(p.z))].push_back(slot);
+}
+
+void EntityIndex::removePosition(size_t slot)
+{
+	Position& p = positions[slot];
+	if (p.state != POSITION_INVALID) {
+		auto iter = grid.find(entindex_cellkey(entindex_cell(p.x), entindex_cell(p.y), entindex_cell(p.z)));
+		std::vector<size_t>& cell = iter->second;
+		*std::find(cell.begin(), cell.end(), slot) = cell.back();
+		cell.pop_back();
+		if(cell.empty())
+			grid.erase(iter);
+	}
+	p = Position();
+}
+
+template <typename Visitor>
+bool EntityIndex::visitCells(float minX, float minY, float minZ, float maxX, float maxY, float maxZ, const Visitor& visit) const
+{
+	int32_t loX = entindex_cell(minX), loY = entindex_cell(minY), loZ = entindex_cell(minZ);
+	int32_t hiX = entindex_cell(maxX), hiY = entindex_cell(maxY), hiZ = entindex_cell(maxZ);
+	double cellCount = ((double)hiX - loX + 1) * ((double)hiY - loY + 1) * ((double)hiZ - loZ + 1);
+
+	if (cellCount > (double)grid.size()) {
+		for (const auto& pair : grid)
+			for (size_t slot : pair.second)
+				visit(slot);
+		return true;
+	}
+
+	for(int32_t x = loX; x <= hiX; x++)
+	for(int32_t y = loY; y <= hiY; y++)
+	for (int32_t z = loZ; z <= hiZ; z++) {
+		auto iter = grid.find(entindex_cellkey(x, y, z));
+		if(iter == grid.end())
+			continue;
+		for (size_t slot : iter->second)
+			visit(slot);
+	}
+	return false;
+}
+
+bool EntityIndex::GetPosition(const EntNode* entity, float& x, float& y, float& z) const
+{
+	auto iter = slotOf.find(entity);
+	if(iter == slotOf.end())
+		return false;
+	const Position& p = positions[iter->second];
+	if(p.state == POSITION_INVALID)
+		return false;
+	x = p.x;
+	y = p.y;
+	z = p.z;
+	return true;
+}
+
+void EntityIndex::MatchRegions(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, EntityBitset& result) const
+{
+	result.clear();
+	for (const Sphere& s : spheres) {
+		// Eliminates need to take square root in every distance calculation
+		float r = std::fabs(s.r), maxR2 = r * r;
+		visitCells(s.x - r, s.y - r, s.z - r, s.x + r, s.y + r, s.z + r, [&](size_t slot) {
+			const Position& p = positions[slot];
+			float dx = p.x - s.x, dy = p.y - s.y, dz = p.z - s.z;
+			if(dx * dx + dy * dy + dz * dz <= maxR2)
+				result.set(slot);
+		});
+	}
+	for (const Box& b : boxes) {
+		visitCells(b.minX, b.minY, b.minZ, b.maxX, b.maxY, b.maxZ, [&](size_t slot) {
+			const Position& p = positions[slot];
+			if(p.x >= b.minX && p.x <= b.maxX && p.y >= b.minY && p.y <= b.maxY && p.z >= b.minZ && p.z <= b.maxZ)
+				result.set(slot);
+		});
+	}
+}
+
+void EntityIndex::Nearest(float x, float y, float z, size_t count, std::vector<EntNode*>& result) const
+{
+	result.clear();
+	if(count == 0)
+		return;
+
+	/*
+	* Search spheres of doubling radius until one holds enough entities. Every entity within
+	* the radius is found, so the nearest of them are the nearest overall
+	*/
+	std::vector<std::pair<float, size_t>> found;
+	for (float r = CELL_SIZE; ; r *= 2) {
+		found.clear();
+		float maxR2 = r * r;
+		bool visitedAll = visitCells(x - r, y - r, z - r, x + r, y + r, z + r, [&](size_t slot) {
+			const Position& p = positions[slot];
+			if(p.state != POSITION_DEFINED)
+				return;
+			float dx = p.x - x, dy = p.y - y, dz = p.z - z;
+			found.emplace_back(dx * dx + dy * dy + dz * dz, slot);
+		});
+
+		if (!visitedAll) {
+			found.erase(std::remove_if(found.begin(), found.end(), [&](const std::pair<float, size_t>& f) {
+				return f.first > maxR2;
+			}), found.end());
+			if(found.size() < count)
+				continue;
+		}
+		break;
+	}
+
+	size_t resultCount = std::min(count, found.size());
+	std::partial_sort(found.begin(), found.begin() + resultCount, found.end());
+	for(size_t i = 0; i < resultCount; i++)
+		result.push_back(entities[found[i].second]);
+}
+
+void EntityIndex::SaveView(const std::string& name, std::shared_ptr<const EntityQuery> query)
+{
+	auto iter = std::find_if(views.begin(), views.end(), [&name](const View& v) { return v.name == name; });
+	if (iter == views.end()) {
+		views.emplace_back();
+		iter = views.end() - 1;
+		iter->name = name;
+	}
+
+	View& view = *iter;
+	view.query = std::move(query);
+	view.query->Run(*this, view.entities);
+	view.count = 0;
+	for(size_t slot = 0; slot < entities.size(); slot++)
+		view.count += view.entities.test(slot);
+	viewsRevision++;
+}
+
+void EntityIndex::RemoveView(const std::string& name)
+{
+	auto iter = std::find_if(views.begin(), views.end(), [&name](const View& v) { return v.name == name; });
+	if(iter == views.end())
+		return;
+	views.erase(iter);
+	viewsRevision++;
+}
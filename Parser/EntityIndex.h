@@ -0,0 +1,233 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <memory>
+#include <set>
+#include <cstdint>
+#include "TrigramIndex.h"
+
+class EntNode;
+class EntityQuery;
+
+/* Spherical region around a point */
+struct Sphere {
+	float x = 0;
+	float y = 0;
+	float z = 0;
+	float r = 0; // Radius
+};
+
+/* Axis-aligned box region */
+struct Box {
+	float minX = 0, minY = 0, minZ = 0;
+	float maxX = 0, maxY = 0, maxZ = 0;
+};
+
+/* Set of entity slots in an EntityIndex */
+class EntityBitset
+{
+	std::vector<uint64_t> words;
+
+	public:
+	void set(size_t slot)
+	{
+		if(slot / 64 >= words.size())
+			words.resize(slot / 64 + 1, 0);
+		words[slot / 64] |= 1ULL << (slot % 64);
+	}
+
+	void reset(size_t slot)
+	{
+		if(slot / 64 < words.size())
+			words[slot / 64] &= ~(1ULL << (slot % 64));
+	}
+
+	bool test(size_t slot) const
+	{
+		return slot / 64 < words.size() && (words[slot / 64] >> (slot % 64)) & 1;
+	}
+
+	void clear()
+	{
+		words.clear();
+	}
+
+	void OrWith(const EntityBitset& other)
+	{
+		if(other.words.size() > words.size())
+			words.resize(other.words.size(), 0);
+		for(size_t i = 0; i < other.words.size(); i++)
+			words[i] |= other.words[i];
+	}
+
+	void AndWith(const EntityBitset& other)
+	{
+		if(words.size() > other.words.size())
+			words.resize(other.words.size());
+		for(size_t i = 0; i < words.size(); i++)
+			words[i] &= other.words[i];
+	}
+};
+
+/*
+* Indexes the values of each entity's filterable properties (facets), so filters are applied
+* by intersecting bitsets instead of searching every entity. Every child of the root is given
+* a slot, and the index must be updated whenever an entity is added, removed or edited
+*/
+class EntityIndex
+{
+	public:
+	enum Facet {
+		FACET_CLASS,      // entityDef class, or systemVars entityType if there isn't one
+		FACET_INHERIT,
+		FACET_LAYER,      // Includes NO_LAYERS for entities without layers
+		FACET_COMPONENT,  // Component classNames. Includes NO_COMPONENTS for entities without components
+		FACET_INSTANCEID,
+		FACET_COUNT
+	};
+
+	static const std::string_view NO_LAYERS;
+	static const std::string_view NO_COMPONENTS;
+
+	/* Width of the spatial grid's cells, in world units */
+	static const float CELL_SIZE;
+
+	private:
+	/* Entities having one value of a facet. Values are stored with their quotes removed */
+	struct Posting {
+		std::string value;
+		EntityBitset entities;
+		size_t count = 0;
+	};
+
+	// Keys view the posting's value. Postings are never erased, so views of them stay valid
+	std::unordered_map<std::string_view, std::unique_ptr<Posting>> facets[FACET_COUNT];
+	std::unordered_map<const EntNode*, size_t> slotOf;
+	std::vector<EntNode*> entities;                // Slot -> entity, nullptr for free slots
+	std::vector<std::vector<Posting*>> slotValues; // Slot -> postings the entity is counted in
+	std::vector<size_t> freeSlots;
+
+	/*
+	* Parsed spawnPositions. Entities without one are placed at the origin, matching the spawn filter.
+	* Entities with unparseable coordinates aren't placed in the grid, so no region can match them
+	*/
+	enum PositionState : uint8_t {
+		POSITION_INVALID,
+		POSITION_DEFAULT, // No spawnPosition - excluded from nearest queries
+		POSITION_DEFINED
+	};
+	struct Position {
+		float x = 0, y = 0, z = 0;
+		PositionState state = POSITION_INVALID;
+	};
+	std::vector<Position> positions;                        // Slot -> position
+	std::unordered_map<uint64_t, std::vector<size_t>> grid; // Cell key -> slots positioned in the cell
+
+	// Built the first time text is searched, then maintained like the other indexes
+	TrigramIndex text;
+	bool textIndexed = false;
+
+	public:
+	/* A saved query, and the entities it currently matches */
+	struct View {
+		std::string name;
+		std::shared_ptr<const EntityQuery> query;
+		EntityBitset entities;
+		size_t count = 0;
+	};
+
+	private:
+	std::vector<View> views;
+	uint64_t viewsRevision = 0; // Incremented whenever a view is saved or removed, or its matches change
+
+	void addValue(Facet facet, std::string_view value, size_t slot);
+	void addPosition(const EntNode& entity, size_t slot);
+	void removePosition(size_t slot);
+
+	/*
+	* Calls visit(slot) for every positioned slot in the cells overlapping a box. When the box
+	* covers more cells than are occupied, every occupied cell is visited instead
+	* @return True if every occupied cell was visited
+	*/
+	template <typename Visitor>
+	bool visitCells(float minX, float minY, float minZ, float maxX, float maxY, float maxZ, const Visitor& visit) const;
+
+	public:
+	void Build(const EntNode& root);
+	void Clear();
+
+	void Add(EntNode* entity);
+	void Remove(const EntNode* entity);
+
+	/* Re-indexes an entity after it's properties were edited. Does nothing if it isn't indexed */
+	void Update(EntNode* entity);
+
+	/* @return The slot of an indexed entity, or SIZE_MAX if it isn't indexed */
+	size_t SlotOf(const EntNode* entity) const
+	{
+		auto iter = slotOf.find(entity);
+		return iter == slotOf.end() ? SIZE_MAX : iter->second;
+	}
+
+	/* Number of slots, including free ones */
+	size_t SlotCount() const { return entities.size(); }
+
+	/* @return The entity in a slot, or nullptr if the slot is free */
+	EntNode* EntityAt(size_t slot) const { return entities[slot]; }
+
+	/* Sets the slot of every entity having at least one of the values */
+	void Match(Facet facet, const std::vector<std::string>& values, EntityBitset& result) const;
+
+	/* Number of entities having a value */
+	size_t ValueCount(Facet facet, std::string_view value) const;
+
+	/* Adds every value at least one entity has. The views are valid until the index is cleared */
+	void GetValues(Facet facet, std::set<std::string_view>& result) const;
+
+	/* Builds the text index if it hasn't been built yet */
+	void IndexText();
+	bool TextIndexed() const { return textIndexed; }
+
+	/*
+	* Sets the slot of every entity that could contain at least one of the keys. Matches
+	* must still be verified by searching the entity's text
+	* @return False if the text index isn't built or a key is too short to look up
+	*/
+	bool MatchText(const std::vector<std::string>& keys, EntityBitset& result) const;
+
+	/*
+	* Gets an entity's parsed spawnPosition
+	* @return False if the entity isn't indexed or it's spawnPosition couldn't be parsed
+	*/
+	bool GetPosition(const EntNode* entity, float& x, float& y, float& z) const;
+
+	/*
+	* Sets the slot of every entity positioned inside at least one of the regions.
+	* Entities with a NaN coordinate are inside no region
+	*/
+	void MatchRegions(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, EntityBitset& result) const;
+	void MatchSphere(const Sphere& sphere, EntityBitset& result) const { MatchRegions({sphere}, {}, result); }
+	void MatchBox(const Box& box, EntityBitset& result) const { MatchRegions({}, {box}, result); }
+
+	/*
+	* Finds the entities with a defined spawnPosition nearest to a point
+	* @param result Receives up to count entities, nearest first
+	*/
+	void Nearest(float x, float y, float z, size_t count, std::vector<EntNode*>& result) const;
+
+	/*
+	* Saves a query as a view, replacing any view with the same name. The whole index is
+	* searched once - afterwards only the entities that are added, removed or edited are
+	* checked against it again
+	*/
+	void SaveView(const std::string& name, std::shared_ptr<const EntityQuery> query);
+	void RemoveView(const std::string& name);
+
+	/* Views in the order they were first saved. Clearing the index keeps them, but empties their matches */
+	const std::vector<View>& GetViews() const { return views; }
+
+	/* Changes whenever GetViews() would return something different */
+	uint64_t ViewsRevision() const { return viewsRevision; }
+};
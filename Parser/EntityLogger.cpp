@@ -1,6 +1,9 @@
-#include "wx/wx.h"
+#include "ParserConfig.h"
 #include "EntityLogger.h"
 
+#if entityparser_wxwidgets
+#include "wx/wx.h"
+
 void EntityLogger::log(const std::string& data)
 {
 	wxLogMessage("%s", data);
@@ -12,10 +15,40 @@ void EntityLogger::logWarning(const std::string& data)
 }
 
 void EntityLogger::logTimeStamps(const std::string& msg,
-	const std::chrono::steady_clock::time_point startTime)
+	const std::chrono::high_resolution_clock::time_point startTime)
 {
 	auto stopTime = std::chrono::high_resolution_clock::now();
 	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stopTime - startTime);
 
 	wxLogMessage("%s %zu", msg, duration.count());
-}
\ No newline at end of file
+}
+
+#else
+#include <cstdio>
+#include <mutex>
+
+// Headless builds may log from several threads at once
+std::mutex logMutex;
+
+void EntityLogger::log(const std::string& data)
+{
+	std::lock_guard<std::mutex> lock(logMutex);
+	printf("%s\n", data.c_str());
+}
+
+void EntityLogger::logWarning(const std::string& data)
+{
+	std::lock_guard<std::mutex> lock(logMutex);
+	fprintf(stderr, "Parser Warning: %s\n", data.c_str());
+}
+
+void EntityLogger::logTimeStamps(const std::string& msg,
+	const std::chrono::high_resolution_clock::time_point startTime)
+{
+	auto stopTime = std::chrono::high_resolution_clock::now();
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stopTime - startTime);
+
+	std::lock_guard<std::mutex> lock(logMutex);
+	printf("%s %lld\n", msg.c_str(), (long long)duration.count());
+}
+#endif
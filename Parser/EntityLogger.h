@@ -6,5 +6,5 @@ namespace EntityLogger
 	void log(const std::string& data);
 	void logWarning(const std::string& data);
 	void logTimeStamps(const std::string& msg, 
-		const std::chrono::steady_clock::time_point startTime);
+		const std::chrono::high_resolution_clock::time_point startTime);
 }
\ No newline at end of file
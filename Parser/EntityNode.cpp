@@ -1,7 +1,9 @@
+#include <cstring>
 #include <fstream>
 #include "Oodle.h"
 #include "EntityLogger.h"
 #include "EntityNode.h"
+#include "TextSearch.h"
 
 #if entityparser_wxwidgets
 #include "wx/string.h"
@@ -32,6 +34,61 @@ wxString EntNode::getValueWXUQ() {
 }
 #endif
 
+uint64_t EntNode::HashNode(uint16_t flags, std::string_view name, std::string_view value,
+	const EntNode* const* children, int childCount)
+{
+	// 64-bit MurmurHash mixing. Name and value lengths are hashed 
+	// so text can't shift between the two without changing the result
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	#define hashmix(V) { uint64_t k = (V) * m; k ^= k >> 47; h = (h ^ (k * m)) * m; }
+
+	uint64_t h = 0x8445d61a4e774912ULL;
+	hashmix(flags & ~(NF_Comma | NF_NoIndent));
+	for (std::string_view text : {name, value})
+	{
+		hashmix(text.length());
+		const char* data = text.data();
+		size_t length = text.length();
+		while (length >= 8) {
+			uint64_t block;
+			memcpy(&block, data, 8);
+			hashmix(block);
+			data += 8;
+			length -= 8;
+		}
+		if (length > 0) {
+			uint64_t block = 0;
+			memcpy(&block, data, length);
+			hashmix(block);
+		}
+	}
+
+	hashmix(childCount);
+	for(int i = 0; i < childCount; i++)
+		hashmix(children[i]->hash);
+	#undef hashmix
+
+	h ^= h >> 47;
+	h *= m;
+	h ^= h >> 47;
+	return h;
+}
+
+bool EntNode::SameTree(const EntNode& a, const EntNode& b)
+{
+	const uint16_t formatting = NF_Comma | NF_NoIndent;
+	if(a.hash != b.hash || a.childCount != b.childCount)
+		return false;
+	if((a.nodeFlags & ~formatting) != (b.nodeFlags & ~formatting))
+		return false;
+	if(a.getName() != b.getName() || a.getValue() != b.getValue())
+		return false;
+	for(int i = 0; i < a.childCount; i++)
+		if(!SameTree(*a.children[i], *b.children[i]))
+			return false;
+	return true;
+}
+
 bool EntNode::IsRoot() {
 	return parent == nullptr && nodeFlags == NFC_RootNode;
 }
@@ -113,41 +170,7 @@ EntNode* EntNode::FromPositionTrace(EntNode* root, const int* nodeIndices, const
 bool EntNode::searchText(const std::string& key, const bool caseSensitive, const bool exactLength)
 {
 	if(exactLength && key.length() != nameLength + valLength) return false;
-	if (caseSensitive)
-	{
-		std::string_view s(textPtr, nameLength + valLength);
-		return s.find(key) != std::string_view::npos;
-	}
-
-	int k = (int)key.length(), n = nameLength + valLength;
-	int max = n - k + 1; // Don't search where key can't fit.
-	int i = 0;
-
-	char fixedKey0 = key[0];
-	if(fixedKey0 > '`' && fixedKey0 < '{') fixedKey0 -= 32;
-
-	FAILED:
-	while (i < max)
-	{
-		char c1 = textPtr[i++];
-		if(c1 > '`' && c1 < '{') c1-= 32;
-
-		if (c1 == fixedKey0)
-		{
-			for (int j = 1; j < k; j++, i++)
-			{
-				c1 = textPtr[i]; if (c1 > '`' && c1 < '{') c1 -= 32;
-				char c2 = key[j]; if (c2 > '`' && c2 < '{') c2 -= 32;
-				// Do not increment i here: If we fail, we'll want to
-				// check the failing character to see if it == key[0]
-				if (c1 != c2)
-					goto FAILED;
-			}
-
-			return true;
-		}
-	}
-	return false;
+	return TextSearch::Contains(std::string_view(textPtr, nameLength + valLength), key, caseSensitive);
 }
 
 /*
@@ -188,6 +211,14 @@ EntNode* EntNode::searchDownwardsLocal(const std::string& key, const bool caseSe
 	return SEARCH_404;
 }
 
+void EntNode::searchAllLocal(const std::string& key, const bool caseSensitive, const bool exactLength, std::vector<EntNode*>& results)
+{
+	if(searchText(key, caseSensitive, exactLength))
+		results.push_back(this);
+	for (int i = 0; i < childCount; i++)
+		children[i]->searchAllLocal(key, caseSensitive, exactLength, results);
+}
+
 /*
 * Upward Searches require we:
 * - Do not check the children of the starting node
@@ -270,7 +301,8 @@ void EntNode::generateText(std::string& buffer, int wsIndex) const
 		buffer.push_back(',');
 }
 
-size_t EntNode::writeToFile(const std::string filepath, const size_t sizeHint, const bool oodleCompress, const char* eofblob, size_t eofbloblength, const bool debug_logTime)
+size_t EntNode::writeToFile(const std::string filepath, const size_t sizeHint, const bool oodleCompress, const Oodle::CompressionSettings& compression, 
+	const char* eofblob, size_t eofbloblength, const bool debug_logTime)
 {
 	auto timeStart = std::chrono::high_resolution_clock::now();
 	// 25% of time spent writing to output buffer, 75% on generateText
@@ -296,7 +328,7 @@ size_t EntNode::writeToFile(const std::string filepath, const size_t sizeHint, c
 	{
 		char* compressedData = new char[raw.length() + 65536];
 		size_t compressedSize;
-		if (Oodle::CompressBuffer(raw.data(), raw.length(), compressedData + 16, compressedSize)) {
+		if (Oodle::CompressBuffer(raw.data(), raw.length(), compressedData + 16, compressedSize, compression)) {
 			((size_t*)compressedData)[0] = raw.length();
 			((size_t*)compressedData)[1] = compressedSize;
 			output.write(compressedData, compressedSize + 16);
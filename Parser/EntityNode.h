@@ -1,6 +1,11 @@
+#include <string>
 #include <string_view>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <vector>
 #include "ParserConfig.h"
+#include "Oodle.h"
 
 #if entityparser_wxwidgets
 class wxString;
@@ -44,6 +49,7 @@ class EntNode
 	EntNode* parent = nullptr;
 	EntNode** children = nullptr; // Unused by value nodes
 	char* textPtr = nullptr; // Pointer to text buffer with data [name][value]
+	uint64_t hash = 0;       // Structural hash of this node and it's descendants. Set by the parser
 	int childCount = 0;
 	int maxChildren = 0;
 	short nameLength = 0;
@@ -127,6 +133,30 @@ class EntNode
 
 	int getChildCount() const {return childCount;}
 
+	/*
+	* Hash of this node's flags, name, value and the hashes of it's children, in order.
+	* Nodes with equal hashes can be treated as identical subtrees. Comma and indentation
+	* flags are only formatting and aren't hashed. The parser keeps every hash current,
+	* except the root node's which is only valid immediately after the initial parse
+	*/
+	uint64_t getHash() const {return hash;}
+
+	/* Recomputes this node's hash from it's text and the current hashes of it's children */
+	void computeHash() {
+		hash = HashNode(nodeFlags, getName(), getValue(), children, childCount);
+	}
+
+	/* Computes the hash a node with the given properties would have */
+	static uint64_t HashNode(uint16_t flags, std::string_view name, std::string_view value, 
+		const EntNode* const* children, int childCount);
+
+	/*
+	* Compares two subtrees node by node, for when a hash collision would lose data. Unequal
+	* hashes are rejected first, so only matches cost a full pass. Like the hash, it ignores
+	* formatting flags
+	*/
+	static bool SameTree(const EntNode& a, const EntNode& b);
+
 	const EntNode ListMapHack() const {
 		EntNode copy;
 		copy.textPtr = textPtr;
@@ -154,6 +184,9 @@ class EntNode
 		return *children[index];
 	}
 
+	// Checks this node's own filter flag, ignoring it's ancestors
+	bool isFilteredSelf() const { return filtered; }
+
 	// Checks whether node is filtered out, either by itself or one of it's ancestors
 	bool isFiltered() {
 		EntNode* node = this;
@@ -306,6 +339,9 @@ class EntNode
 
 	EntNode* searchDownwardsLocal(const std::string& key, const bool caseSensitive, const bool exactLength);
 
+	/* Appends every node in this subtree containing the key, in the order searchDownwardsLocal finds them */
+	void searchAllLocal(const std::string& key, const bool caseSensitive, const bool exactLength, std::vector<EntNode*>& results);
+
 	/*
 	* Searches up the node tree for the given key, starting with
 	* the node directly above this one.
@@ -335,8 +371,10 @@ class EntNode
 	* @param filepath File to write to
 	* @param sizeHint Estimation of the uncompressed file size
 	* @param oodleCompress If true, compress the file
+	* @param compression Compressor and level used when oodleCompress is true
 	* @param debug_logTime If true, output execution time data.
 	* @return The uncompressed file size
 	*/
-	size_t writeToFile(const std::string filepath, const size_t sizeHint, const bool oodleCompress, const char* eofblob, size_t eofbloblength, const bool debug_logTime = false);
+	size_t writeToFile(const std::string filepath, const size_t sizeHint, const bool oodleCompress, const Oodle::CompressionSettings& compression, 
+		const char* eofblob, size_t eofbloblength, const bool debug_logTime = false);
 };
\ No newline at end of file
@@ -1,15 +1,19 @@
 #pragma warning(disable : 4996) // Deprecation errors
 #include <fstream>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "Oodle.h"
 #include "EntityLogger.h"
 #include "EntityParser.h"
+#include "TextSearch.h"
 
 #if entityparser_wxwidgets
 #include "EntityEditor.h"
+#include "EntityTreeView.h"
 #include "FilterMenus.h"
 
-const std::string EntityParser::FILTER_NOLAYERS = "\"No Layers\"";
-const std::string EntityParser::FILTER_NOCOMPONENTS = "\"No Components\"";
 #endif
 
 enum TokenType : uint32_t
@@ -50,7 +54,8 @@ EntityParser::EntityParser() : fileWasCompressed(false), PARSEMODE(ParsingMode::
 
 EntityParser::EntityParser(ParsingMode mode) : fileWasCompressed(false), PARSEMODE(mode) {}
 
-EntityParser::EntityParser(const std::string& filepath, const ParsingMode mode, const bool debug_logParseTime)
+EntityParser::EntityParser(const std::string& filepath, const ParsingMode mode, const bool debug_logParseTime,
+	const bool decompressOnError)
 	: PARSEMODE(mode)
 {
 	auto timeStart = std::chrono::high_resolution_clock::now();
@@ -67,6 +72,9 @@ EntityParser::EntityParser(const std::string& filepath, const ParsingMode mode,
 	filebuffer_t raw;
 	filebuffer_t decomp;
 	std::string_view textView;
+	size_t compressedSize = 0;
+	bool streamed = false;     // If true, decompression runs alongside parsing
+	bool decompressed = false;
 
 	{
 		std::ifstream file(filepath, std::ios_base::binary); // Binary mode 50% faster than 'in' mode, keeps CR chars
@@ -87,11 +95,15 @@ EntityParser::EntityParser(const std::string& filepath, const ParsingMode mode,
 		fileWasCompressed = true;
 		decomp.len = ((size_t*)raw.data)[0];
 		decomp.data = new char[decomp.len];
-		size_t compressedSize = ((size_t*)raw.data)[1];
+		compressedSize = ((size_t*)raw.data)[1];
+		textView = std::string_view(decomp.data, decomp.len);
 
-		if (!Oodle::DecompressBuffer(raw.data + 16, compressedSize, decomp.data, decomp.len))
+		// Only the .entities grammar supports streamed parsing
+		if (PARSEMODE == ParsingMode::ENTITIES)
+			streamed = true;
+		else if (!Oodle::DecompressBuffer(raw.data + 16, compressedSize, decomp.data, decomp.len))
 			throw std::runtime_error("Could not decompress .entities file");
-		textView = std::string_view(decomp.data, decomp.len);
+		else decompressed = true;
 	}
 	else
 	{
@@ -103,15 +115,17 @@ EntityParser::EntityParser(const std::string& filepath, const ParsingMode mode,
 
 	if (debug_logParseTime)
 	{
-		EntityLogger::logTimeStamps("File Read/Decompress Duration: ", timeStart);
+		EntityLogger::logTimeStamps(streamed ? "File Read Duration: " : "File Read/Decompress Duration: ", timeStart);
 	}
 
 	try {
-		firstparse(textView, debug_logParseTime);
+		if(streamed)
+			streamparse(raw.data + 16, compressedSize, decomp.data, decomp.len, decompressed, debug_logParseTime);
+		else firstparse(textView, debug_logParseTime);
 
 	}
 	catch (std::runtime_error err) {
-		if (fileWasCompressed) {
+		if (decompressOnError && fileWasCompressed && decompressed) {
 			std::string msg = "Decompressing ";
 			msg.append(filepath);
 			msg.append(" so you can find and fix errors.");
@@ -165,46 +179,311 @@ void EntityParser::firstparse(std::string_view textView, const bool debuglog)
 		}
 	}
 
+	AllocEstimate estimate = estimateAllocations(counts, textView.length());
+	allocs.text.setActiveBuffer(estimate.text);
+	allocs.nodes.setActiveBuffer(estimate.nodes);
+	allocs.children.setActiveBuffer(estimate.nodes);
+
+	if (debuglog)
+	{
+		EntityLogger::logTimeStamps("Node Buffer Init Duration: ", timeStart);
+		timeStart = std::chrono::high_resolution_clock::now();
+	}
+
+	ParseResult presult;
+	initiateParse(textView, &root, &root, presult);
+	facets.Build(root);
+
+	if (debuglog)
+		EntityLogger::logTimeStamps("Parsing Duration: ", timeStart);
+}
+
+void EntityParser::StreamInput(std::string_view chunk)
+{
+	if (inputStream.finished)
+		throw std::runtime_error("Stream input received after the stream was finished");
+
+	if (inputStream.textEnded) {
+		inputStream.blob.append(chunk);
+		return;
+	}
+
+	// Histogram the text, splitting the chunk at a null terminator
+	size_t counts[256] = { 0 };
+	const uint8_t* iter = reinterpret_cast<const uint8_t*>(chunk.data());
+	const uint8_t* itermax = iter + chunk.length();
+	while (iter < itermax) {
+		if (*iter == '\0')
+			break;
+		counts[*iter]++;
+		iter++;
+	}
+	size_t textLength = (const char*)iter - chunk.data();
+	if (textLength < chunk.length()) {
+		inputStream.textEnded = true;
+		inputStream.blob.append(chunk.substr(textLength + 1));
+	}
+	inputStream.buffer.append(chunk.data(), textLength);
+	inputStream.textLength += textLength;
+
+	if(PARSEMODE != ParsingMode::ENTITIES)
+		return;
+
+	// The first chunk sizes the active buffers, and later buffers are sized
+	// in proportion to the chunks being received
+	AllocEstimate estimate = estimateAllocations(counts, textLength);
+	if (!inputStream.started) {
+		inputStream.started = true;
+		inputStream.defaultBuffers[0] = allocs.text.getNewBufferLength();
+		inputStream.defaultBuffers[1] = allocs.nodes.getNewBufferLength();
+		inputStream.defaultBuffers[2] = allocs.children.getNewBufferLength();
+		allocs.text.setActiveBuffer(estimate.text);
+		allocs.nodes.setActiveBuffer(estimate.nodes);
+		allocs.children.setActiveBuffer(estimate.nodes);
+		tempChildren.push_back(&root);
+		retryLength = 0;
+	}
+	else {
+		allocs.text.setNewBufferLength(std::max(inputStream.defaultBuffers[0], estimate.text));
+		allocs.nodes.setNewBufferLength(std::max(inputStream.defaultBuffers[1], estimate.nodes));
+		allocs.children.setNewBufferLength(std::max(inputStream.defaultBuffers[2], estimate.nodes));
+	}
+	streamParseBuffer();
+}
+
+void EntityParser::StreamFinish()
+{
+	if (inputStream.finished)
+		return;
+
+	if (PARSEMODE == ParsingMode::ENTITIES) {
+		if(!inputStream.started)
+			StreamInput("");
+		inputStream.textEnded = true;
+		streamParseBuffer();
+		setNodeChildren(1);
+		tempChildren.pop_back();
+		tempChildren.shrink_to_fit();
+		facets.Build(root);
+
+		allocs.text.setNewBufferLength(inputStream.defaultBuffers[0]);
+		allocs.nodes.setNewBufferLength(inputStream.defaultBuffers[1]);
+		allocs.children.setNewBufferLength(inputStream.defaultBuffers[2]);
+	}
+	else firstparse(inputStream.buffer, false);
+	inputStream.finished = true;
+
+	if (!inputStream.blob.empty()) {
+		eofbloblength = inputStream.blob.length();
+		eofblob = new char[eofbloblength];
+		memcpy(eofblob, inputStream.blob.data(), eofbloblength);
+	}
+	lastUncompressedSize = inputStream.textLength;
+	std::string().swap(inputStream.buffer);
+	std::string().swap(inputStream.blob);
+}
+
+/*
+* Parses every complete top-level item in the stream buffer, then discards
+* the parsed input once it makes up most of the buffer
+*/
+void EntityParser::streamParseBuffer()
+{
+	std::string& buffer = inputStream.buffer;
+	firstChar = buffer.data();
+	ch = firstChar + inputStream.parsed;
+	endchar = firstChar + buffer.length();
+	errorLine = inputStream.lineBase + 1;
+	inputFinal = inputStream.textEnded;
+
+	try {
+		parseFileIncremental();
+	}
+	catch (...) {
+		inputFinal = true;
+		inputStream.finished = true;
+		throw;
+	}
+	inputFinal = true;
+	inputStream.parsed = ch - firstChar;
+
+	if (inputStream.parsed > buffer.length() / 2) {
+		inputStream.lineBase += std::count(buffer.begin(), buffer.begin() + inputStream.parsed, '\n');
+		buffer.erase(0, inputStream.parsed);
+		inputStream.parsed = 0;
+	}
+}
+
+EntityParser::AllocEstimate EntityParser::estimateAllocations(const size_t* counts, size_t textLength)
+{
+	AllocEstimate estimate;
+
 	// Distinguishes between the number of chars comprising actual identifiers/values versus syntax chars
 	if (PARSEMODE == ParsingMode::JSON) {
-		size_t charBufferSize = textView.length()
+		estimate.text = textLength
 			- counts['\t'] - counts['\n'] - counts['\r'] - counts['}'] - counts['{']
 			- counts[':'] - counts[','] - counts['['] - counts[']'] - counts[' ']
 			+ 100000;
-		allocs.text.setActiveBuffer(charBufferSize);
 
 		// This should give us an exact count of how many nodes exist in the file
-		size_t nodeCount = counts[','] + counts['{'] + counts['['] + 1000;
-		allocs.nodes.setActiveBuffer(nodeCount);
-		allocs.children.setActiveBuffer(nodeCount);
+		estimate.nodes = counts[','] + counts['{'] + counts['['] + 1000;
 	}
 	else {
-		size_t charBufferSize = textView.length()
+		estimate.text = textLength
 			- counts['\t'] - counts['\n'] - counts['\r'] - counts['}'] - counts['{'] - counts[';']
 			- counts['=']
 			- counts[' '] // This is an overestimate - string values will uncommonly contain spaces
 			+ 100000;
-		allocs.text.setActiveBuffer(charBufferSize);
 
 		// For a well-formatted .entities file, we can get an exact count of how many nodes we must
 		// allocate by subtracting the number of closing braces from the number of lines
 		size_t numCloseBraces = counts['}'] > counts['\n'] ? counts['\n'] : counts['}']; // Prevents disastrous overflow
-		size_t initialBufferSize = counts['\n'] - numCloseBraces + 1000;
-		allocs.nodes.setActiveBuffer(initialBufferSize);
-		allocs.children.setActiveBuffer(initialBufferSize);
+		estimate.nodes = counts['\n'] - numCloseBraces + 1000;
 	}
+	return estimate;
+}
 
-	if (debuglog)
-	{
-		EntityLogger::logTimeStamps("Node Buffer Init Duration: ", timeStart);
-		timeStart = std::chrono::high_resolution_clock::now();
-	}
+void EntityParser::streamparse(char* compressed, size_t compressedLength, char* output, size_t outputLength, 
+	bool& decompressed, const bool debuglog)
+{
+	/*
+	* Oodle reports every decoded block through a callback on the worker thread, which 
+	* adds the block to the character histogram and publishes it to the parsing thread.
+	* The output must remain one contiguous buffer: LZ matches may reference anything
+	* decoded before them, so blocks can't be handed off and recycled.
+	*/
+	struct stream_t {
+		char* output;
+		size_t outputLength;
+		size_t counted = 0;                // Worker thread only: length of the text added to workerCounts
+		size_t workerCounts[256] = { 0 };  // Worker thread only: histogram of the text decoded so far
+
+		std::mutex mutex;
+		std::condition_variable signal;
+		size_t counts[256] = { 0 }; // Published copy of workerCounts
+		size_t textLength = 0;      // Length of the text available to the parser
+		bool textEnded = false;     // True once the null byte or end of the output is decoded
+		bool finished = false;
+		bool success = false;
+
+		static bool progress(void* context, size_t bytesDecoded)
+		{
+			stream_t* s = (stream_t*)context;
+			if(s->textEnded) // Decoding the eof blob - no need to synchronize
+				return true;
+
+			const uint8_t* start = reinterpret_cast<const uint8_t*>(s->output);
+			const uint8_t* iter = start + s->counted;
+			const uint8_t* itermax = start + bytesDecoded;
+			while (iter < itermax) {
+				if (*iter == '\0')
+					break;
+				s->workerCounts[*iter]++;
+				iter++;
+			}
+			s->counted = iter - start;
+
+			std::lock_guard<std::mutex> lock(s->mutex);
+			memcpy(s->counts, s->workerCounts, sizeof(s->counts));
+			s->textLength = s->counted;
+			s->textEnded = iter < itermax || bytesDecoded == s->outputLength;
+			s->signal.notify_one();
+			return true;
+		}
+	} stream;
+	stream.output = output;
+	stream.outputLength = outputLength;
 
-	ParseResult presult;
-	initiateParse(textView, &root, &root, presult);
+	auto timeStart = std::chrono::high_resolution_clock::now();
+	std::thread worker([&]() {
+		bool success = Oodle::DecompressBufferProgressive(compressed, compressedLength, output, outputLength, stream_t::progress, &stream);
+
+		std::lock_guard<std::mutex> lock(stream.mutex);
+		stream.success = success;
+		stream.finished = true;
+		stream.textEnded = true;
+		stream.signal.notify_one();
+	});
+
+	const size_t defaultTextBuffer = allocs.text.getNewBufferLength();
+	const size_t defaultNodeBuffer = allocs.nodes.getNewBufferLength();
+	const size_t defaultChildBuffer = allocs.children.getNewBufferLength();
+	AllocEstimate initial = {0, 0};
+	size_t textLength = 0;
+
+	firstChar = output;
+	ch = output;
+	errorLine = 1;
+	retryLength = 0;
+	tempChildren.push_back(&root);
+
+	try {
+		for(bool textEnded = false; ; ) 
+		{
+			size_t counts[256];
+			{
+				std::unique_lock<std::mutex> lock(stream.mutex);
+				stream.signal.wait(lock, [&] { return stream.textEnded || stream.textLength > textLength; });
+				if (stream.finished && !stream.success)
+					throw std::runtime_error("Could not decompress .entities file");
+				memcpy(counts, stream.counts, sizeof(counts));
+				textLength = stream.textLength;
+				textEnded = stream.textEnded;
+			}
+
+			// Project the histogram of the decoded text onto the entire output. The first
+			// projection sizes the active buffers, later ones size any buffers needed beyond them
+			if (!textEnded && textLength > 0) {
+				double scale = (double)outputLength / textLength;
+				for(size_t& c : counts)
+					c = (size_t)(c * scale);
+			}
+			AllocEstimate estimate = estimateAllocations(counts, textEnded ? textLength : outputLength);
+			if (initial.text == 0) {
+				initial = estimate;
+				allocs.text.setActiveBuffer(estimate.text);
+				allocs.nodes.setActiveBuffer(estimate.nodes);
+				allocs.children.setActiveBuffer(estimate.nodes);
+			}
+			else {
+				if(estimate.text > initial.text)
+					allocs.text.setNewBufferLength(std::max(defaultTextBuffer, estimate.text - initial.text));
+				if (estimate.nodes > initial.nodes) {
+					allocs.nodes.setNewBufferLength(std::max(defaultNodeBuffer, estimate.nodes - initial.nodes));
+					allocs.children.setNewBufferLength(std::max(defaultChildBuffer, estimate.nodes - initial.nodes));
+				}
+			}
+
+			endchar = output + textLength;
+			inputFinal = textEnded;
+			if(parseFileIncremental())
+				break;
+		}
+		setNodeChildren(1);
+		tempChildren.pop_back();
+		tempChildren.shrink_to_fit();
+		facets.Build(root);
+	}
+	catch (...) {
+		inputFinal = true;
+		worker.join();
+		decompressed = stream.success;
+		throw;
+	}
+	worker.join();
+	if(!stream.success)
+		throw std::runtime_error("Could not decompress .entities file");
+	decompressed = true;
+
+	// Binary blob after the text's null terminator
+	if (textLength < outputLength) {
+		eofbloblength = outputLength - textLength - 1;
+		eofblob = new char[eofbloblength];
+		memcpy(eofblob, output + textLength + 1, eofbloblength);
+	}
 
 	if (debuglog)
-		EntityLogger::logTimeStamps("Parsing Duration: ", timeStart);
+		EntityLogger::logTimeStamps("Decompression and Parsing Duration: ", timeStart);
 }
 
 /*
@@ -234,6 +513,236 @@ ParseResult EntityParser::EditTree(const std::string_view text, EntNode* parent,
 	initiateParse(text, &tempRoot, parent, outcome);
 	if(!outcome.success) return outcome;
 
+	mergeChildren(tempRoot, parent, insertionIndex, removeCount, renumberLists, highlightNew);
+	return outcome;
+}
+
+/* Whether two nodes are objects with the same text, so one's children can be edited to match the other's */
+bool SameContainer(const EntNode& a, const EntNode& b)
+{
+	return a.getChildBuffer() != nullptr && b.getChildBuffer() != nullptr
+		&& (a.getFlags() & ~EntNode::NF_Comma) == (b.getFlags() & ~EntNode::NF_Comma)
+		&& a.getName() == b.getName() && a.getValue() == b.getValue();
+}
+
+ParseResult EntityParser::EditNodeText(const std::string_view text, EntNode* node, bool renumberLists, bool highlightNew)
+{
+	ParseResult outcome;
+	EntNode* parent = node->parent;
+
+	// The whole text is parsed, so errors are still reported with the right line numbers
+	EntNode tempRoot(EntNode::NFC_RootNode);
+	initiateParse(text, &tempRoot, parent, outcome);
+	if(!outcome.success) return outcome;
+
+	if (tempRoot.childCount != 1 || !SameContainer(*node, *tempRoot.children[0])) {
+		mergeChildren(tempRoot, parent, parent->getChildIndex(node), 1, renumberLists, highlightNew);
+		return outcome;
+	}
+
+	#if entityparser_wxwidgets
+	NotificationBatch batch(this);
+	#endif
+	EntNode* fresh = tempRoot.children[0];
+	allocs.children.freeBlock(tempRoot.children, tempRoot.maxChildren);
+	mergeChanges(node, fresh, false, highlightNew);
+	freeNode(fresh);
+
+	// Renumber the same nodes EditTree would have. Only misnumbered items are edited
+	if (renumberLists) {
+		fixListNumberings(node, true, false);
+		if(parent != &root)
+			fixListNumberings(parent, false, false);
+	}
+	return outcome;
+}
+
+void EntityParser::mergeChanges(EntNode* live, EntNode* fresh, bool renumberLists, bool highlightNew)
+{
+	int liveCount = live->childCount;
+	int freshCount = fresh->childCount;
+	int prefix = 0, suffix = 0;
+
+	// Children kept from the live node are confirmed identical, so a hash collision can't drop an edit
+	while (prefix < liveCount && prefix < freshCount
+		&& EntNode::SameTree(*live->children[prefix], *fresh->children[prefix]))
+		prefix++;
+	while (suffix < liveCount - prefix && suffix < freshCount - prefix
+		&& EntNode::SameTree(*live->children[liveCount - 1 - suffix], *fresh->children[freshCount - 1 - suffix]))
+		suffix++;
+
+	int removeCount = liveCount - prefix - suffix;
+	int insertCount = freshCount - prefix - suffix;
+	if(removeCount == 0 && insertCount == 0)
+		return;
+
+	if (removeCount == 1 && insertCount == 1) {
+		EntNode* liveChild = live->children[prefix];
+		EntNode* freshChild = fresh->children[prefix];
+		if (SameContainer(*liveChild, *freshChild)) {
+			mergeChanges(liveChild, freshChild, renumberLists, highlightNew);
+			return;
+		}
+	}
+
+	// Move the changed block out of the fresh node and into a temporary root
+	EntNode tempRoot(EntNode::NFC_RootNode);
+	tempRoot.maxChildren = OptimalMaxChildCount(insertCount);
+	tempRoot.children = allocs.children.reserveBlock(tempRoot.maxChildren);
+	for (int i = 0; i < insertCount; i++)
+		tempRoot.children[tempRoot.childCount++] = fresh->children[prefix + i];
+	for (int i = prefix + insertCount; i < freshCount; i++)
+		fresh->children[i - insertCount] = fresh->children[i];
+	fresh->childCount -= insertCount;
+
+	// freeNode only frees the child buffers of nodes with children
+	if (fresh->childCount == 0) {
+		allocs.children.freeBlock(fresh->children, fresh->maxChildren);
+		fresh->children = nullptr;
+		fresh->maxChildren = 0;
+	}
+
+	mergeChildren(tempRoot, live, prefix, removeCount, renumberLists, highlightNew);
+}
+
+bool EntityParser::entitiesCopyFlags(uint16_t& flags, bool hasValue, CopyContext context, CopyContext& childContext)
+{
+	if(flags & (EntNode::NF_Colon | EntNode::NF_Brackets))
+		return false;
+	bool isObject = flags & EntNode::NF_Braces;
+
+	switch (context)
+	{
+		case CopyContext::FILE:
+		if (isObject && !hasValue) {
+			flags = EntNode::NFC_ObjSimple;
+			childContext = CopyContext::ENTITY;
+			return true;
+		}
+		return !isObject && flags == (hasValue ? EntNode::NFC_ValueFile : EntNode::NFC_Comment);
+
+		case CopyContext::ENTITY:
+		if (isObject) { // Permissive mode parses entityDefs as simple objects with values
+			flags = hasValue ? EntNode::NFC_ObjEntitydef : EntNode::NFC_ObjSimple;
+			childContext = hasValue ? CopyContext::DEFINITION : CopyContext::LAYER;
+			return true;
+		}
+		if(hasValue)
+			return flags == EntNode::NFC_ValueCommon || flags == EntNode::NFC_ValueDarkmetal;
+		return flags == EntNode::NFC_Comment;
+
+		case CopyContext::LAYER:
+		return !hasValue && flags == EntNode::NFC_Comment;
+
+		case CopyContext::DEFINITION:
+		if (isObject) {
+			flags = EntNode::NFC_ObjCommon;
+			childContext = CopyContext::DEFINITION;
+			return !hasValue;
+		}
+		if(hasValue) { // Permissive mode allows omitting the semicolon
+			if(!(flags & EntNode::NF_Equals))
+				return false;
+			flags = EntNode::NFC_ValueCommon;
+			return true;
+		}
+		return flags == EntNode::NFC_Comment;
+
+		default:
+		return false;
+	}
+}
+
+EntNode* EntityParser::copyNode(const EntNode& source, uint16_t flags, std::string_view name, std::string_view value, CopyContext context)
+{
+	CopyContext childContext = CopyContext::ANY;
+	if(context != CopyContext::ANY && !entitiesCopyFlags(flags, value.length() > 0, context, childContext))
+		return nullptr;
+
+	EntNode* n = allocs.nodes.reserveBlock(1);
+	n->textPtr = allocs.text.reserveBlock(name.length() + value.length());
+	n->nameLength = (short)name.length();
+	n->valLength = (short)value.length();
+	n->nodeFlags = flags;
+	memcpy(n->textPtr, name.data(), name.length());
+	memcpy(n->textPtr + name.length(), value.data(), value.length());
+
+	// Value nodes have no child buffer
+	if (source.children != nullptr)
+	{
+		n->maxChildren = OptimalMaxChildCount(source.childCount);
+		n->children = allocs.children.reserveBlock(n->maxChildren);
+		for (int i = 0; i < source.childCount; i++) {
+			const EntNode& child = *source.children[i];
+			EntNode* c = copyNode(child, child.nodeFlags, child.getName(), child.getValue(), childContext);
+			if (c == nullptr) {
+				if(n->childCount == 0) // freeNode only frees the child buffers of nodes with children
+					allocs.children.freeBlock(n->children, n->maxChildren);
+				freeNode(n);
+				return nullptr;
+			}
+			c->parent = n;
+			n->children[n->childCount++] = c;
+		}
+	}
+	n->computeHash();
+	return n;
+}
+
+ParseResult EntityParser::EditTreeCopy(const std::vector<NodeCopy>& sources, EntNode* parent, int insertionIndex, int removeCount, bool renumberLists, bool highlightNew)
+{
+	ParseResult outcome;
+
+	// Mirror how initiateParse chooses a parsing function for the parent's children
+	CopyContext context = CopyContext::ANY;
+	if (PARSEMODE == ParsingMode::ENTITIES) switch (parent->nodeFlags)
+	{
+		case EntNode::NFC_RootNode:
+		context = CopyContext::FILE;
+		break;
+
+		case EntNode::NFC_ObjSimple:
+		context = parent->parent == &root ? CopyContext::ENTITY : CopyContext::LAYER;
+		break;
+
+		case EntNode::NFC_ObjEntitydef: case EntNode::NFC_ObjCommon:
+		context = CopyContext::DEFINITION;
+		break;
+
+		default:
+		outcome.success = false;
+		outcome.errorMessage = "Cannot copy nodes into a value node";
+		return outcome;
+	}
+
+	EntNode tempRoot(EntNode::NFC_RootNode);
+	tempRoot.maxChildren = OptimalMaxChildCount((int)sources.size());
+	tempRoot.children = allocs.children.reserveBlock(tempRoot.maxChildren);
+	for (const NodeCopy& source : sources)
+	{
+		EntNode* n = copyNode(*source.node, source.flags, source.name, source.value, context);
+		if (n == nullptr) {
+			for (int i = 0; i < tempRoot.childCount; i++)
+				freeNode(tempRoot.children[i]);
+			allocs.children.freeBlock(tempRoot.children, tempRoot.maxChildren);
+			outcome.success = false;
+			outcome.errorMessage = "Copied nodes are invalid in this parsing mode";
+			return outcome;
+		}
+		tempRoot.children[tempRoot.childCount++] = n;
+	}
+
+	mergeChildren(tempRoot, parent, insertionIndex, removeCount, renumberLists, highlightNew);
+	return outcome;
+}
+
+void EntityParser::mergeChildren(EntNode& tempRoot, EntNode* parent, int insertionIndex, int removeCount, bool renumberLists, [[maybe_unused]] bool highlightNew)
+{
+	// The filter and Find All workers read the tree, so they must be stopped before the tree changes
+	#if entityparser_wxwidgets
+	interruptWorkers();
+	#endif
+
 	// Give every node a comma - we'll ensure the (possibly new) last child has no
 	// comma after merging the children
 	if (PARSEMODE == ParsingMode::JSON) {
@@ -273,6 +782,8 @@ ParseResult EntityParser::EditTree(const std::string_view text, EntNode* parent,
 		// Deallocate deleted nodes
 		if(n->filtered) // Not all nodes we're removing may be filtered in
 			removedNodes.push_back(wxDataViewItem(n));
+		if(parent == &root)
+			facets.Remove(n);
 		freeNode(n);
 	}
 
@@ -332,6 +843,15 @@ ParseResult EntityParser::EditTree(const std::string_view text, EntNode* parent,
 	// Common to both branches
 	allocs.children.freeBlock(tempRoot.children, tempRoot.maxChildren);
 	parent->childCount = newNumChildren;
+	rehashAncestors(parent);
+	#if entityparser_wxwidgets
+	uncacheDisplay(parent);
+	#endif
+	if (parent == &root) {
+		for(int i = insertionIndex, max = insertionIndex + tempRoot.childCount; i < max; i++)
+			facets.Add(parent->children[i]);
+	}
+	else facets.Update(parent->getEntity());
 
 	if (PARSEMODE == ParsingMode::JSON) {
 		if(parent->childCount > 0)
@@ -346,8 +866,8 @@ ParseResult EntityParser::EditTree(const std::string_view text, EntNode* parent,
 		ItemsDeleted(parentItem, removedNodes);
 		ItemsAdded(parentItem, addedNodes);
 		if (highlightNew)
-			for (wxDataViewItem& i : addedNodes) // Must use Select() instead of SetSelections()
-				view->Select(i);                // because the latter deselects everything else
+			for (wxDataViewItem& i : addedNodes)
+				notifyHighlight((EntNode*)i.GetID());
 		#endif
 	}
 
@@ -365,11 +885,15 @@ ParseResult EntityParser::EditTree(const std::string_view text, EntNode* parent,
 			fixListNumberings(parent, false, false);
 	}
 	fileUpToDate = false;
-	return outcome;
 }
 
-void EntityParser::EditText(const std::string& text, EntNode* node, int nameLength, bool highlight)
+void EntityParser::EditText(const std::string& text, EntNode* node, int nameLength, [[maybe_unused]] bool highlight)
 {
+	// The filter and Find All workers read the tree, so they must be stopped before the tree changes
+	#if entityparser_wxwidgets
+	interruptWorkers();
+	#endif
+
 	// Construct reverse command
 	#if entityparser_history
 	reverseGroup.emplace_back();
@@ -393,15 +917,19 @@ void EntityParser::EditText(const std::string& text, EntNode* node, int nameLeng
 	node->textPtr = newBuffer;
 	node->nameLength = nameLength;
 	node->valLength = (int)text.length() - nameLength;
+	rehashAncestors(node);
+	#if entityparser_wxwidgets
+	uncacheDisplay(node);
+	#endif
+	facets.Update(node->getEntity());
 
 	// Alert model
 	if (node->isFiltered()) // Todo: add safeguards so node can't be the root
 	{
 		#if entityparser_wxwidgets
-		wxDataViewItem item(node);
-		ItemChanged(item);
+		notifyChanged(node);
 		if (highlight)
-			view->Select(item);
+			notifyHighlight(node);
 		#endif
 	}
 
@@ -412,8 +940,13 @@ void EntityParser::EditText(const std::string& text, EntNode* node, int nameLeng
 * Moves a node's child to a different index in it's buffer 
 * Nodes inbetween the two indices are shifted up/down to fill the node's old slot
 */
-void EntityParser::EditPosition(EntNode* parent, int childIndex, int insertionIndex, bool highlight)
+void EntityParser::EditPosition(EntNode* parent, int childIndex, int insertionIndex, [[maybe_unused]] bool highlight)
 {
+	// The filter and Find All workers read the tree, so they must be stopped before the tree changes
+	#if entityparser_wxwidgets
+	interruptWorkers();
+	#endif
+
 	// Construct reverse command
 	#if entityparser_history
 	reverseGroup.emplace_back();
@@ -437,6 +970,12 @@ void EntityParser::EditPosition(EntNode* parent, int childIndex, int insertionIn
 		for (int i = childIndex; i > insertionIndex; i--)
 			buffer[i] = buffer[i - 1];
 	buffer[insertionIndex] = child;
+	rehashAncestors(parent);
+	#if entityparser_wxwidgets
+	uncacheDisplay(parent);
+	#endif
+	if(parent != &root) // Changes which properties are found first
+		facets.Update(parent->getEntity());
 	
 	// Only alert model if node is filtered in 
 	// We assume Root will never be the node we're moving (todo: add safeguards to ensure this)
@@ -448,7 +987,7 @@ void EntityParser::EditPosition(EntNode* parent, int childIndex, int insertionIn
 		ItemDeleted(parentItem, childItem);
 		ItemAdded(parentItem, childItem);
 		if(highlight)
-			view->Select(childItem);
+			notifyHighlight(child);
 		#endif
 	}
 	fileUpToDate = false;
@@ -475,7 +1014,7 @@ void EntityParser::fixListNumberings(EntNode* parent, bool recursive, bool highl
 			fixListNumberings(current, true, highlight);
 
 		std::string_view name = current->getName();
-		if(!name._Starts_with("item["))
+		if(name.substr(0, 5) != "item[")
 			continue;
 		listItems++;
 
@@ -541,6 +1080,9 @@ void EntityParser::PushGroupCommand() {
 
 void EntityParser::CancelGroupCommand()
 {
+	#if entityparser_wxwidgets
+	NotificationBatch batch(this);
+	#endif
 	for (int i = (int)reverseGroup.size() - 1; i > -1; i--) // Should(?) underflow to -1
 		ExecuteCommand(reverseGroup[i]);
 	reverseGroup.clear();
@@ -583,6 +1125,9 @@ bool EntityParser::Undo()
 		return false;
 	}
 
+	#if entityparser_wxwidgets
+	NotificationBatch batch(this);
+	#endif
 	int index = redoIndex - 1;
 	do ExecuteCommand(history[index]);
 	while (!history[index--].lastInGroup);
@@ -606,6 +1151,9 @@ bool EntityParser::Redo()
 		return false;
 	}
 
+	#if entityparser_wxwidgets
+	NotificationBatch batch(this);
+	#endif
 	int index = redoIndex;
 	do ExecuteCommand(history[index]);
 	while (!history[index++].lastInGroup);
@@ -867,18 +1415,62 @@ void EntityParser::parseContentsPermissive()
 
 void EntityParser::parseContentsFile() {
 	size_t childrenStart = tempChildren.size();
-	LABEL_LOOP:
+	while(parseFileItem());
+	setNodeChildren(childrenStart);
+}
+
+/*
+* Parses complete top-level items from [ch, endchar) into tempChildren, which
+* keeps them until the caller parents them. If the input isn't final, a partial
+* item at the end is rolled back so it can be parsed again when more input arrives.
+* 
+* A rolled back item isn't retried until the input available from it's start has
+* doubled. Each retry costs at most twice the last, so an item received in many
+* small chunks is parsed in time linear to it's size, instead of once per chunk
+* @return True if the end of the file was reached, false if more input is needed
+*/
+bool EntityParser::parseFileIncremental()
+{
+	for (;;)
+	{
+		const char* itemStart = ch;
+		size_t itemChildren = tempChildren.size();
+		if(!inputFinal && (size_t)(endchar - itemStart) < retryLength)
+			return false;
+
+		try {
+			if (!parseFileItem()) {
+				assertLastType(TT_End);
+				retryLength = 0;
+				return true;
+			}
+		}
+		catch (InputStall) {
+			for(size_t i = itemChildren; i < tempChildren.size(); i++)
+				freeNode(tempChildren[i]);
+			tempChildren.resize(itemChildren);
+			retryLength = 2 * (size_t)(endchar - itemStart);
+			ch = itemStart;
+			return false;
+		}
+		retryLength = 0;
+	}
+}
+
+/*
+* Parses the next top-level item of an .entities file
+* @return False if the next token doesn't begin an item
+*/
+bool EntityParser::parseFileItem()
+{
 	Tokenize();
 	if (lastTokenType == TT_Comment)
 	{
 		pushNode(EntNode::NFC_Comment, lastUniqueToken);
-		goto LABEL_LOOP;
+		return true;
 	}
 	if (lastTokenType != TT_Identifier)
-	{
-		setNodeChildren(childrenStart);
-		return;
-	}
+		return false;
 
 	activeID = lastUniqueToken;
 	TokenizeAdjustValue();
@@ -898,7 +1490,7 @@ void EntityParser::parseContentsFile() {
 		default:
 		throw Error("Invalid token (File function)");
 	}
-	goto LABEL_LOOP;
+	return true;
 }
 
 void EntityParser::parseContentsEntity() {
@@ -1128,6 +1720,15 @@ void EntityParser::freeNode(EntNode* node)
 	// Free the allocated text block
 	allocs.text.freeBlock(node->textPtr, node->nameLength + node->valLength);
 
+	// The node's memory may be reused by a new node
+	#if entityparser_wxwidgets
+	displayCache.erase(node);
+	notifyBatch.changed.erase(node);
+	notifyBatch.highlighted.erase(node);
+	if(view != nullptr)
+		view->ForgetNode(node);
+	#endif
+
 	// Free the node's children and the pointer block listing them
 	if (node->childCount > 0)
 	{
@@ -1186,9 +1787,18 @@ void EntityParser::setNodeChildren(const size_t startIndex)
 			**tempPtr = tempChildren.data() + startIndex;
 	while (childrenPtr < max) { 
 		(*tempPtr)->parent = parent;
+		if((*tempPtr)->childCount == 0) // Nodes with children were hashed by their own setNodeChildren call
+			(*tempPtr)->computeHash();
 		*childrenPtr++ = *tempPtr++;
 	}
 	tempChildren.resize(startIndex);
+	parent->computeHash();
+}
+
+void EntityParser::rehashAncestors(EntNode* node)
+{
+	for(; node != nullptr && node != &root; node = node->parent)
+		node->computeHash();
 }
 
 void EntityParser::assertLastType(uint32_t requiredType)
@@ -1253,6 +1863,8 @@ void EntityParser::Tokenize()
 	#endif
 
 	if (ch == endchar) {
+		if(!inputFinal)
+			throw InputStall();
 		lastTokenType = TT_End;
 		return;
 	}
@@ -1261,6 +1873,8 @@ void EntityParser::Tokenize()
 	{                     // at the cost of needing to manually it++ in additional areas
 		case '\r':
 		ch++;
+		if(ch == endchar)
+			stallIfTruncated();
 		if(ch == endchar || *ch != '\n')
 			throw Error("Expected line feed after carriage return");
 		case '\n':
@@ -1346,14 +1960,18 @@ void EntityParser::Tokenize()
 
 		case '/':
 		first = ch++;
-		if(ch == endchar)
+		if (ch == endchar) {
+			stallIfTruncated();
 			throw Error("Bad start to comment");
+		}
 
 		if (*ch == '/') {
 			while (++ch < endchar) {
 				if(*ch == '\n' || *ch == '\r')
 					break;
 			}
+			if(ch == endchar)
+				stallIfTruncated();
 			lastTokenType = TT_Comment;
 			lastUniqueToken = std::string_view(first, static_cast<size_t>(ch - first));
 			return;
@@ -1367,6 +1985,7 @@ void EntityParser::Tokenize()
 					return;
 				}
 			}
+			stallIfTruncated();
 			throw Error("No end to multiline comment");
 		}
 		else throw Error("Invalid Comment Syntax");
@@ -1387,12 +2006,16 @@ void EntityParser::Tokenize()
 			else if(*ch == '\n' || *ch == '\r')
 				break;
 		}
+		if(ch == endchar)
+			stallIfTruncated();
 		throw Error("No end-quote to complete string literal");
 
 		case '<':
 		first = ch++;
 		if (PARSEMODE != ParsingMode::PERMISSIVE)
 			throw Error("Verbatim strings are for permissive mode only");
+		if(ch == endchar)
+			stallIfTruncated();
 		if(ch == endchar || *ch != '%')
 			throw Error("Bad start to verbatim string");
 		while (++ch < endchar) {
@@ -1403,6 +2026,7 @@ void EntityParser::Tokenize()
 				return;
 			}
 		}
+		stallIfTruncated();
 		throw Error("No end to verbatim string");
 
 		case '$':
@@ -1410,6 +2034,8 @@ void EntityParser::Tokenize()
 			first = ch;
 
 			// Multiple prefixes in one conditional creates spooky, undefined behavior
+			if(ch >= endchar - 2)
+				stallIfTruncated();
 			if(ch >= endchar - 2 || *(ch + 1) != '0' || *(ch + 2) != 'x')
 				throw Error("Bad start to dollar sign hexadecimal");
 			ch += 3;
@@ -1462,6 +2088,8 @@ void EntityParser::Tokenize()
 
 				break;
 			}
+			if(ch == endchar)
+				stallIfTruncated();
 			lastTokenType = TT_Number;
 			lastUniqueToken = std::string_view(first, (size_t)(ch - first));
 			return;
@@ -1486,6 +2114,11 @@ void EntityParser::Tokenize()
 
 				break;
 			}
+			if (ch == endchar) { // Can't peek past the end of a streamed buffer
+				stallIfTruncated();
+				goto LABEL_ID_OKAY;
+			}
+
 			if (*ch == '(') { // declType(keyword)
 				Tokenize();
 			}
@@ -1503,6 +2136,8 @@ void EntityParser::Tokenize()
 
 					break;
 				}
+				if(ch == endchar)
+					stallIfTruncated();
 				throw Error("Improper bracket usage in identifier");
 			}
 
@@ -1514,6 +2149,145 @@ void EntityParser::Tokenize()
 	}
 };
 
+bool EntityParser::ComputeFilters(const FilterSettings& settings, EntityBitset& passed, const std::atomic<bool>& cancel) const
+{
+	// Entities pass a facet's filter if they have any checked value, and must pass every facet's filter
+	// Entities whose spawnPosition can't be parsed are never inside the sphere
+	bool filterByIndex = false;
+	EntityBitset candidates, matches;
+	for (int f = 0; f < EntityIndex::FACET_COUNT; f++)
+	{
+		if(settings.facetValues[f].empty())
+			continue;
+		facets.Match((EntityIndex::Facet)f, settings.facetValues[f], matches);
+		if(filterByIndex)
+			candidates.AndWith(matches);
+		else candidates = matches;
+		filterByIndex = true;
+	}
+	if (settings.filterSpawnPosition)
+	{
+		facets.MatchRegions(settings.spawnSpheres, settings.spawnBoxes, matches);
+		if(filterByIndex)
+			candidates.AndWith(matches);
+		else candidates = matches;
+		filterByIndex = true;
+	}
+
+	// The text index only narrows the entities searched - they still need to be checked
+	if (!settings.textFilters.empty() && facets.MatchText(settings.textFilters, matches))
+	{
+		if(filterByIndex)
+			candidates.AndWith(matches);
+		else candidates = matches;
+		filterByIndex = true;
+	}
+
+	if (settings.query)
+	{
+		settings.query->Run(facets, matches, &cancel);
+		if(cancel)
+			return false;
+		if(filterByIndex)
+			candidates.AndWith(matches);
+		else candidates = matches;
+		filterByIndex = true;
+	}
+
+	// Every key is looked for in the same pass over an entity's text
+	KeyMatcher textMatcher(settings.textFilters, settings.caseSensitiveText);
+
+	passed.clear();
+	for (size_t slot = 0, maxSlot = facets.SlotCount(); slot < maxSlot; slot++)
+	{
+		if(cancel)
+			return false;
+
+		EntNode* entity = facets.EntityAt(slot);
+		if(entity == nullptr || (filterByIndex && !candidates.test(slot)))
+			continue;
+
+		if(!settings.textFilters.empty() && !textMatcher.MatchesTree(*entity))
+			continue;
+
+		// Node has passed all filters and should be included in the filtered tree
+		passed.set(slot);
+	}
+	return true;
+}
+
+/* Searches the nodes after start in a downwards search, without leaving top's subtree */
+EntNode* entparser_searchafter(EntNode* top, EntNode* start, const std::string& key, bool caseSensitive, bool exactLength)
+{
+	for (int i = 0; i < start->getChildCount(); i++) {
+		EntNode* result = start->ChildAt(i)->searchDownwardsLocal(key, caseSensitive, exactLength);
+		if(result != EntNode::SEARCH_404) return result;
+	}
+
+	for (EntNode* node = start; node != top; node = node->getParent()) {
+		EntNode* parent = node->getParent();
+		for (int i = parent->getChildIndex(node) + 1; i < parent->getChildCount(); i++) {
+			EntNode* result = parent->ChildAt(i)->searchDownwardsLocal(key, caseSensitive, exactLength);
+			if(result != EntNode::SEARCH_404) return result;
+		}
+	}
+	return EntNode::SEARCH_404;
+}
+
+/* Searches the nodes before start in an upwards search, without leaving top's subtree */
+EntNode* entparser_searchbefore(EntNode* top, EntNode* start, const std::string& key, bool caseSensitive, bool exactLength)
+{
+	for (EntNode* node = start; node != top; node = node->getParent()) {
+		EntNode* parent = node->getParent();
+		for (int i = parent->getChildIndex(node) - 1; i > -1; i--) {
+			EntNode* result = parent->ChildAt(i)->searchUpwardsLocal(key, caseSensitive, exactLength);
+			if(result != EntNode::SEARCH_404) return result;
+		}
+		if(parent->searchText(key, caseSensitive, exactLength)) return parent;
+	}
+	return EntNode::SEARCH_404;
+}
+
+EntNode* EntityParser::SearchNext(EntNode* start, const std::string& key, bool backwards, bool caseSensitive, bool exactLength)
+{
+	// Building the text index changes what the filter worker reads
+	#if entityparser_wxwidgets
+	if(!facets.TextIndexed())
+		interruptFilters();
+	#endif
+	facets.IndexText();
+
+	EntityBitset candidates;
+	bool narrowed = facets.MatchText({key}, candidates);
+	auto searchable = [&](EntNode* entity) {
+		return entity->filtered && (!narrowed || candidates.test(facets.SlotOf(entity)));
+	};
+
+	// Finish searching the starting entity, then move through the others, ending back at the start
+	int count = root.childCount;
+	EntNode* entity = start->getEntity();
+	EntNode* result = EntNode::SEARCH_404;
+	int next = backwards ? count - 1 : 0;
+	if (entity != nullptr) {
+		if (searchable(entity)) {
+			result = backwards ? entparser_searchbefore(entity, start, key, caseSensitive, exactLength)
+				: entparser_searchafter(entity, start, key, caseSensitive, exactLength);
+			if(result != EntNode::SEARCH_404) return result;
+		}
+		next = root.getChildIndex(entity) + (backwards ? -1 : 1);
+	}
+
+	for (int n = 0; n < count; n++) {
+		EntNode* current = root.children[((next + (backwards ? -n : n)) % count + count) % count];
+		if(!searchable(current))
+			continue;
+		result = backwards ? current->searchUpwardsLocal(key, caseSensitive, exactLength)
+			: current->searchDownwardsLocal(key, caseSensitive, exactLength);
+		if(result != EntNode::SEARCH_404) return result;
+	}
+	return EntNode::SEARCH_404;
+}
+
 #if entityparser_wxwidgets
 
 void EntityParser::FilteredSearch(const std::string& key, bool backwards, bool caseSensitive, bool exactLength) 
@@ -1522,41 +2296,150 @@ void EntityParser::FilteredSearch(const std::string& key, bool backwards, bool c
 	if(startAfter == nullptr)
 		startAfter = &root;
 	
-	EntNode* firstResult = nullptr; // Use this to prevent infinite loops from rejection of filtered results
-	EntNode* result;
-	while (true)
-	{
-		/*
-		* TODO: Ideally, we shouldn't be searching through filtered out nodes in the first place. If a massive
-		* amount of nodes are filtered out on large files, search can take significant time to complete
-		*/
-		if (backwards)
-			result = startAfter->searchUpwards(key, caseSensitive, exactLength);
-		else result = startAfter->searchDownwards(key, caseSensitive, exactLength, nullptr);
+	EntNode* result = SearchNext(startAfter, key, backwards, caseSensitive, exactLength);
+	if (result == EntNode::SEARCH_404) {
+		EntityLogger::log("Could not find key");
+		return;
+	}
+	RevealNode(result);
+}
 
-		if (result == EntNode::SEARCH_404 || result == firstResult) {
-			EntityLogger::log("Could not find key");
-			return;
+void EntityParser::RevealNode(EntNode* node)
+{
+	wxDataViewItem item(node);
+	view->UnselectAll();
+	view->Select(item);
+	if(node->childCount > 0)
+		view->Expand(item);
+	view->EnsureVisible(item);
+}
+
+void EntityParser::FindAll(const std::string& key, bool caseSensitive, bool exactLength)
+{
+	stopFindJob();
+	findJob.key = key;
+	findJob.caseSensitive = caseSensitive;
+	findJob.exactLength = exactLength;
+	findJob.active = !key.empty();
+
+	// Building the text index changes what the filter worker reads
+	if (findJob.active && !facets.TextIndexed()) {
+		interruptFilters();
+		facets.IndexText();
+	}
+	startFindJob();
+}
+
+void EntityParser::ClearFindAll()
+{
+	stopFindJob();
+	findJob.active = false;
+	findJob.results.clear();
+	findJob.pass++;
+	findJob.revision++;
+}
+
+void EntityParser::stopFindJob()
+{
+	findJob.cancel = true;
+	if(findJob.worker.joinable())
+		findJob.worker.join();
+	findJob.cancel = false;
+	findJob.generation++;
+	findJob.running = false;
+	findJob.restart = false;
+}
+
+void EntityParser::startFindJob()
+{
+	stopFindJob();
+	findJob.results.clear();
+	findJob.pass++;
+	findJob.revision++;
+	if(!findJob.active)
+		return;
+	findJob.running = true;
+	findJob.start = std::chrono::high_resolution_clock::now();
+
+	// Filtered flags and the index are only read on this thread
+	EntityBitset candidates;
+	bool narrowed = facets.MatchText({findJob.key}, candidates);
+	std::vector<EntNode*> entities;
+	for (int i = 0; i < root.childCount; i++) {
+		EntNode* entity = root.children[i];
+		if(entity->filtered && (!narrowed || candidates.test(facets.SlotOf(entity))))
+			entities.push_back(entity);
+	}
+
+	unsigned generation = findJob.generation;
+	std::weak_ptr<bool> alive = findJob.alive;
+	findJob.worker = std::thread([this, generation, alive, entities = std::move(entities)]() {
+		// Results are published in batches, often enough that the list visibly fills in
+		const auto BATCH_INTERVAL = std::chrono::milliseconds(100);
+		auto lastBatch = std::chrono::steady_clock::now();
+		std::vector<EntNode*> batch;
+		for (EntNode* entity : entities) {
+			if(findJob.cancel)
+				return;
+			entity->searchAllLocal(findJob.key, findJob.caseSensitive, findJob.exactLength, batch);
+
+			auto now = std::chrono::steady_clock::now();
+			if(batch.empty() || now - lastBatch < BATCH_INTERVAL)
+				continue;
+			lastBatch = now;
+			wxTheApp->CallAfter([this, generation, alive, batch]() {
+				if(!alive.expired())
+					publishFindAll(generation, batch, false);
+			});
+			batch.clear();
 		}
-		//wxLogMessage("%s", result->getNameWX());
-
-		// Root should never have text, so this should be safe
-		if (result->isFiltered()) {
-			wxDataViewItem item(result);
-			view->UnselectAll();
-			view->Select(item);
-			if(result->childCount > 0)
-				view->Expand(item);
-			view->EnsureVisible(item);
-			//wxLogMessage("Found");
+
+		wxTheApp->CallAfter([this, generation, alive, batch]() {
+			if(!alive.expired())
+				publishFindAll(generation, batch, true);
+		});
+	});
+}
+
+void EntityParser::interruptFindAll()
+{
+	if(!findJob.active)
+		return;
+
+	// The results may point to nodes the edit deletes
+	stopFindJob();
+	findJob.results.clear();
+	findJob.pass++;
+	findJob.revision++;
+
+	findJob.restart = true;
+	std::weak_ptr<bool> alive = findJob.alive;
+	wxTheApp->CallAfter([this, alive]() {
+		if(alive.expired() || !findJob.restart)
 			return;
-		}
+		startFindJob();
+	});
+}
 
-		// Set sentinel in first loop iteration
-		if(firstResult == nullptr) 
-			firstResult = result;
-		startAfter = result;
-	}
+void EntityParser::interruptWorkers()
+{
+	interruptFilters();
+	interruptFindAll();
+}
+
+void EntityParser::publishFindAll(unsigned generation, const std::vector<EntNode*>& batch, bool finished)
+{
+	if(generation != findJob.generation)
+		return;
+	findJob.results.insert(findJob.results.end(), batch.begin(), batch.end());
+	findJob.revision++;
+	if(!finished)
+		return;
+
+	if(findJob.worker.joinable())
+		findJob.worker.join();
+	findJob.running = false;
+	EntityLogger::logTimeStamps("Time to Find All: ", findJob.start);
 }
 
 void EntityParser::refreshFilterMenus(FilterCtrl* layerMenu, FilterCtrl* classMenu, FilterCtrl* inheritMenu, FilterCtrl* componentMenu, FilterCtrl* instanceidMenu)
@@ -1567,54 +2450,14 @@ void EntityParser::refreshFilterMenus(FilterCtrl* layerMenu, FilterCtrl* classMe
 	std::set<std::string_view> newComponents;
 	std::set<std::string_view> newIds;
 
-	EntNode** children = root.children;
-	int childCount = root.childCount;
-
-	newLayers.insert(std::string_view(FILTER_NOLAYERS.data() + 1, FILTER_NOLAYERS.length() - 2));
-	newComponents.insert(std::string_view(FILTER_NOCOMPONENTS.data() + 1, FILTER_NOCOMPONENTS.length() - 2));
-	for (int i = 0; i < childCount; i++)
-	{
-		EntNode* current = children[i];
-		EntNode& defNode = (*current)["entityDef"];
-		{
-			EntNode& classNode = defNode["class"];
-			if (classNode.ValueLength() > 0)
-				newClasses.insert(classNode.getValueUQ());
-			else {
-				EntNode& typeNode = defNode["systemVars"]["entityType"];
-				if(typeNode.ValueLength() > 0)
-					newClasses.insert(typeNode.getValueUQ());
-			}
-		}
-		{
-			std::string_view val = (*current)["instanceId"].getValue();
-			if(val.length() > 0)
-				newIds.insert(val);
-		}
-		{
-			EntNode& inheritNode = defNode["inherit"];
-			if (inheritNode.ValueLength() > 0)
-				newInherits.insert(inheritNode.getValueUQ());
-		}
-		{
-			EntNode& layerNode = (*current)["layers"];
-			if (layerNode.getChildCount() > 0)
-			{
-				EntNode** layerBuffer = layerNode.getChildBuffer();
-				int layerCount = layerNode.getChildCount();
-				for (int currentLayer = 0; currentLayer < layerCount; currentLayer++)
-					newLayers.insert(layerBuffer[currentLayer]->getNameUQ());
-			}
-		}
-		{
-			EntNode& compNode = defNode["edit"]["components"];
-			for (int i = 0; i < compNode.childCount; i++) {
-				EntNode& className = (*compNode.children[i])["className"];
-				if(className.ValueLength() > 0)
-					newComponents.insert(className.getValueUQ());
-			}
-		}
-	}
+	// The index only holds values that are still in use
+	newLayers.insert(EntityIndex::NO_LAYERS);
+	newComponents.insert(EntityIndex::NO_COMPONENTS);
+	facets.GetValues(EntityIndex::FACET_LAYER, newLayers);
+	facets.GetValues(EntityIndex::FACET_CLASS, newClasses);
+	facets.GetValues(EntityIndex::FACET_INHERIT, newInherits);
+	facets.GetValues(EntityIndex::FACET_COMPONENT, newComponents);
+	facets.GetValues(EntityIndex::FACET_INSTANCEID, newIds);
 
 	layerMenu->setItems(newLayers);
 	classMenu->setItems(newClasses);
@@ -1625,277 +2468,238 @@ void EntityParser::refreshFilterMenus(FilterCtrl* layerMenu, FilterCtrl* classMe
 }
 
 void EntityParser::SetFilters(wxCheckListBox* layerMenu, wxCheckListBox* classMenu, wxCheckListBox* inheritMenu, wxCheckListBox* componentMenu, wxCheckListBox* idMenu,
-	bool filterSpawnPosition, Sphere spawnSphere, wxCheckListBox* textMenu, bool caseSensitiveText)
+	bool filterSpawnPosition, const std::vector<Sphere>& spawnSpheres, const std::vector<Box>& spawnBoxes,
+	wxCheckListBox* textMenu, bool caseSensitiveText, std::shared_ptr<const EntityQuery> query)
 {
-	std::set<std::string> layerFilters;
-	std::set<std::string> classFilters;
-	std::set<std::string> inheritFilters;
-	std::set<std::string> componentFilters;
-	std::set<std::string> idFilters;
-	std::vector<std::string> textFilters;
-
-	for (int i = 0, max = layerMenu->GetCount(); i < max; i++)
-		if(layerMenu->IsChecked(i))
-			layerFilters.insert('"' + std::string(layerMenu->GetString(i)) + '"');
-
-	for (int i = 0, max = classMenu->GetCount(); i < max; i++)
-		if (classMenu->IsChecked(i))
-			classFilters.insert('"' + std::string(classMenu->GetString(i)) + '"');
-
-	for (int i = 0, max = inheritMenu->GetCount(); i < max; i++)
-		if (inheritMenu->IsChecked(i))
-			inheritFilters.insert('"' + std::string(inheritMenu->GetString(i)) + '"');
-
-	for (int i = 0, max = componentMenu->GetCount(); i < max; i++)
-		if (componentMenu->IsChecked(i))
-			componentFilters.insert('"' + std::string(componentMenu->GetString(i)) + '"');
-
-	for (int i = 0, max = idMenu->GetCount(); i < max; i++)
-		if (idMenu->IsChecked(i))
-			idFilters.insert(std::string(idMenu->GetString(i)));
+	FilterSettings settings;
+	struct {
+		wxCheckListBox* menu;
+		EntityIndex::Facet facet;
+	} facetMenus[] = {
+		{classMenu, EntityIndex::FACET_CLASS},
+		{inheritMenu, EntityIndex::FACET_INHERIT},
+		{idMenu, EntityIndex::FACET_INSTANCEID},
+		{layerMenu, EntityIndex::FACET_LAYER},
+		{componentMenu, EntityIndex::FACET_COMPONENT}
+	};
+	for (const auto& f : facetMenus)
+		for (int i = 0, max = f.menu->GetCount(); i < max; i++)
+			if(f.menu->IsChecked(i))
+				settings.facetValues[f.facet].push_back(std::string(f.menu->GetString(i)));
 
 	for(int i = 0, max = textMenu->GetCount(); i < max; i++)
 		if(textMenu->IsChecked(i))
-			textFilters.push_back(std::string(textMenu->GetString(i)));
-
-	// MOVED FROM GetChildren - Apply the filters
-	auto start = std::chrono::high_resolution_clock::now();
-
-	bool filterByClass = classFilters.size() > 0;
-	bool filterByInherit = inheritFilters.size() > 0;
-	bool filterById = idFilters.size() > 0;
-	bool filterByLayer = layerFilters.size() > 0;
-	bool noLayerFilter = layerFilters.count(FILTER_NOLAYERS) > 0;
-	bool filterByComponent = componentFilters.size() > 0;
-	bool noComponentFilter = componentFilters.count(FILTER_NOCOMPONENTS) > 0;
-					
-	size_t numTextFilters = textFilters.size();
-	bool filterByText = numTextFilters > 0;
-	//string textBuffer;
+			settings.textFilters.push_back(std::string(textMenu->GetString(i)));
+
+	settings.filterSpawnPosition = filterSpawnPosition;
+	settings.spawnSpheres = spawnSpheres;
+	settings.spawnBoxes = spawnBoxes;
+	settings.caseSensitiveText = caseSensitiveText;
+	settings.query = std::move(query);
+
+	CancelFilters();
+	if(!settings.textFilters.empty())
+		facets.IndexText();
+	filterJob.settings = std::move(settings);
+	startFilterJob();
+}
 
-	// Eliminates need to take square root in every distance calculation
-	float maxR2 = spawnSphere.r * spawnSphere.r;
+void EntityParser::CancelFilters()
+{
+	filterJob.cancel = true;
+	if(filterJob.worker.joinable())
+		filterJob.worker.join();
+	filterJob.cancel = false;
+	filterJob.generation++;
+	filterJob.running = false;
+	filterJob.restart = false;
+}
 
-	int childCount = root.childCount;
-	EntNode** childBuffer = root.children;
-	for (int i = 0; i < childCount; i++)
-	{
-		EntNode* entity = childBuffer[i];
-		EntNode& entityDef = (*entity)["entityDef"];
-		if (filterByClass)
-		{
-			std::string_view classVal = entityDef["class"].getValue();
-			if(classVal.length() == 0)
-				classVal = entityDef["systemVars"]["entityType"].getValue();
+void EntityParser::startFilterJob()
+{
+	CancelFilters();
+	filterJob.running = true;
+	filterJob.start = std::chrono::high_resolution_clock::now();
+
+	unsigned generation = filterJob.generation;
+	std::weak_ptr<bool> alive = filterJob.alive;
+	filterJob.worker = std::thread([this, generation, alive]() {
+		EntityBitset passed;
+		if(!ComputeFilters(filterJob.settings, passed, filterJob.cancel))
+			return;
 
-			if (classFilters.count(std::string(classVal)) < 1) // TODO: OPTIMIZE ACCESS CASTING
-			{
-				entity->filtered = false;
-				continue;
-			}
-				
-		}
+		// The parser can't be destroyed while this thread runs, but may be before the callback does
+		wxTheApp->CallAfter([this, generation, alive, passed]() {
+			if(!alive.expired())
+				publishFilters(generation, passed);
+		});
+	});
+}
 
-		if (filterByInherit)
-		{
-			std::string_view inheritVal = entityDef["inherit"].getValue();
-			if (inheritFilters.count(std::string(inheritVal)) < 1) // TODO: OPTIMIZE CASTING
-			{
-				entity->filtered = false;
-				continue;
-			}
-		}
+void EntityParser::interruptFilters()
+{
+	if(!filterJob.running)
+		return;
+	CancelFilters();
 
-		if (filterById)
-		{
-			std::string_view idVal = (*entity)["instanceId"].getValue();
-			if (idFilters.count(std::string(idVal)) < 1) {
-				entity->filtered = false;
-				continue;
-			}
-		}
+	// Restart once the edit is finished. Repeated interruptions queue redundant restarts, which do nothing
+	filterJob.restart = true;
+	std::weak_ptr<bool> alive = filterJob.alive;
+	wxTheApp->CallAfter([this, alive]() {
+		if(alive.expired() || !filterJob.restart)
+			return;
+		startFilterJob();
+	});
+}
 
-		if (filterByLayer)
-		{
-			bool hasLayer = false;
-			EntNode& layerNode = (*entity)["layers"];
-			if (layerNode.getChildCount() == 0 && noLayerFilter)
-				hasLayer = true; // Search_404 also implies 0 layers
-
-			EntNode** layers = layerNode.getChildBuffer();
-			int layerCount = layerNode.getChildCount();
-			for (int currentLayer = 0; currentLayer < layerCount; currentLayer++)
-			{
-				std::string_view l = layers[currentLayer]->getName();
-				if (layerFilters.count(std::string(l)) > 0)
-				{
-					hasLayer = true;
-					break;
-				}
-			}
-			if (!hasLayer)
-			{
-				entity->filtered = false;
-				continue;
-			}
-		}
+void EntityParser::publishFilters(unsigned generation, const EntityBitset& passed)
+{
+	if(generation != filterJob.generation)
+		return;
+	if(filterJob.worker.joinable())
+		filterJob.worker.join();
+	filterJob.running = false;
+
+	// Only notify the view of entities whose visibility changed, so expansion and scrolling are kept.
+	// The view splices just those entities' rows, and hidden entities keep their expansion for when they return
+	wxDataViewItemArray hidden, shown;
+	for (size_t slot = 0, maxSlot = facets.SlotCount(); slot < maxSlot; slot++) {
+		EntNode* entity = facets.EntityAt(slot);
+		if(entity == nullptr || entity->filtered == passed.test(slot))
+			continue;
+		if(entity->filtered)
+			hidden.Add(wxDataViewItem(entity));
+		else shown.Add(wxDataViewItem(entity));
+	}
 
-		// More todo: spawn position filter is broken with cursed values
-		if (filterByComponent)
-		{
-			bool hasComponent = false;
-			EntNode& componentNode = entityDef["edit"]["components"];
-			if(componentNode.getChildCount() == 0 && noComponentFilter)
-				hasComponent = true;
-
-			EntNode** comps = componentNode.getChildBuffer();
-			int compCount = componentNode.getChildCount();
-			for (int currentComp = 0; currentComp < compCount; currentComp++) {
-				 
-				std::string_view c = (*(comps[currentComp]))["className"].getValue();
-				if (componentFilters.count(std::string(c)) > 0) {
-					hasComponent = true;
-					break;
-				}
-			}
+	wxDataViewItem r(&root);
+	for(const wxDataViewItem& item : hidden)
+		((EntNode*)item.GetID())->filtered = false;
+	if(!hidden.empty())
+		ItemsDeleted(r, hidden);
 
-			if (!hasComponent) {
-				entity->filtered = false;
-				continue;
-			}
-		}
+	for(const wxDataViewItem& item : shown)
+		((EntNode*)item.GetID())->filtered = true;
+	if(!shown.empty())
+		ItemsAdded(r, shown);
 
-		if (filterSpawnPosition)
-		{
-			// If a variable is undefined, we assume default value of 0
-			// If spawnPosition is undefined, we assume (0, 0, 0) instead of excluding
-			EntNode& positionNode = entityDef["edit"]["spawnPosition"];
-			//if(&positionNode == EntNode::SEARCH_404)
-			//	continue;
-			EntNode& xNode = positionNode["x"];
-			EntNode& yNode = positionNode["y"];
-			EntNode& zNode = positionNode["z"];
-
-			float x = 0, y = 0, z = 0;
-			try {
-				// Need comparisons to distinguish between actual formatting exception
-				// and exception from trying to convert "" to a float
-				if(&xNode != EntNode::SEARCH_404)
-					x = std::stof(std::string(xNode.getValue()));
-
-				if (&yNode != EntNode::SEARCH_404)
-					y = std::stof(std::string(yNode.getValue()));
-
-				if (&zNode != EntNode::SEARCH_404)
-					z = std::stof(std::string(zNode.getValue()));
-			}
-			catch (std::exception) {
-				entity->filtered = false;
-				continue;
-			}
+	EntityLogger::logTimeStamps("Time to Filter: ", filterJob.start);
+	if(findJob.active)
+		startFindJob();
+}
 
-			float deltaX = x - spawnSphere.x,
-					deltaY = y - spawnSphere.y,
-					deltaZ = z - spawnSphere.z;
-			float distance2 = deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ;
+void EntityParser::beginNotifications()
+{
+	if (notifyBatch.depth++ == 0 && view != nullptr)
+		view->Freeze();
+}
 
-			if(distance2 > maxR2)
-			{
-				entity->filtered = false;
-				continue;
-			}
-		}
+void EntityParser::endNotifications()
+{
+	if(--notifyBatch.depth > 0)
+		return;
 
-		if (filterByText)
-		{
-			//textBuffer.clear();
-			//childBuffer[i]->generateText(textBuffer);
-					
-			bool containsText = false;
-			for (const std::string& key : textFilters)
-				if (childBuffer[i]->searchDownwardsLocal(key, caseSensitiveText, false) != EntNode::SEARCH_404)
-				{
-					containsText = true;
-					break;
-				}
-			//for (size_t filter = 0; filter < numTextFilters; filter++)
-			//	if (textBuffer.find(textFilters[filter]) != string::npos)
-			//	{
-			//		containsText = true;
-			//		break;
-			//	}
-			if(!containsText)
-			{
-				entity->filtered = false;
-				continue;
-			}
-		}
+	wxDataViewItemArray changed;
+	for(EntNode* node : notifyBatch.changed)
+		changed.Add(wxDataViewItem(node));
+	notifyBatch.changed.clear();
+	if(!changed.IsEmpty())
+		ItemsChanged(changed);
+
+	// Select in the original order, so the last node highlighted becomes the current one
+	std::vector<std::pair<size_t, EntNode*>> highlighted;
+	highlighted.reserve(notifyBatch.highlighted.size());
+	for(const auto& pair : notifyBatch.highlighted)
+		highlighted.emplace_back(pair.second, pair.first);
+	notifyBatch.highlighted.clear();
+	notifyBatch.highlightCount = 0;
+	std::sort(highlighted.begin(), highlighted.end());
+
+	if(view == nullptr)
+		return;
+	for(const auto& pair : highlighted)
+		view->Select(wxDataViewItem(pair.second));
+	view->Thaw();
+}
 
-		// Node has passed all filters and should be included in the filtered tree
-		entity->filtered = true;
-	}
-	EntityLogger::logTimeStamps("Time to Filter: ", start);
+void EntityParser::notifyChanged(EntNode* node)
+{
+	if(notifyBatch.depth > 0)
+		notifyBatch.changed.insert(node);
+	else ItemChanged(wxDataViewItem(node));
+}
+
+void EntityParser::notifyHighlight(EntNode* node)
+{
+	if(notifyBatch.depth > 0)
+		notifyBatch.highlighted[node] = notifyBatch.highlightCount++;
+	else if(view != nullptr) // Must use Select() instead of SetSelections(), since the latter deselects everything else
+		view->Select(wxDataViewItem(node));
 }
 
 void EntityParser::GetValue(wxVariant& variant, const wxDataViewItem& item, unsigned int col) const
 {
 	wxASSERT(item.IsOk());
-	EntNode* node = (EntNode*)item.GetID();
+	const DisplayLabels& labels = getDisplayLabels((EntNode*)item.GetID());
+	variant = col == 0 ? labels.key : labels.value;
+}
 
-	if (col == 0) {
-		// Use value in entityDef node instead of "entity"
+const EntityParser::DisplayLabels& EntityParser::getDisplayLabels(EntNode* node) const
+{
+	auto iter = displayCache.find(node);
+	if(iter != displayCache.end())
+		return iter->second;
 
-		if (PARSEMODE == ParsingMode::JSON) {
-			if (node->nameLength == 0) {
-				if (node->nodeFlags & EntNode::NF_Braces)
-					variant = "{}";
-				else if (node->nodeFlags & EntNode::NF_Brackets)
-					variant = "[]";
-			}
-			else variant = node->getNameWX();
-			return;
-		}
+	// Bounds the cache's memory after scrolling through very large files
+	const size_t MAX_CACHED = 200000;
+	if(displayCache.size() >= MAX_CACHED)
+		displayCache.clear();
+	DisplayLabels& labels = displayCache[node];
 
-		if (node->parent == &root)
-		{
-			EntNode& entityDef = (*node)["entityDef"];
-			if (&entityDef != EntNode::SEARCH_404)
-			{
-				variant = entityDef.getValueWX();
-				return;
-			}
-		}
-		if (node->nodeFlags == EntNode::NFC_ObjCommon) { // Indiana Jones Entity Component System
-			if (node->HasParent() && node->parent->getName() == "components") {
-				variant = (*node)["className"].getValueWX();
-				return;
-			}
+	// Key column
+	if (PARSEMODE == ParsingMode::JSON) {
+		if (node->nameLength == 0) {
+			if (node->nodeFlags & EntNode::NF_Braces)
+				labels.key = "{}";
+			else if (node->nodeFlags & EntNode::NF_Brackets)
+				labels.key = "[]";
 		}
-		variant = node->getNameWX();
+		else labels.key = node->getNameWX();
 	}
 	else {
+		// Use value in entityDef node instead of "entity"
+		EntNode* entityDef = node->parent == &root ? &(*node)["entityDef"] : EntNode::SEARCH_404;
+		if (entityDef != EntNode::SEARCH_404)
+			labels.key = entityDef->getValueWX();
+		else if (node->nodeFlags == EntNode::NFC_ObjCommon && node->HasParent() && node->parent->getName() == "components")
+			labels.key = (*node)["className"].getValueWX(); // Indiana Jones Entity Component System
+		else labels.key = node->getNameWX();
+	}
 
-		if (node->nodeFlags == EntNode::NFC_ObjCommon) {
-			// Devinvloadout decls
-			// This demonstrates the importance of understanding
-			// C++ reference reassignment rules
-			EntNode& itemNode = (*node)["item"];
-			if (&itemNode != EntNode::SEARCH_404) {
-				variant = itemNode.getValueWXUQ();
-				return;
-			}
-
-			EntNode& perkNode = (*node)["perk"];
-			if (&perkNode != EntNode::SEARCH_404) {
-				variant = perkNode.getValueWXUQ();
-				return;
-			}
-
-			// Encounter managers
-			variant = (*node)["eventCall"]["eventDef"].getValueWX();
-		}
-		else variant = node->getValueWX();
+	// Value column
+	if (node->nodeFlags == EntNode::NFC_ObjCommon) {
+		// Devinvloadout decls
+		EntNode& itemNode = (*node)["item"];
+		EntNode& perkNode = (*node)["perk"];
+		if (&itemNode != EntNode::SEARCH_404)
+			labels.value = itemNode.getValueWXUQ();
+		else if (&perkNode != EntNode::SEARCH_404)
+			labels.value = perkNode.getValueWXUQ();
+
+		// Encounter managers
+		else labels.value = (*node)["eventCall"]["eventDef"].getValueWX();
 	}
+	else labels.value = node->getValueWX();
+	return labels;
+}
+
+void EntityParser::uncacheDisplay(EntNode* node)
+{
+	// Component labels depend on their parent's name
+	for(int i = 0; i < node->childCount; i++)
+		displayCache.erase(node->children[i]);
+	for(; node != nullptr; node = node->parent)
+		displayCache.erase(node);
 }
 
 #endif
\ No newline at end of file
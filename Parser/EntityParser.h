@@ -14,22 +14,24 @@
 #include <string_view>
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <chrono>
 #include "ParserConfig.h"
 #include "EntityNode.h"
 #include "GenericBlockAllocator.h"
+#include "EntityIndex.h"
+#include "EntityQuery.h"
 
 #if entityparser_wxwidgets
 #include "wx/wx.h"
 #include "wx/dataview.h"
 
 class FilterCtrl;
-
-struct Sphere {
-	float x = 0;
-	float y = 0;
-	float z = 0;
-	float r = 0; // Radius
-};
+class EntityTreeView;
 #endif
 
 struct ParseResult {
@@ -38,6 +40,29 @@ struct ParseResult {
 	std::string errorMessage;
 };
 
+/* A node for EditTreeCopy to copy, with the flags and text its copy will be given */
+struct NodeCopy {
+	const EntNode* node;
+	uint16_t flags;
+	std::string_view name;
+	std::string_view value;
+
+	NodeCopy(const EntNode* n) : node(n), flags(n->getFlags()), name(n->getName()), value(n->getValue()) {}
+	NodeCopy(const EntNode* n, uint16_t p_flags, std::string_view p_name, std::string_view p_value) 
+		: node(n), flags(p_flags), name(p_name), value(p_value) {}
+};
+
+/* Filter inputs, copied out of the filter menus so they can be applied on a worker thread */
+struct FilterSettings {
+	std::vector<std::string> facetValues[EntityIndex::FACET_COUNT]; // Checked values. Empty to not filter a facet
+	bool filterSpawnPosition = false;
+	std::vector<Sphere> spawnSpheres; // Spawn position must be inside at least one sphere or box
+	std::vector<Box> spawnBoxes;
+	std::vector<std::string> textFilters;
+	bool caseSensitiveText = false;
+	std::shared_ptr<const EntityQuery> query; // Entities must match this too, if set
+};
+
 enum class ParsingMode {
 	ENTITIES,
 	PERMISSIVE,
@@ -53,6 +78,10 @@ class EntityParser
 	public:
 	~EntityParser()
 	{
+		#if entityparser_wxwidgets
+		CancelFilters();
+		stopFindJob();
+		#endif
 		delete[] eofblob;
 	}
 
@@ -73,6 +102,9 @@ class EntityParser
 		BlockAllocator<EntNode*> children = BlockAllocator<EntNode*>(30000); // Allocator for node child buffers
 	} allocs;
 
+	// Filterable property values of the root's children. Kept up to date by every edit function
+	EntityIndex facets;
+
 	// Internally tracks whether edits have been written to a file
 	bool fileUpToDate = true;
 	size_t lastUncompressedSize = 0;
@@ -87,6 +119,11 @@ class EntityParser
 	bool wasFileCompressed();
 	bool FileUpToDate() { return fileUpToDate;}
 	ParsingMode getMode() { return PARSEMODE; };
+	const EntityIndex& getFacets() const { return facets; }
+
+	/* Saved queries kept up to date as the tree is edited. See EntityIndex::SaveView */
+	void SaveView(const std::string& name, std::shared_ptr<const EntityQuery> query) { facets.SaveView(name, std::move(query)); }
+	void RemoveView(const std::string& name) { facets.RemoveView(name); }
 
 	/* For Debugging */
 	void logAllocatorInfo(bool includeBlockList, bool logToLogger, bool logToFile, const std::string filepath = "");
@@ -95,8 +132,8 @@ class EntityParser
 		fileUpToDate = false;
 	}
 
-	void WriteToFile(const std::string& filepath, bool compress) {
-		lastUncompressedSize = root.writeToFile(filepath, lastUncompressedSize + 10000, compress, eofblob, eofbloblength, true);
+	void WriteToFile(const std::string& filepath, bool compress, const Oodle::CompressionSettings& compression = Oodle::CompressionSettings()) {
+		lastUncompressedSize = root.writeToFile(filepath, lastUncompressedSize + 10000, compress, compression, eofblob, eofbloblength, true);
 		fileUpToDate = true;
 	}
 
@@ -118,6 +155,27 @@ class EntityParser
 	std::string_view lastUniqueToken;			// Stores most recent identifier or value token
 	std::string_view activeID;					// Second-most-recent token (typically an identifier)
 	size_t errorLine = 1;                       // If a grammar error is detected, this is the line it was found on
+	bool inputFinal = true;                     // False if more input may arrive after endchar (streamed parses only)
+	size_t retryLength = 0;                     // Input a stalled top-level item needs before it's parsed again (streamed parses only)
+
+	/* Thrown when a streamed parse reaches the end of incomplete input */
+	struct InputStall {};
+
+	/* Called where a token runs into endchar. If more input may follow, the token may just be cut off by it */
+	void stallIfTruncated() { if(!inputFinal) throw InputStall(); }
+
+	/* State of a parse fed through StreamInput */
+	struct {
+		std::string buffer;          // Input that hasn't been discarded yet
+		size_t parsed = 0;           // Length of the buffer's fully parsed prefix
+		size_t lineBase = 0;         // Number of lines discarded from the front of the buffer
+		size_t textLength = 0;       // Total length of the text received so far
+		std::string blob;            // Input received after the text's null terminator
+		size_t defaultBuffers[3];    // Allocator buffer lengths from before the stream began
+		bool started = false;
+		bool textEnded = false;
+		bool finished = false;
+	} inputStream;
 
 	// Every node generated during the current parse (except the root node)
 	// is inside here, or childed to a node inside here, until the moment it's
@@ -144,11 +202,31 @@ class EntityParser
 	* @param filepath .entites file to parse
 	* @param mode Parsing mode that will be followed
 	* @param debug_logParseTime If true, outputs execution time data
+	* @param decompressOnError If true and a compressed file fails to parse, the file is overwritten
+	* with it's decompressed text so the user can find and fix the error. Headless tools should
+	* pass false, so they never modify their input files
 	* @throw runtime_error thrown when the file cannot be parsed
 	*/
-	EntityParser(const std::string& filepath, const ParsingMode mode, const bool debug_logParseTime = false);
+	EntityParser(const std::string& filepath, const ParsingMode mode, const bool debug_logParseTime = false,
+		const bool decompressOnError = true);
+
+	/*
+	* Builds the tree from input supplied in chunks of any size, such as from a pipe or socket.
+	* Chunks may split tokens, strings and comments anywhere - the resulting tree is
+	* identical to parsing the concatenated input at once. Only use with an EntityParser 
+	* made by the EntityParser(ParsingMode) constructor. Once an exception is thrown, the
+	* parser must be discarded.
+	* 
+	* In ENTITIES mode, every complete top-level item is parsed as soon as it arrives, 
+	* and the input it came from is discarded. Other modes parse everything in StreamFinish
+	* @throw runtime_error thrown when the input cannot be parsed
+	*/
+	void StreamInput(std::string_view chunk);
+	void StreamFinish();
 
 	private:
+	void streamParseBuffer();
+
 	/*
 	* Creates an exception for a supplied parsing error
 	* The returned exception should be thrown immediately
@@ -161,6 +239,20 @@ class EntityParser
 
 	void firstparse(std::string_view dataview, const bool debug_log);
 
+	/*
+	* Decompresses an Oodle buffer on a worker thread while parsing the output as it's decoded
+	* @param decompressed Set true if decompression succeeded, even if parsing fails
+	*/
+	void streamparse(char* compressed, size_t compressedLength, char* output, size_t outputLength, 
+		bool& decompressed, const bool debug_log);
+
+	/* Estimated allocator capacities needed to parse text with the given character histogram */
+	struct AllocEstimate {
+		size_t text;
+		size_t nodes;
+	};
+	AllocEstimate estimateAllocations(const size_t* counts, size_t textLength);
+
 	// TODO: Get rid of intiateParse somehow - it's sloppy (or not - we may need it when we have multiple parsing modes)
 	// Consider renaming these other functions?
 
@@ -170,6 +262,8 @@ class EntityParser
 	*/
 	void initiateParse(std::string_view dataview, EntNode* tempRoot, EntNode* parent, ParseResult& results);
 	void parseContentsFile();
+	bool parseFileItem();
+	bool parseFileIncremental();
 	void parseContentsEntity();
 	void parseContentsLayer();
 	void parseContentsDefinition();
@@ -188,6 +282,46 @@ class EntityParser
 	 
 	void setNodeChildren(const size_t startIndex);
 
+	/* Recomputes the hashes of a node and it's ancestors, excluding the root */
+	void rehashAncestors(EntNode* node);
+
+	/*
+	* Replaces a block of a parent's children with the children of a temporary root node,
+	* then frees the temporary root's child buffer. Shared by EditTree and EditTreeCopy
+	*/
+	void mergeChildren(EntNode& tempRoot, EntNode* parent, int insertionIndex, int removeCount, bool renumberLists, bool highlightNew);
+
+	/*
+	* Edits a node's children to match a freshly parsed node with the same name, value and flags.
+	* Children with equal hashes are kept, and only the block between the matching prefix and suffix
+	* is replaced. If that block is a single child on both sides with matching text, it's edited the same
+	* way instead. Replaced fresh children are moved out of the fresh node, which the caller must free
+	*/
+	void mergeChanges(EntNode* live, EntNode* fresh, bool renumberLists, bool highlightNew);
+
+	/* Which entities parsing function would have parsed a node's children */
+	enum class CopyContext {
+		ANY,        // Not in entities mode. Flags are copied as-is
+		FILE,
+		ENTITY,
+		LAYER,
+		DEFINITION
+	};
+
+	/*
+	* Converts the flags of a node parsed in any mode to those the entities parser would give it
+	* @param context The parsing function that would parse the node
+	* @param childContext Set to the parsing function that would parse the node's children
+	* @return False if the entities parser would reject the node
+	*/
+	static bool entitiesCopyFlags(uint16_t& flags, bool hasValue, CopyContext context, CopyContext& childContext);
+
+	/*
+	* Allocates a copy of a node and it's descendants
+	* @return nullptr if the node is invalid in the given context. Nothing remains allocated
+	*/
+	EntNode* copyNode(const EntNode& source, uint16_t flags, std::string_view name, std::string_view value, CopyContext context);
+
 
 	/*
 	* TOKENIZATION FUNCTIONS
@@ -306,6 +440,25 @@ class EntityParser
 	*/
 	ParseResult EditTree(const std::string_view text, EntNode* parent, int insertionIndex, int removeCount, bool renumberLists, bool highlightNew);
 
+	/*
+	* Same result as EditTree replacing only the given node, but the tree is only edited where the
+	* parsed text differs from the node. Changing one property of a large entity replaces that property,
+	* and each changed block gets it's own small reverse command instead of one holding the whole node
+	* @param text Text to parse
+	* @param node Node the text replaces
+	*/
+	ParseResult EditNodeText(const std::string_view text, EntNode* node, bool renumberLists, bool highlightNew);
+
+	/*
+	* Same as EditTree, but inserts copies of already-parsed nodes instead of parsing text.
+	* The nodes may belong to a parser using a different parsing mode. When this parser is
+	* in entities mode, their flags are converted to what the entities parser would have
+	* given them, and the edit fails if it would have rejected their structure.
+	* Names and values aren't re-tokenized, so they're trusted to be valid
+	* @param sources Nodes to copy, in order
+	*/
+	ParseResult EditTreeCopy(const std::vector<NodeCopy>& sources, EntNode* parent, int insertionIndex, int removeCount, bool renumberLists, bool highlightNew);
+
 	/*
 	* Moves a node's child to a different index. The other children are shifted up/down to fill the original slot
 	* @param parent The node whose child we're moving
@@ -332,14 +485,27 @@ class EntityParser
 	* ===================
 	*/
 
-	#if entityparser_wxwidgets
+	/*
+	* Determines which entities pass the filters without modifying anything. May run on a
+	* worker thread, provided the tree isn't edited until it returns
+	* @param passed Receives the slot of every entity that passes
+	* @param cancel Checked before each entity. Once set, the result is left incomplete
+	* @return False if cancelled
+	*/
+	bool ComputeFilters(const FilterSettings& settings, EntityBitset& passed, const std::atomic<bool>& cancel) const;
 
-	private:
-	static const std::string FILTER_NOLAYERS;
-	static const std::string FILTER_NOCOMPONENTS;
+	/*
+	* Finds the next node containing a key, in the same order as EntNode::searchDownwards
+	* and searchUpwards, wrapping around the tree. Entities that are filtered out, or that
+	* the text index rules out, are skipped without being searched
+	* @return The matching node, or EntNode::SEARCH_404
+	*/
+	EntNode* SearchNext(EntNode* start, const std::string& key, bool backwards, bool caseSensitive, bool exactLength);
+
+	#if entityparser_wxwidgets
 
 	public:
-	wxDataViewCtrl* view = nullptr; // Must set this immediately after construction
+	EntityTreeView* view = nullptr; // Must set this immediately after construction
 
 	/*
 	* FILTER FUNCTIONS
@@ -352,11 +518,121 @@ class EntityParser
 	*/
 	void refreshFilterMenus(FilterCtrl* layerMenu, FilterCtrl* classMenu, FilterCtrl* inheritMenu, FilterCtrl* componentMenu, FilterCtrl* instanceidMenu);
 
+	/*
+	* Reads the filter menus and starts applying them on a worker thread, superseding any pass
+	* still in progress. When the pass completes, every entity's filtered flag is set at once
+	* and the view is refreshed. Edits interrupt a pass, which restarts once the edit is done
+	*/
 	void SetFilters(wxCheckListBox* layerMenu, wxCheckListBox* classMenu, wxCheckListBox* inheritMenu, wxCheckListBox* componentMenu, wxCheckListBox* idMenu,
-		bool filterSpawnPosition, Sphere spawnSphere, wxCheckListBox* textMenu, bool caseSensitiveText);
+		bool filterSpawnPosition, const std::vector<Sphere>& spawnSpheres, const std::vector<Box>& spawnBoxes,
+		wxCheckListBox* textMenu, bool caseSensitiveText,
+		std::shared_ptr<const EntityQuery> query = nullptr);
+
+	/* Stops the filter pass in progress without applying it */
+	void CancelFilters();
+
+	private:
+	struct {
+		std::thread worker;
+		std::atomic<bool> cancel{false};
+		FilterSettings settings;
+		unsigned generation = 0; // Incremented when a pass starts or is interrupted, so stale results are discarded
+		bool running = false;    // Started and not yet applied
+		bool restart = false;    // Interrupted by an edit
+		std::chrono::high_resolution_clock::time_point start;
+		std::shared_ptr<bool> alive = std::make_shared<bool>(true); // Queued callbacks hold weak references to this
+	} filterJob;
+
+	void startFilterJob();
+	void interruptFilters();
+	void publishFilters(unsigned generation, const EntityBitset& passed);
+
+	public:
 
 	void FilteredSearch(const std::string& key, bool backwards, bool caseSensitive, bool exactLength);
 
+	/* Selects a node, expanding it and scrolling the view to it */
+	void RevealNode(EntNode* node);
+
+	/*
+	* Starts collecting every node containing a key from the filtered-in entities on a worker
+	* thread, replacing the previous results. Results are added in batches, in the order
+	* FilteredSearch finds them. While a key is set, edits and filter changes clear the
+	* results and search again once they're done. An empty key clears the results
+	*/
+	void FindAll(const std::string& key, bool caseSensitive, bool exactLength);
+
+	/* Stops searching and clears the results */
+	void ClearFindAll();
+
+	/* The results found so far. They're cleared before any edit, so don't hold onto them */
+	const std::vector<EntNode*>& FindAllResults() const { return findJob.results; }
+	bool FindAllRunning() const { return findJob.running; }
+
+	/* Changes whenever the results are cleared */
+	uint64_t FindAllPass() const { return findJob.pass; }
+
+	/* Changes whenever the results change */
+	uint64_t FindAllRevision() const { return findJob.revision; }
+
+	private:
+	struct {
+		std::thread worker;
+		std::atomic<bool> cancel{false};
+		std::string key;
+		bool caseSensitive = false;
+		bool exactLength = false;
+		bool active = false;      // Set by a non-empty key, so edits know to search again
+		bool running = false;
+		bool restart = false;     // Interrupted by an edit
+		unsigned generation = 0;  // Incremented when a search starts or stops, so stale batches are discarded
+		uint64_t pass = 0;
+		uint64_t revision = 0;
+		std::vector<EntNode*> results;
+		std::chrono::high_resolution_clock::time_point start;
+		std::shared_ptr<bool> alive = std::make_shared<bool>(true); // Queued callbacks hold weak references to this
+	} findJob;
+
+	void startFindJob();
+	void stopFindJob();
+	void interruptFindAll();
+	void interruptWorkers(); // Called before the tree is edited
+	void publishFindAll(unsigned generation, const std::vector<EntNode*>& batch, bool finished);
+
+	/*
+	* NOTIFICATION BATCHING
+	*/
+	public:
+
+	/*
+	* While a batch is open the view is frozen, and changed or highlighted nodes are collected
+	* instead of being sent after every edit. They're sent together once the outermost batch
+	* closes, so replaying a large group selects and refreshes each node once. Additions and
+	* removals are still sent immediately - the view only marks it's rows outdated for them,
+	* and must hear about removed nodes before their memory is reused
+	*/
+	class NotificationBatch
+	{
+		EntityParser* parser;
+
+		public:
+		NotificationBatch(EntityParser* p_parser) : parser(p_parser) { parser->beginNotifications(); }
+		~NotificationBatch() { parser->endNotifications(); }
+	};
+
+	private:
+	struct {
+		int depth = 0;
+		size_t highlightCount = 0;
+		std::unordered_set<EntNode*> changed;
+		std::unordered_map<EntNode*, size_t> highlighted; // Maps to the order nodes were highlighted in
+	} notifyBatch;
+
+	void beginNotifications();
+	void endNotifications();
+	void notifyChanged(EntNode* node);   // Sends ItemChanged, or defers it until the batch closes
+	void notifyHighlight(EntNode* node); // Selects the node, or defers it until the batch closes
+
 	/*
 	* wxDataViewModel Functions
 	*/
@@ -365,6 +641,22 @@ class EntityParser
 	// wxWidgets calls this function very frequently, on every visible node, if you so much as breathe on the dataview
 	void GetValue(wxVariant& variant, const wxDataViewItem& item, unsigned int col) const override;
 
+	private:
+	/*
+	* GetValue's column text, built the first time a node is displayed. A node's labels may come
+	* from it's descendants, so edits uncache the edited node and it's ancestors. Freed nodes are uncached
+	*/
+	struct DisplayLabels {
+		wxString key;
+		wxString value;
+	};
+	mutable std::unordered_map<const EntNode*, DisplayLabels> displayCache;
+
+	const DisplayLabels& getDisplayLabels(EntNode* node) const;
+	void uncacheDisplay(EntNode* node);
+
+	public:
+
 	unsigned int GetChildren(const wxDataViewItem& parent, wxDataViewItemArray& array) const override
 	{
 		EntNode* node = (EntNode*)parent.GetID();
@@ -0,0 +1,486 @@
+#include "EntityQuery.h"
+#include "EntityNode.h"
+#include "TextSearch.h"
+#include "WorkerPool.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+EntNode& EntityFields::Path(const EntNode& node, std::string_view path)
+{
+	const EntNode* current = &node;
+	while (current != EntNode::SEARCH_404) {
+		size_t slash = path.find('/');
+		current = &(*current)[path.substr(0, slash)];
+		if(slash == std::string_view::npos)
+			break;
+		path.remove_prefix(slash + 1);
+	}
+	return *const_cast<EntNode*>(current);
+}
+
+std::string_view EntityFields::Class(const EntNode& entity)
+{
+	EntNode& entityDef = entity["entityDef"];
+	EntNode& classNode = entityDef["class"];
+	if(classNode.ValueLength() > 0)
+		return classNode.getValueUQ();
+	return entityDef["systemVars"]["entityType"].getValueUQ();
+}
+
+std::string_view EntityFields::Name(const EntNode& entity)
+{
+	return entity["entityDef"].getValue();
+}
+
+/*
+* ==============
+* COMPILED PLAN
+* ==============
+*/
+
+enum class query_field
+{
+	path,
+	classname,
+	inherit,
+	name,
+	layers,
+	components
+};
+
+enum class query_op
+{
+	eq, ne, lt, le, gt, ge,
+	contains,
+	exists
+};
+
+struct EntityQuery::Term
+{
+	enum Type { AND, OR, NOT, COMPARE } type;
+	std::vector<std::unique_ptr<Term>> operands;
+
+	// Comparisons only
+	query_field field = query_field::path;
+	std::string path;
+	query_op op = query_op::exists;
+	std::string value;
+	bool numeric = false; // True if the value is a number
+	double number = 0;
+
+	Term(Type t) : type(t) {}
+};
+
+/* @return False unless the whole text is a finite number */
+bool query_number(std::string_view text, double& result)
+{
+	char buffer[64];
+	if(text.empty() || text.length() >= sizeof(buffer))
+		return false;
+	memcpy(buffer, text.data(), text.length());
+	buffer[text.length()] = '\0';
+
+	char* end;
+	result = strtod(buffer, &end);
+	return end == buffer + text.length() && std::isfinite(result);
+}
+
+bool query_compare(std::string_view actual, const EntityQuery::Term& t)
+{
+	int order;
+	double number;
+	if(t.numeric && query_number(actual, number))
+		order = number < t.number ? -1 : number > t.number ? 1 : 0;
+	else order = actual.compare(t.value);
+
+	switch (t.op)
+	{
+		case query_op::eq: return order == 0;
+		case query_op::ne: return order != 0;
+		case query_op::lt: return order < 0;
+		case query_op::le: return order <= 0;
+		case query_op::gt: return order > 0;
+		case query_op::ge: return order >= 0;
+		default: return false;
+	}
+}
+
+/* Compares a list property. != requires every element to differ, other comparisons require any one element to match */
+bool query_comparelist(const std::vector<std::string_view>& values, const EntityQuery::Term& t)
+{
+	if(t.op == query_op::exists)
+		return !values.empty();
+
+	bool negate = t.op == query_op::ne;
+	EntityQuery::Term positive = EntityQuery::Term(EntityQuery::Term::COMPARE);
+	positive.op = t.op == query_op::contains || negate ? query_op::eq : t.op;
+	positive.value = t.value;
+	positive.numeric = t.numeric;
+	positive.number = t.number;
+
+	for(std::string_view v : values)
+		if(query_compare(v, positive))
+			return !negate;
+	return negate;
+}
+
+bool query_evaluate(const EntityQuery::Term& t, const EntNode& entity)
+{
+	switch (t.type)
+	{
+		case EntityQuery::Term::AND:
+		for(const auto& operand : t.operands)
+			if(!query_evaluate(*operand, entity))
+				return false;
+		return true;
+
+		case EntityQuery::Term::OR:
+		for(const auto& operand : t.operands)
+			if(query_evaluate(*operand, entity))
+				return true;
+		return false;
+
+		case EntityQuery::Term::NOT:
+		return !query_evaluate(*t.operands[0], entity);
+
+		default:
+		break;
+	}
+
+	std::vector<std::string_view> list;
+	switch (t.field)
+	{
+		case query_field::classname: case query_field::inherit: case query_field::name:
+		{
+			std::string_view value = t.field == query_field::classname ? EntityFields::Class(entity)
+				: t.field == query_field::inherit ? entity["entityDef"]["inherit"].getValueUQ()
+				: EntityFields::Name(entity);
+			if(t.op == query_op::exists)
+				return !value.empty();
+			if(value.empty())
+				return t.op == query_op::ne;
+			if(t.op == query_op::contains)
+				return TextSearch::Contains(value, t.value, true);
+			return query_compare(value, t);
+		}
+
+		case query_field::layers:
+		{
+			EntNode& layers = entity["layers"];
+			for(int i = 0; i < layers.getChildCount(); i++)
+				list.push_back(layers.ChildAt(i)->getNameUQ());
+			return query_comparelist(list, t);
+		}
+
+		case query_field::components:
+		{
+			EntNode& components = EntityFields::Path(entity, "entityDef/edit/components");
+			for (int i = 0; i < components.getChildCount(); i++) {
+				EntNode& className = (*components.ChildAt(i))["className"];
+				if(className.ValueLength() > 0)
+					list.push_back(className.getValueUQ());
+			}
+			return query_comparelist(list, t);
+		}
+
+		default:
+		break;
+	}
+
+	EntNode& node = EntityFields::Path(entity, t.path);
+	if(t.op == query_op::exists)
+		return &node != EntNode::SEARCH_404;
+	if(&node == EntNode::SEARCH_404)
+		return t.op == query_op::ne;
+
+	if (t.op == query_op::contains) {
+		if(node.getChildCount() == 0)
+			return TextSearch::Contains(node.getValueUQ(), t.value, true);
+		for (int i = 0; i < node.getChildCount(); i++) {
+			EntNode* child = node.ChildAt(i);
+			if(child->getNameUQ() == t.value || child->getValueUQ() == t.value)
+				return true;
+		}
+		return false;
+	}
+	return query_compare(node.getValueUQ(), t);
+}
+
+/*
+* Narrows down the entities a term can match using the index
+* @return False if the index can't narrow the term
+*/
+bool query_candidates(const EntityQuery::Term& t, const EntityIndex& index, EntityBitset& result)
+{
+	EntityBitset operand;
+	switch (t.type)
+	{
+		case EntityQuery::Term::AND:
+		{
+			bool narrowed = false;
+			for (const auto& o : t.operands) {
+				if(!query_candidates(*o, index, operand))
+					continue;
+				if(narrowed)
+					result.AndWith(operand);
+				else result = operand;
+				narrowed = true;
+			}
+			return narrowed;
+		}
+
+		case EntityQuery::Term::OR:
+		result.clear();
+		for (const auto& o : t.operands) {
+			if(!query_candidates(*o, index, operand))
+				return false;
+			result.OrWith(operand);
+		}
+		return true;
+
+		case EntityQuery::Term::NOT:
+		return false;
+
+		default:
+		break;
+	}
+
+	// Facet values are compared as text, so numeric comparisons can't use them
+	if(t.numeric)
+		return false;
+
+	EntityIndex::Facet facet;
+	switch (t.field)
+	{
+		case query_field::classname: facet = EntityIndex::FACET_CLASS; break;
+		case query_field::inherit: facet = EntityIndex::FACET_INHERIT; break;
+		case query_field::layers: facet = EntityIndex::FACET_LAYER; break;
+		case query_field::components: facet = EntityIndex::FACET_COMPONENT; break;
+		default: return false;
+	}
+
+	bool isList = t.field == query_field::layers || t.field == query_field::components;
+	if(t.op != query_op::eq && !(isList && t.op == query_op::contains))
+		return false;
+	index.Match(facet, {t.value}, result);
+	return true;
+}
+
+/*
+* ==============
+* COMPILER
+* ==============
+*/
+
+class query_compiler
+{
+	enum TokenType { END, WORD, STRING, OPEN, CLOSE, OPERATOR };
+
+	std::string_view text;
+	size_t pos = 0;
+
+	TokenType type = END;
+	std::string_view token;
+	size_t tokenStart = 0;
+
+	std::runtime_error error(const std::string& msg)
+	{
+		return std::runtime_error("Query error at character " + std::to_string(tokenStart + 1) + ": " + msg);
+	}
+
+	void next()
+	{
+		while(pos < text.length() && isspace((unsigned char)text[pos]))
+			pos++;
+		tokenStart = pos;
+		if (pos == text.length()) {
+			type = END;
+			token = "";
+			return;
+		}
+
+		char c = text[pos];
+		if (c == '(' || c == ')') {
+			type = c == '(' ? OPEN : CLOSE;
+			token = text.substr(pos++, 1);
+		}
+		else if (c == '"') {
+			size_t close = text.find('"', pos + 1);
+			if(close == std::string_view::npos)
+				throw error("Unterminated string");
+			type = STRING;
+			token = text.substr(pos + 1, close - pos - 1);
+			pos = close + 1;
+		}
+		else if (strchr("=!<>", c) != nullptr) {
+			size_t length = pos + 1 < text.length() && text[pos + 1] == '=' ? 2 : 1;
+			type = OPERATOR;
+			token = text.substr(pos, length);
+			pos += length;
+			if(token == "!")
+				throw error("Expected !=");
+		}
+		else {
+			size_t start = pos;
+			while(pos < text.length() && !isspace((unsigned char)text[pos]) && strchr("()\"=!<>", text[pos]) == nullptr)
+				pos++;
+			type = WORD;
+			token = text.substr(start, pos - start);
+		}
+	}
+
+	bool keyword(const char* word)
+	{
+		if(type != WORD || token.length() != strlen(word))
+			return false;
+		for(size_t i = 0; i < token.length(); i++)
+			if(tolower((unsigned char)token[i]) != word[i])
+				return false;
+		return true;
+	}
+
+	std::unique_ptr<EntityQuery::Term> parseOr()
+	{
+		std::unique_ptr<EntityQuery::Term> first = parseAnd();
+		if(!keyword("or"))
+			return first;
+
+		auto term = std::make_unique<EntityQuery::Term>(EntityQuery::Term::OR);
+		term->operands.push_back(std::move(first));
+		while (keyword("or")) {
+			next();
+			term->operands.push_back(parseAnd());
+		}
+		return term;
+	}
+
+	std::unique_ptr<EntityQuery::Term> parseAnd()
+	{
+		std::unique_ptr<EntityQuery::Term> first = parseUnary();
+		if(!keyword("and"))
+			return first;
+
+		auto term = std::make_unique<EntityQuery::Term>(EntityQuery::Term::AND);
+		term->operands.push_back(std::move(first));
+		while (keyword("and")) {
+			next();
+			term->operands.push_back(parseUnary());
+		}
+		return term;
+	}
+
+	std::unique_ptr<EntityQuery::Term> parseUnary()
+	{
+		if (keyword("not")) {
+			next();
+			auto term = std::make_unique<EntityQuery::Term>(EntityQuery::Term::NOT);
+			term->operands.push_back(parseUnary());
+			return term;
+		}
+		if (type == OPEN) {
+			next();
+			std::unique_ptr<EntityQuery::Term> term = parseOr();
+			if(type != CLOSE)
+				throw error("Expected )");
+			next();
+			return term;
+		}
+		return parseComparison();
+	}
+
+	std::unique_ptr<EntityQuery::Term> parseComparison()
+	{
+		if(type != WORD && type != STRING)
+			throw error(type == END ? "Expected a comparison" : "Expected a path instead of " + std::string(token));
+
+		auto term = std::make_unique<EntityQuery::Term>(EntityQuery::Term::COMPARE);
+		term->path = std::string(token);
+		if(type == WORD) {
+			const struct { const char* name; query_field field; } properties[] = {
+				{"class", query_field::classname}, {"inherit", query_field::inherit}, {"name", query_field::name},
+				{"layers", query_field::layers}, {"components", query_field::components}
+			};
+			for(const auto& p : properties)
+				if(token == p.name)
+					term->field = p.field;
+		}
+		next();
+
+		const struct { const char* text; query_op op; } operators[] = {
+			{"==", query_op::eq}, {"=", query_op::eq}, {"!=", query_op::ne}, {"<", query_op::lt},
+			{"<=", query_op::le}, {">", query_op::gt}, {">=", query_op::ge}
+		};
+		if (keyword("exists")) {
+			term->op = query_op::exists;
+			next();
+			return term;
+		}
+		if(keyword("contains"))
+			term->op = query_op::contains;
+		else if (type == OPERATOR) {
+			for(const auto& o : operators)
+				if(token == o.text)
+					term->op = o.op;
+		}
+		else throw error("Expected an operator after " + term->path);
+		next();
+
+		if(type != WORD && type != STRING)
+			throw error("Expected a value to compare with");
+		term->value = std::string(token);
+		term->numeric = type == WORD && query_number(token, term->number);
+		next();
+		return term;
+	}
+
+	public:
+	std::unique_ptr<EntityQuery::Term> compile(std::string_view p_text)
+	{
+		text = p_text;
+		next();
+		std::unique_ptr<EntityQuery::Term> plan = parseOr();
+		if(type != END)
+			throw error("Unexpected " + std::string(token));
+		return plan;
+	}
+};
+
+EntityQuery::EntityQuery(std::string_view p_text) : text(p_text)
+{
+	plan = query_compiler().compile(text);
+}
+
+EntityQuery::~EntityQuery() = default;
+
+bool EntityQuery::Matches(const EntNode& entity) const
+{
+	return query_evaluate(*plan, entity);
+}
+
+void EntityQuery::Run(const EntityIndex& index, EntityBitset& result, const std::atomic<bool>* cancel, unsigned maxThreads) const
+{
+	EntityBitset candidates;
+	bool narrowed = query_candidates(*plan, index, candidates);
+
+	// Each job writes only to its own range of slots
+	const size_t CHUNK = 1024;
+	size_t count = index.SlotCount();
+	std::vector<uint8_t> matched(count, 0);
+	WorkerPool::ParallelFor((count + CHUNK - 1) / CHUNK, [&](size_t chunk) {
+		for (size_t slot = chunk * CHUNK, end = std::min(count, slot + CHUNK); slot < end; slot++) {
+			if(cancel != nullptr && *cancel)
+				return;
+			EntNode* entity = index.EntityAt(slot);
+			if(entity != nullptr && (!narrowed || candidates.test(slot)) && Matches(*entity))
+				matched[slot] = 1;
+		}
+	}, maxThreads);
+
+	result.clear();
+	for(size_t slot = 0; slot < count; slot++)
+		if(matched[slot])
+			result.set(slot);
+}
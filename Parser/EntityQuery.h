@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "EntityIndex.h"
+
+class EntNode;
+
+/*
+* Lookups of entity properties shared by the indexes, queries and tools
+*/
+namespace EntityFields
+{
+	/*
+	* Follows child names separated by '/' down from a node
+	* @return The node reached, or EntNode::SEARCH_404 if a name isn't found
+	*/
+	EntNode& Path(const EntNode& node, std::string_view path);
+
+	/* The entityDef's class, or systemVars entityType if there isn't one. Quotes are removed */
+	std::string_view Class(const EntNode& entity);
+
+	/* The entityDef's name */
+	std::string_view Name(const EntNode& entity);
+}
+
+/*
+* A filter over entities, compiled from text such as:
+*     entityDef/edit/spawnPosition/x > 100 and class == "idAI2" and layers contains "spawn_1"
+*
+* Comparisons: path == value, !=, <, <=, >, >=, path contains value, path exists
+* Combinators: and, or, not, parentheses
+*
+* Paths are child names separated by '/', starting from the entity. These names are properties
+* instead of paths: class, inherit, name (of the entityDef), layers, components (their classNames).
+* Values are quoted strings, or unquoted words and numbers.
+*
+* Values are compared as numbers when both sides are numbers, and as text otherwise. Quotes are
+* removed from node values first. contains checks the children of a node (by name or value) and
+* list properties for the value, and otherwise looks for it as a substring. Comparisons with
+* missing nodes and properties are false, except for !=
+*/
+class EntityQuery
+{
+	public:
+	struct Term;
+
+	private:
+	std::unique_ptr<Term> plan;
+	std::string text;
+
+	public:
+	/* @throw runtime_error if the query can't be compiled */
+	EntityQuery(std::string_view p_text);
+	~EntityQuery();
+
+	const std::string& getText() const { return text; }
+
+	bool Matches(const EntNode& entity) const;
+
+	/*
+	* Finds every indexed entity the query matches. The index narrows down the entities checked
+	* when the query compares class, inherit, layers or components with text. The remaining
+	* entities are checked in parallel
+	* @param cancel If given, checked before each entity. Once set, the result is incomplete
+	* @param maxThreads Upper limit on the number of threads used. 0 to use every core
+	*/
+	void Run(const EntityIndex& index, EntityBitset& result, const std::atomic<bool>* cancel = nullptr, unsigned maxThreads = 0) const;
+};
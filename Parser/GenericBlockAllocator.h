@@ -80,6 +80,11 @@ class BlockAllocator
 		return buffer.str();
 	}
 
+	size_t getNewBufferLength() const { return newBufferLength; }
+
+	/* Changes the length of buffers created once the active buffer is exhausted */
+	void setNewBufferLength(const size_t length) { newBufferLength = length; }
+
 	/* Defines a new buffer of a desired capacity as the active buffer */
 	void setActiveBuffer(const size_t capacity)
 	{
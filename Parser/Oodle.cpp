@@ -2,16 +2,24 @@
 // -- edited by Scorp0rX0r 09/09/2020 - Remove file operations and work with streams only.
 // -- Further edited by FlavorfulGecko5 to integrate into .entities parser
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#else
+#include <dlfcn.h>
+#define WINAPI
+#endif
+#include <cstdint>
+#include <mutex>
+#include <atomic>
 #include "Oodle.h"
 
 /* Typedefs from original program */
 typedef unsigned char byte;
 typedef unsigned char uint8;
 typedef unsigned int uint32;
-typedef unsigned __int64 uint64;
-typedef signed __int64 int64;
+typedef uint64_t uint64;
+typedef int64_t int64;
 typedef signed int int32;
 typedef unsigned short uint16;
 typedef signed short int16;
@@ -22,30 +30,77 @@ typedef int WINAPI OodLZ_CompressFunc(
     int codec, uint8* src_buf, size_t src_len, uint8* dst_buf, int level,
     void* opts, size_t offs, size_t unused, void* scratch, size_t scratch_size);
 
+typedef int WINAPI OodLZ_DecompressCallback(void* userdata, const uint8* rawBuf, size_t rawLen, 
+    const uint8* compBuf, size_t compBufferSize, size_t rawDone, size_t compUsed);
+
 typedef int WINAPI OodLZ_DecompressFunc(uint8* src_buf, int src_len, uint8* dst, size_t dst_size,
     int fuzz, int crc, int verbose,
-    uint8* dst_base, size_t e, void* cb, void* cb_ctx, void* scratch, size_t scratch_size, int threadPhase);
+    uint8* dst_base, size_t e, OodLZ_DecompressCallback* cb, void* cb_ctx, void* scratch, size_t scratch_size, int threadPhase);
 
 /* Variables used in Oodle Functions */
+#ifdef _WIN32
 HMODULE oodle;
+#else
+void* oodle;
+#endif
+std::mutex initMutex; // Files may be parsed on several threads
 OodLZ_CompressFunc* OodLZ_Compress;
 OodLZ_DecompressFunc* OodLZ_Decompress;
-bool initializedSuccessfully = false;
+std::atomic<bool> initializedSuccessfully(false);
+
+const char* Oodle::CompressorName(int compressor)
+{
+    switch (compressor)
+    {
+        case COMPRESSOR_KRAKEN: return "Kraken";
+        case COMPRESSOR_MERMAID: return "Mermaid";
+        case COMPRESSOR_SELKIE: return "Selkie";
+        case COMPRESSOR_HYDRA: return "Hydra";
+        case COMPRESSOR_LEVIATHAN: return "Leviathan";
+        default: return "Unknown";
+    }
+}
+
+const char* Oodle::LevelName(int level)
+{
+    const char* names[LEVEL_COUNT] = {"None", "SuperFast", "VeryFast", "Fast", "Normal", 
+        "Optimal1", "Optimal2", "Optimal3", "Optimal4", "Optimal5"};
+    if(level < 0 || level >= LEVEL_COUNT)
+        return "Unknown";
+    return names[level];
+}
 
 bool Oodle::init()
 {
-    initializedSuccessfully = false;
+    std::lock_guard<std::mutex> lock(initMutex);
+    if (initializedSuccessfully)
+        return true;
 
+    #ifdef _WIN32
     oodle = LoadLibraryA("./oo2core_8_win64.dll");
     if (oodle == nullptr) // Could not find oodle binary
         return false;
 
     OodLZ_Decompress = (OodLZ_DecompressFunc*)GetProcAddress(oodle, "OodleLZ_Decompress");
     OodLZ_Compress = (OodLZ_CompressFunc*)GetProcAddress(oodle, "OodleLZ_Compress");
+    #else
+    oodle = dlopen("./liboo2corelinux64.so.9", RTLD_NOW | RTLD_LOCAL);
+    if (oodle == nullptr)
+        oodle = dlopen("liboo2corelinux64.so.9", RTLD_NOW | RTLD_LOCAL);
+    if (oodle == nullptr)
+        return false;
+
+    OodLZ_Decompress = (OodLZ_DecompressFunc*)dlsym(oodle, "OodleLZ_Decompress");
+    OodLZ_Compress = (OodLZ_CompressFunc*)dlsym(oodle, "OodleLZ_Compress");
+    #endif
 
     if (OodLZ_Decompress == nullptr || OodLZ_Compress == nullptr)
     { // Couldn't find the function(s)
+        #ifdef _WIN32
         FreeLibrary(oodle);
+        #else
+        dlclose(oodle);
+        #endif
         oodle = nullptr;
         OodLZ_Decompress = nullptr;
         OodLZ_Compress = nullptr;
@@ -62,20 +117,48 @@ bool Oodle::DecompressBuffer(char* inputBuffer, size_t inputSize, char* outputBu
         return false;
 
     int result = OodLZ_Decompress((byte*)inputBuffer, (int)inputSize, (byte*)outputBuffer, outputSize,
-        1, 1, 0, NULL, NULL, NULL, NULL, NULL, NULL, 0);
+        1, 1, 0, NULL, 0, NULL, NULL, NULL, 0, 0);
+
+    if ((size_t)result != outputSize) // Decompression failed
+        return false;
+    return true;
+}
+
+struct progresscontext_t {
+    Oodle::DecompressProgress progress;
+    void* context;
+};
+
+int WINAPI DecompressProgressCallback(void* userdata, const uint8* /*rawBuf*/, size_t /*rawLen*/,
+    const uint8* /*compBuf*/, size_t /*compBufferSize*/, size_t rawDone, size_t /*compUsed*/)
+{
+    progresscontext_t* ctx = (progresscontext_t*)userdata;
+    return ctx->progress(ctx->context, rawDone) ? 0 : 1; // Continue : Cancel
+}
+
+bool Oodle::DecompressBufferProgressive(char* inputBuffer, size_t inputSize, char* outputBuffer, size_t outputSize,
+    DecompressProgress progress, void* context)
+{
+    if (!initializedSuccessfully && !init())
+        return false;
+
+    progresscontext_t ctx = {progress, context};
+    int result = OodLZ_Decompress((byte*)inputBuffer, (int)inputSize, (byte*)outputBuffer, outputSize,
+        1, 1, 0, NULL, 0, DecompressProgressCallback, &ctx, NULL, 0, 0);
 
     if ((size_t)result != outputSize) // Decompression failed
         return false;
+    progress(context, outputSize); // The final block isn't guaranteed a callback
     return true;
 }
 
-bool Oodle::CompressBuffer(char* inputBuffer, size_t inputSize, char* outputBuffer, size_t& outputSize)
+bool Oodle::CompressBuffer(char* inputBuffer, size_t inputSize, char* outputBuffer, size_t& outputSize, const CompressionSettings& settings)
 {
     if (!initializedSuccessfully && !init())
         return false;
 
-    int compressedSize = OodLZ_Compress(13, (byte*)inputBuffer, inputSize, (byte*)outputBuffer,
-        4, 0, 0, 0, 0, 0);
+    int compressedSize = OodLZ_Compress(settings.compressor, (byte*)inputBuffer, inputSize, (byte*)outputBuffer,
+        settings.level, 0, 0, 0, 0, 0);
     if (compressedSize < 0) // Compression failed
         return false;
 
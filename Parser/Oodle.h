@@ -1,10 +1,57 @@
 // idMapFileEditor 0.1 by proteh
 // -- edited by Scorp0rX0r 09/09/2020 - Remove file operations and work with streams only.
 // -- Further edited by FlavorfulGecko5 to integrate into .entities parser
+#pragma once
+#include <cstddef>
 
 namespace Oodle 
 {
+    /* Compressor ids accepted by OodleLZ_Compress */
+    enum Compressor : int {
+        COMPRESSOR_KRAKEN = 8,
+        COMPRESSOR_MERMAID = 9,
+        COMPRESSOR_SELKIE = 11,
+        COMPRESSOR_HYDRA = 12,
+        COMPRESSOR_LEVIATHAN = 13 // What the game ships with
+    };
+
+    /* Compression levels - higher levels trade speed for a smaller file */
+    enum Level : int {
+        LEVEL_NONE = 0,
+        LEVEL_SUPERFAST,
+        LEVEL_VERYFAST,
+        LEVEL_FAST,
+        LEVEL_NORMAL,
+        LEVEL_OPTIMAL1,
+        LEVEL_OPTIMAL2,
+        LEVEL_OPTIMAL3,
+        LEVEL_OPTIMAL4,
+        LEVEL_OPTIMAL5,
+        LEVEL_COUNT
+    };
+
+    const int CompressorList[] = {COMPRESSOR_KRAKEN, COMPRESSOR_MERMAID, COMPRESSOR_SELKIE, COMPRESSOR_HYDRA, COMPRESSOR_LEVIATHAN};
+    const int CompressorCount = sizeof(CompressorList) / sizeof(CompressorList[0]);
+
+    struct CompressionSettings {
+        int compressor = COMPRESSOR_LEVIATHAN;
+        int level = LEVEL_NORMAL;
+    };
+
+    const char* CompressorName(int compressor);
+    const char* LevelName(int level);
+
     bool init();
     bool DecompressBuffer(char* inputBuffer, size_t inputSize, char* outputBuffer, size_t outputSize);
-    bool CompressBuffer(char* inputBuffer, size_t inputSize, char* outputBuffer, size_t& outputSize);
+
+    /*
+    * Same as DecompressBuffer, but reports progress after every decoded block
+    * @param progress Receives the number of bytes fully decoded at the start of outputBuffer.
+    * Returning false cancels decompression
+    */
+    typedef bool (*DecompressProgress)(void* context, size_t bytesDecoded);
+    bool DecompressBufferProgressive(char* inputBuffer, size_t inputSize, char* outputBuffer, size_t outputSize,
+        DecompressProgress progress, void* context);
+    bool CompressBuffer(char* inputBuffer, size_t inputSize, char* outputBuffer, size_t& outputSize, 
+        const CompressionSettings& settings = CompressionSettings());
 }
\ No newline at end of file
@@ -1,16 +1,26 @@
 #pragma once
 
+/*
+* Each flag may be overridden by the build, i.e. for the headless tools
+*/
+
 /*
 * If set to 0, compile the EntityParser to be stand-alone from wxWidgets
 */
+#ifndef entityparser_wxwidgets
 #define entityparser_wxwidgets 1
+#endif
 
 /*
 * If set to 0, disable the history system
 */
+#ifndef entityparser_history
 #define entityparser_history 1
+#endif
 
 /*
 * If set to 0, disable usage of the Oodle compression system
 */
-#define entityparser_oodle 1
\ No newline at end of file
+#ifndef entityparser_oodle
+#define entityparser_oodle 1
+#endif
@@ -0,0 +1,165 @@
+#include "TextSearch.h"
+#include "EntityNode.h"
+#include <cstring>
+#include <queue>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define textsearch_sse2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define textsearch_sse2 0
+#endif
+
+/* Compares the characters between a candidate's first and last */
+bool textsearch_verify(const char* text, std::string_view key, bool caseSensitive)
+{
+	if(key.length() <= 2)
+		return true;
+	if(caseSensitive)
+		return memcmp(text + 1, key.data() + 1, key.length() - 2) == 0;
+	for(size_t i = 1; i < key.length() - 1; i++)
+		if(TextSearch::Fold(text[i]) != TextSearch::Fold(key[i]))
+			return false;
+	return true;
+}
+
+#if textsearch_sse2
+inline __m128i textsearch_fold(__m128i v)
+{
+	__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('`')), _mm_cmplt_epi8(v, _mm_set1_epi8('{')));
+	return _mm_sub_epi8(v, _mm_and_si128(lower, _mm_set1_epi8(0x20)));
+}
+
+inline unsigned textsearch_lowestbit(unsigned mask)
+{
+	#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned)index;
+	#else
+	return (unsigned)__builtin_ctz(mask);
+	#endif
+}
+#endif
+
+bool TextSearch::Contains(std::string_view text, std::string_view key, bool caseSensitive)
+{
+	size_t n = text.length(), k = key.length();
+	if(k == 0)
+		return true;
+	if(k > n)
+		return false;
+
+	const char* data = text.data();
+	char first = caseSensitive ? key[0] : Fold(key[0]);
+	char last = caseSensitive ? key[k - 1] : Fold(key[k - 1]);
+	size_t i = 0;
+
+	#if textsearch_sse2
+	const __m128i firstBlock = _mm_set1_epi8(first);
+	const __m128i lastBlock = _mm_set1_epi8(last);
+	for (; i + k - 1 + 16 <= n; i += 16)
+	{
+		__m128i starts = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i ends = _mm_loadu_si128((const __m128i*)(data + i + k - 1));
+		if (!caseSensitive) {
+			starts = textsearch_fold(starts);
+			ends = textsearch_fold(ends);
+		}
+
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(starts, firstBlock), _mm_cmpeq_epi8(ends, lastBlock)));
+		while (mask != 0) {
+			if(textsearch_verify(data + i + textsearch_lowestbit(mask), key, caseSensitive))
+				return true;
+			mask &= mask - 1;
+		}
+	}
+	#endif
+
+	for (; i + k <= n; i++)
+	{
+		char c1 = data[i], c2 = data[i + k - 1];
+		if(!caseSensitive) {
+			c1 = Fold(c1);
+			c2 = Fold(c2);
+		}
+		if(c1 == first && c2 == last && textsearch_verify(data + i, key, caseSensitive))
+			return true;
+	}
+	return false;
+}
+
+KeyMatcher::KeyMatcher(const std::vector<std::string>& keys, bool p_caseSensitive) : caseSensitive(p_caseSensitive)
+{
+	// Build a trie of the keys, with -1 for missing transitions
+	transitions.assign(256, -1);
+	accepting.assign(1, 0);
+	for (const std::string& key : keys) {
+		int32_t state = 0;
+		for (char c : key) {
+			unsigned char u = (unsigned char)(caseSensitive ? c : TextSearch::Fold(c));
+			if (transitions[state * 256 + u] < 0) {
+				transitions[state * 256 + u] = (int32_t)accepting.size();
+				accepting.push_back(0);
+				transitions.resize(transitions.size() + 256, -1);
+			}
+			state = transitions[state * 256 + u];
+		}
+		accepting[state] = 1;
+	}
+
+	// Turn the trie into a complete automaton, visiting states breadth-first so each
+	// state's failure state is finished before it
+	std::vector<int32_t> failure(accepting.size(), 0);
+	std::queue<int32_t> pending;
+	for (int c = 0; c < 256; c++) {
+		int32_t& next = transitions[c];
+		if(next < 0)
+			next = 0;
+		else pending.push(next);
+	}
+	while (!pending.empty()) {
+		int32_t state = pending.front();
+		pending.pop();
+		accepting[state] |= accepting[failure[state]];
+		for (int c = 0; c < 256; c++) {
+			int32_t& next = transitions[state * 256 + c];
+			int32_t fallback = transitions[failure[state] * 256 + c];
+			if(next < 0)
+				next = fallback;
+			else {
+				failure[next] = fallback;
+				pending.push(next);
+			}
+		}
+	}
+}
+
+bool KeyMatcher::Matches(std::string_view text) const
+{
+	if(accepting[0])
+		return true;
+
+	int32_t state = 0;
+	for (char c : text) {
+		unsigned char u = (unsigned char)(caseSensitive ? c : TextSearch::Fold(c));
+		state = transitions[state * 256 + u];
+		if(accepting[state])
+			return true;
+	}
+	return false;
+}
+
+bool KeyMatcher::MatchesTree(const EntNode& node) const
+{
+	if(Matches(std::string_view(node.NamePtr(), node.NameLength() + node.ValueLength())))
+		return true;
+	for(int i = 0; i < node.getChildCount(); i++)
+		if(MatchesTree(*node.ChildAt(i)))
+			return true;
+	return false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+class EntNode;
+
+/*
+* Substring search kernels shared by the node searches and filters. Case-insensitive
+* searches only fold ASCII letters, matching the rest of the parser
+*/
+namespace TextSearch
+{
+	/* Folds a lowercase ASCII letter to uppercase */
+	inline char Fold(char c)
+	{
+		return c > '`' && c < '{' ? c - 32 : c;
+	}
+
+	/*
+	* Finds a key by comparing the key's first and last characters against 16 positions 
+	* at once, then verifying the positions where both match. An empty key is always found
+	*/
+	bool Contains(std::string_view text, std::string_view key, bool caseSensitive);
+}
+
+/*
+* Aho-Corasick automaton that finds any of several keys in a single pass over a text
+*/
+class KeyMatcher
+{
+	private:
+	std::vector<int32_t> transitions; // State * 256 + character -> next state
+	std::vector<uint8_t> accepting;   // State -> whether a key ends at it
+	bool caseSensitive;
+
+	public:
+	KeyMatcher(const std::vector<std::string>& keys, bool p_caseSensitive);
+
+	bool Matches(std::string_view text) const;
+
+	/* True if the text of any node in the subtree contains a key. Keys never span two nodes */
+	bool MatchesTree(const EntNode& node) const;
+};
@@ -0,0 +1,106 @@
+#include "TrigramIndex.h"
+#include "EntityIndex.h"
+#include "EntityNode.h"
+#include <algorithm>
+#include <iterator>
+
+uint32_t trigram_fold(char c)
+{
+	if(c > '`' && c < '{') c -= 32;
+	return (unsigned char)c;
+}
+
+/* Appends the trigrams of a text, including repeats */
+void trigram_append(std::string_view text, std::vector<uint32_t>& trigrams)
+{
+	if(text.length() < TrigramIndex::MIN_KEY_LENGTH)
+		return;
+	uint32_t t = trigram_fold(text[0]) << 8 | trigram_fold(text[1]);
+	for (size_t i = 2; i < text.length(); i++) {
+		t = (t << 8 | trigram_fold(text[i])) & 0xFFFFFF;
+		trigrams.push_back(t);
+	}
+}
+
+void trigram_appendtree(const EntNode& node, std::vector<uint32_t>& trigrams)
+{
+	trigram_append(std::string_view(node.NamePtr(), node.NameLength() + node.ValueLength()), trigrams);
+	for(int i = 0; i < node.getChildCount(); i++)
+		trigram_appendtree(*node.ChildAt(i), trigrams);
+}
+
+void TrigramIndex::Clear()
+{
+	postings.clear();
+	slotTrigrams.clear();
+}
+
+void TrigramIndex::Add(size_t slot, const EntNode& entity)
+{
+	if(slot >= slotTrigrams.size())
+		slotTrigrams.resize(slot + 1);
+	std::vector<uint32_t>& trigrams = slotTrigrams[slot];
+	trigrams.clear();
+	trigram_appendtree(entity, trigrams);
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+	trigrams.shrink_to_fit();
+
+	// Slots are added in ascending order while the index is built, so this is usually an append
+	for (uint32_t t : trigrams) {
+		std::vector<uint32_t>& posting = postings[t];
+		if(posting.empty() || posting.back() < slot)
+			posting.push_back((uint32_t)slot);
+		else posting.insert(std::lower_bound(posting.begin(), posting.end(), (uint32_t)slot), (uint32_t)slot);
+	}
+}
+
+void TrigramIndex::Remove(size_t slot)
+{
+	if(slot >= slotTrigrams.size())
+		return;
+	for (uint32_t t : slotTrigrams[slot]) {
+		auto iter = postings.find(t);
+		std::vector<uint32_t>& posting = iter->second;
+		posting.erase(std::lower_bound(posting.begin(), posting.end(), (uint32_t)slot));
+		if(posting.empty())
+			postings.erase(iter);
+	}
+	slotTrigrams[slot].clear();
+	slotTrigrams[slot].shrink_to_fit();
+}
+
+bool TrigramIndex::Candidates(std::string_view key, EntityBitset& result) const
+{
+	result.clear();
+	if(key.length() < MIN_KEY_LENGTH)
+		return false;
+
+	std::vector<uint32_t> trigrams;
+	trigram_append(key, trigrams);
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+	std::vector<const std::vector<uint32_t>*> lists;
+	for (uint32_t t : trigrams) {
+		auto iter = postings.find(t);
+		if(iter == postings.end())
+			return true;
+		lists.push_back(&iter->second);
+	}
+
+	// Intersect starting from the rarest trigram
+	std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+		return a->size() < b->size();
+	});
+	std::vector<uint32_t> slots = *lists[0], narrowed;
+	for (size_t i = 1; i < lists.size() && !slots.empty(); i++) {
+		narrowed.clear();
+		std::set_intersection(slots.begin(), slots.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(narrowed));
+		slots.swap(narrowed);
+	}
+
+	for(uint32_t slot : slots)
+		result.set(slot);
+	return true;
+}
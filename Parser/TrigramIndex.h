@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+
+class EntNode;
+class EntityBitset;
+
+/*
+* Maps every three-character sequence in the node text of each entity to the slots of the
+* entities containing it. Characters are folded to uppercase like EntNode::searchText does,
+* so lookups give a superset of the entities a search - case sensitive or not - could match.
+* Sequences spanning two nodes aren't indexed, since searchText never matches across nodes
+*/
+class TrigramIndex
+{
+	private:
+	std::unordered_map<uint32_t, std::vector<uint32_t>> postings; // Trigram -> ascending slots
+	std::vector<std::vector<uint32_t>> slotTrigrams;               // Slot -> distinct trigrams in the entity
+
+	public:
+	/* Shortest key the index can narrow a search for */
+	static const size_t MIN_KEY_LENGTH = 3;
+
+	void Clear();
+	void Add(size_t slot, const EntNode& entity);
+	void Remove(size_t slot);
+
+	/*
+	* Sets the slot of every entity that could contain the key
+	* @return False if the key is too short to look up, leaving the result empty
+	*/
+	bool Candidates(std::string_view key, EntityBitset& result) const;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <exception>
+
+/*
+* Fork-join helpers for spreading independent jobs across the CPU's cores
+*
+* Jobs must only read data shared between them, or write to data
+* belonging exclusively to their own index
+*/
+namespace WorkerPool
+{
+	/* Number of threads a ParallelFor call will use */
+	inline unsigned ThreadCount()
+	{
+		unsigned count = std::thread::hardware_concurrency();
+		return count == 0 ? 1 : count;
+	}
+
+	/*
+	* Runs job(i) for every i in [0, count) and returns once they've all finished.
+	* The calling thread works alongside the others
+	* @param maxThreads Upper limit on the number of threads used. 0 to use every core
+	* @throw The first exception thrown by a job, once every thread has stopped
+	*/
+	template <typename Job>
+	void ParallelFor(size_t count, const Job& job, unsigned maxThreads = 0)
+	{
+		unsigned threadcount = ThreadCount();
+		if(maxThreads > 0 && maxThreads < threadcount)
+			threadcount = maxThreads;
+		if(threadcount > count)
+			threadcount = (unsigned)count;
+
+		if (threadcount <= 1) {
+			for(size_t i = 0; i < count; i++)
+				job(i);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		std::atomic<bool> failed(false);
+		std::exception_ptr error = nullptr;
+
+		auto worker = [&]() {
+			try {
+				for (size_t i = next++; i < count && !failed; i = next++)
+					job(i);
+			}
+			catch (...) {
+				if(!failed.exchange(true))
+					error = std::current_exception();
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadcount - 1);
+		for(unsigned t = 1; t < threadcount; t++)
+			threads.emplace_back(worker);
+		worker();
+		for(std::thread& t : threads)
+			t.join();
+
+		if(error)
+			std::rethrow_exception(error);
+	}
+}
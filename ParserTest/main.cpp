@@ -0,0 +1,635 @@
+/*
+* ParserTest - Checks that the push-based StreamInput parse builds the same tree as parsing
+* the whole input at once, whatever sizes the input is split into. Also checks that
+* importing an exported diff into the original file reproduces the modified file
+*
+* Usage: ParserTest [seed]
+*
+* Prints each failed check and returns 1 if any fail
+*/
+#include "../Parser/EntityParser.h"
+#include "../Parser/EntityDiff.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+std::mt19937 rng;
+int failures = 0;
+
+int test_random(int min, int max)
+{
+	return std::uniform_int_distribution<int>(min, max)(rng);
+}
+
+void test_check(bool passed, const std::string& what)
+{
+	if (!passed) {
+		std::cout << "FAILED: " << what << "\n";
+		failures++;
+	}
+}
+
+/*
+* Random .entities text using every construct the grammar accepts, including the ones
+* most likely to be cut apart by a chunk boundary: comments, CRLF line endings,
+* string literals, dollar sign hexadecimals and bracketed identifiers
+*/
+void test_definition(std::string& text, int depth, const char* newline)
+{
+	for (int i = 0, max = test_random(1, 6); i < max; i++)
+	{
+		text.append(depth, '\t');
+		switch (test_random(0, 7))
+		{
+			case 0:
+			text.append("// Comment ").append(std::to_string(test_random(0, 9999))).append(newline);
+			break;
+
+			case 1:
+			text.append("/* Multiline").append(newline).append("comment **/").append(newline);
+			break;
+
+			case 2:
+			text.append("name = \"value_").append(std::to_string(test_random(0, 9999))).append("\";").append(newline);
+			break;
+
+			case 3:
+			text.append("num = $0x3f800000 ").append(std::to_string(test_random(-500, 500))).append(".25;").append(newline);
+			break;
+
+			case 4:
+			text.append("item[").append(std::to_string(i)).append("] = ").append(test_random(0, 1) ? "true" : "NULL").append(";").append(newline);
+			break;
+
+			case 5:
+			text.append("\"quoted key\" = -1.5e+3;").append(newline);
+			break;
+
+			default:
+			if (depth > 5) {
+				text.append("leaf = 7;").append(newline);
+				break;
+			}
+			text.append("block = {").append(newline);
+			test_definition(text, depth + 1, newline);
+			text.append(depth, '\t').append("}").append(newline);
+			break;
+		}
+	}
+}
+
+std::string test_file(int entities)
+{
+	const char* newline = test_random(0, 1) ? "\r\n" : "\n";
+	std::string text = "Version 7";
+	text.append(newline).append("HierarchyVersion 1").append(newline);
+
+	for (int i = 0; i < entities; i++)
+	{
+		if (test_random(0, 9) == 0)
+			text.append("// Between entities").append(newline);
+		text.append("entity {").append(newline);
+		if (test_random(0, 2) == 0) {
+			text.append("\tlayers {").append(newline);
+			text.append("\t\t\"spawn_").append(std::to_string(i % 7)).append("\"").append(newline);
+			text.append("\t}").append(newline);
+		}
+		text.append("\t\"darkmetal\" = \"value\"").append(newline);
+		text.append("\tentityDef entity_").append(std::to_string(i)).append(" {").append(newline);
+		text.append("\t\tinherit = \"base\";").append(newline);
+		text.append("\t\tclass = \"idTarget\";").append(newline);
+		text.append("\t\tedit = {").append(newline);
+		test_definition(text, 3, newline);
+		text.append("\t\t}").append(newline);
+		text.append("\t}").append(newline);
+		text.append("}").append(newline);
+	}
+	return text;
+}
+
+/* Streams text into a parser in chunks whose sizes are picked by nextChunk */
+template<typename ChunkSize>
+void test_stream(EntityParser& parser, const std::string& text, const ChunkSize& nextChunk)
+{
+	for (size_t i = 0; i < text.length(); ) {
+		size_t length = std::min(text.length() - i, nextChunk());
+		parser.StreamInput(std::string_view(text.data() + i, length));
+		i += length;
+	}
+	parser.StreamFinish();
+}
+
+void test_matches(const std::string& text, const std::string& name)
+{
+	EntityParser whole(ParsingMode::ENTITIES, text, false);
+	std::string expected = whole.getRoot()->toString();
+
+	const size_t maxChunks[] = {1, 7, 64, 4096, 1 << 20};
+	for (size_t maxChunk : maxChunks) {
+		EntityParser streamed(ParsingMode::ENTITIES);
+		test_stream(streamed, text, [&]() { return (size_t)test_random(1, (int)maxChunk); });
+
+		std::string what = name + " in chunks of up to " + std::to_string(maxChunk) + " bytes";
+		test_check(streamed.getRoot()->getHash() == whole.getRoot()->getHash(), what + ": tree hashes differ");
+		test_check(streamed.getRoot()->toString() == expected, what + ": generated text differs");
+	}
+}
+
+/* Streamed errors must be reported like errors in text parsed at once */
+void test_error(const std::string& text, const std::string& name)
+{
+	std::string expected;
+	try {
+		EntityParser whole(ParsingMode::ENTITIES, text, false);
+	}
+	catch (std::runtime_error& e) {
+		expected = e.what();
+	}
+	test_check(!expected.empty(), name + ": whole parse didn't fail");
+
+	const size_t maxChunks[] = {1, 13, 4096};
+	for (size_t maxChunk : maxChunks) {
+		std::string actual;
+		try {
+			EntityParser streamed(ParsingMode::ENTITIES);
+			test_stream(streamed, text, [&]() { return (size_t)test_random(1, (int)maxChunk); });
+		}
+		catch (std::runtime_error& e) {
+			actual = e.what();
+		}
+		test_check(actual == expected, name + " in chunks of up to " + std::to_string(maxChunk)
+			+ " bytes: expected \"" + expected + "\", got \"" + actual + "\"");
+	}
+}
+
+/* Path in the temporary directory for the diffs and logs the diff tests write */
+std::string test_tempfile(const char* name)
+{
+	return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::string test_readfile(const std::string& path)
+{
+	std::ifstream file(path, std::ios_base::binary);
+	std::stringstream text;
+	text << file.rdbuf();
+	return text.str();
+}
+
+/* Edits don't rehash the root, so trees are compared by the root's children */
+bool test_sametree(EntityParser& a, EntityParser& b)
+{
+	const EntNode& aroot = *a.getRoot(), &broot = *b.getRoot();
+	if(aroot.getChildCount() != broot.getChildCount())
+		return false;
+	for (int i = 0; i < aroot.getChildCount(); i++)
+		if(!EntNode::SameTree(aroot[i], broot[i]))
+			return false;
+	return true;
+}
+
+/* An entity with a numbered list of targets, for checking list diffs and entity moves */
+struct test_entity
+{
+	std::string name;
+	std::string health;
+	std::vector<std::string> targets;
+};
+
+std::string test_entities(const std::vector<test_entity>& entities)
+{
+	std::string text = "Version 7\nHierarchyVersion 1\n";
+	for (const test_entity& e : entities) {
+		text.append("entity {\n\tentityDef ").append(e.name).append(" {\n");
+		text.append("\t\tinherit = \"base\";\n\t\tclass = \"idTarget\";\n\t\tedit = {\n");
+		text.append("\t\t\thealth = ").append(e.health).append(";\n");
+		text.append("\t\t\ttargets = {\n\t\t\t\tnum = ").append(std::to_string(e.targets.size())).append(";\n");
+		for (size_t i = 0; i < e.targets.size(); i++)
+			text.append("\t\t\t\titem[").append(std::to_string(i)).append("] = \"").append(e.targets[i]).append("\";\n");
+		text.append("\t\t\t}\n\t\t}\n\t}\n}\n");
+	}
+	return text;
+}
+
+/*
+* Exports a diff between two .entities files, then imports it into the first
+* the way EntitySlayer does. The result must be identical to the second file
+* @return The diff's text
+*/
+std::string test_entitydiff(const std::string& vanilla, const std::string& modded, const std::string& name, 
+	EntityDiff::ExportStats& stats)
+{
+	EntityParser vparser(ParsingMode::ENTITIES, vanilla, false);
+	EntityParser mparser(ParsingMode::ENTITIES, modded, false);
+	std::string diffpath = test_tempfile("ParserTest.diff");
+	stats = EntityDiff::Export(*vparser.getRoot(), *mparser.getRoot(), diffpath.c_str());
+
+	EntityParser diff(diffpath, ParsingMode::PERMISSIVE, false, false);
+	EntityDiff::Import(vparser, *diff.getRoot(), test_tempfile("ParserTest.log").c_str(), name.c_str());
+	test_check(test_sametree(vparser, mparser), name + ": imported diff doesn't reproduce the modded file");
+	return test_readfile(diffpath);
+}
+
+/*
+* Lists are diffed as sequences and entities out of vanilla order are moved, so the diffs
+* stay small when items or entities are reordered, inserted or removed
+*/
+void test_listdiffs()
+{
+	EntityDiff::ExportStats stats;
+
+	// Random changes to lists that repeat targets, so items can be matched more than one way
+	for (int round = 0; round < 20; round++)
+	{
+		std::vector<test_entity> vanilla;
+		for (int i = 0, max = test_random(1, 30); i < max; i++) {
+			vanilla.push_back({"entity_" + std::to_string(i), std::to_string(test_random(1, 100)), {}});
+			for(int k = 0, items = test_random(0, 40); k < items; k++)
+				vanilla.back().targets.push_back("target_" + std::to_string(test_random(0, 9)));
+		}
+
+		std::vector<test_entity> modded = vanilla;
+		for (test_entity& e : modded) {
+			if(test_random(0, 3) == 0)
+				e.health = std::to_string(test_random(1, 100));
+			for (int k = 0, edits = test_random(0, 5); k < edits; k++) {
+				int size = (int)e.targets.size();
+				switch (test_random(0, 3))
+				{
+					case 0:
+					if(size > 0)
+						e.targets.erase(e.targets.begin() + test_random(0, size - 1));
+					break;
+
+					case 1:
+					e.targets.insert(e.targets.begin() + test_random(0, size), "added_" + std::to_string(test_random(0, 9)));
+					break;
+
+					case 2:
+					if(size > 0)
+						e.targets[test_random(0, size - 1)] = "edited";
+					break;
+
+					default:
+					if (size > 1) {
+						int at = test_random(0, size - 2);
+						std::swap(e.targets[at], e.targets[at + 1]);
+					}
+					break;
+				}
+			}
+		}
+
+		// Move, delete and rename entities
+		for (int k = 0, edits = test_random(0, 4); k < edits && !modded.empty(); k++) {
+			int from = test_random(0, (int)modded.size() - 1);
+			test_entity e = modded[from];
+			modded.erase(modded.begin() + from);
+			switch (test_random(0, 2))
+			{
+				case 0:
+				modded.insert(modded.begin() + test_random(0, (int)modded.size()), e);
+				break;
+
+				case 1:
+				e.name = "renamed_" + std::to_string(k);
+				modded.insert(modded.begin() + from, e);
+				break;
+
+				default:
+				break;
+			}
+		}
+		test_entitydiff(test_entities(vanilla), test_entities(modded), "Random list diff " + std::to_string(round), stats);
+	}
+
+	// Removing and inserting an item only writes those items, not an edit to every item after them
+	std::vector<test_entity> vanilla = {{"long_list", "100", {}}};
+	for(int i = 0; i < 500; i++)
+		vanilla[0].targets.push_back("target_" + std::to_string(i));
+	std::vector<test_entity> modded = vanilla;
+	modded[0].targets.erase(modded[0].targets.begin() + 250);
+	modded[0].targets.insert(modded[0].targets.begin() + 10, "inserted");
+	std::string diff = test_entitydiff(test_entities(vanilla), test_entities(modded), "Long list", stats);
+	test_check(stats.edited == 1 && stats.moved == 0, "Long list: expected 1 edited entity");
+	test_check(diff.length() < 1000, "Long list: diff is " + std::to_string(diff.length()) + " bytes");
+	test_check(diff.find("target_251") == std::string::npos, "Long list: unchanged items are in the diff");
+
+	// Only the entities outside the longest run still in vanilla order are moved
+	vanilla.clear();
+	for(int i = 0; i < 10; i++)
+		vanilla.push_back({"entity_" + std::to_string(i), "100", {"a", "b"}});
+	modded = vanilla;
+	std::rotate(modded.begin() + 2, modded.begin() + 3, modded.end());
+	test_entitydiff(test_entities(vanilla), test_entities(modded), "One moved entity", stats);
+	test_check(stats.moved == 1 && stats.edited == 0, "One moved entity: expected 1 moved entity, got " + std::to_string(stats.moved));
+
+	modded.assign(vanilla.rbegin(), vanilla.rend());
+	test_entitydiff(test_entities(vanilla), test_entities(modded), "Reversed entities", stats);
+	test_check(stats.moved == 9, "Reversed entities: expected 9 moved entities, got " + std::to_string(stats.moved));
+}
+
+/*
+* Merging several diffs skips changes that conflict with another diff's, and applies
+* identical changes once. Everything else must match importing the diffs one by one
+*/
+void test_importmany()
+{
+	std::vector<test_entity> vanilla;
+	for(int i = 0; i < 6; i++)
+		vanilla.push_back({"entity_" + std::to_string(i), "100", {"a", "b", "c"}});
+
+	std::vector<test_entity> first = vanilla, second = vanilla, expected = vanilla;
+	// Editing a property to different values conflicts
+	first[0].health = "5";
+	second[0].health = "7";
+
+	// Identical edits are applied once
+	first[1].health = second[1].health = expected[1].health = "9";
+
+	// Edits to different properties of one entity don't conflict
+	first[2].health = expected[2].health = "1";
+	second[2].targets.push_back("d");
+	expected[2].targets.push_back("d");
+
+	// Changes only one diff makes are applied
+	first[4].targets[1] = expected[4].targets[1] = "edited";
+	second.push_back({"added", "50", {}});
+	expected.push_back(second.back());
+
+	// Deleting an entity conflicts with every edit to it
+	first.erase(first.begin() + 3);
+	second[3].targets.erase(second[3].targets.begin());
+
+	EntityParser vparser(ParsingMode::ENTITIES, test_entities(vanilla), false);
+	EntityParser fparser(ParsingMode::ENTITIES, test_entities(first), false);
+	EntityParser sparser(ParsingMode::ENTITIES, test_entities(second), false);
+	std::string firstpath = test_tempfile("ParserTest_first.diff"), secondpath = test_tempfile("ParserTest_second.diff");
+	EntityDiff::Export(*vparser.getRoot(), *fparser.getRoot(), firstpath.c_str());
+	EntityDiff::Export(*vparser.getRoot(), *sparser.getRoot(), secondpath.c_str());
+	EntityParser firstdiff(firstpath, ParsingMode::PERMISSIVE, false, false);
+	EntityParser seconddiff(secondpath, ParsingMode::PERMISSIVE, false, false);
+
+	std::string logpath = test_tempfile("ParserTest.log");
+	std::filesystem::remove(logpath);
+	EntityDiff::ImportMany(vparser, {firstdiff.getRoot(), seconddiff.getRoot()}, {"first.diff", "second.diff"}, 
+		logpath.c_str(), "Merged diffs");
+
+	EntityParser eparser(ParsingMode::ENTITIES, test_entities(expected), false);
+	test_check(test_sametree(vparser, eparser), "Merged diffs: conflicting changes weren't skipped");
+
+	std::string log = test_readfile(logpath);
+	size_t conflicts = 0;
+	for(size_t i = log.find("Conflicting changes from first.diff and second.diff"); i != std::string::npos; i = log.find("Conflicting", i + 1))
+		conflicts++;
+	test_check(conflicts == 3, "Merged diffs: expected 3 conflicts in the log, found " + std::to_string(conflicts));
+	test_check(log.find("Identical change from multiple diffs is applied once") != std::string::npos, 
+		"Merged diffs: identical change wasn't noted in the log");
+
+	// Diffs that change different entities merge to the same file as importing them in turn
+	for (int round = 0; round < 10; round++)
+	{
+		vanilla.clear();
+		for (int i = 0, max = test_random(2, 30); i < max; i++) {
+			vanilla.push_back({"entity_" + std::to_string(i), "100", {}});
+			for(int k = 0, items = test_random(0, 10); k < items; k++)
+				vanilla.back().targets.push_back("target_" + std::to_string(test_random(0, 9)));
+		}
+		first = second = vanilla;
+		for (size_t i = 0; i < vanilla.size(); i++) {
+			std::vector<test_entity>& modded = i % 2 ? first : second;
+			if(test_random(0, 1))
+				modded[i].health = std::to_string(test_random(1, 99));
+			if(test_random(0, 1) && !modded[i].targets.empty())
+				modded[i].targets.erase(modded[i].targets.begin() + test_random(0, (int)modded[i].targets.size() - 1));
+			if(test_random(0, 1))
+				modded[i].targets.insert(modded[i].targets.begin() + test_random(0, (int)modded[i].targets.size()), "inserted");
+		}
+
+		EntityParser merged(ParsingMode::ENTITIES, test_entities(vanilla), false);
+		EntityParser sequential(ParsingMode::ENTITIES, test_entities(vanilla), false);
+		EntityParser fparser(ParsingMode::ENTITIES, test_entities(first), false);
+		EntityParser sparser(ParsingMode::ENTITIES, test_entities(second), false);
+		EntityDiff::Export(*merged.getRoot(), *fparser.getRoot(), firstpath.c_str());
+		EntityDiff::Export(*merged.getRoot(), *sparser.getRoot(), secondpath.c_str());
+		EntityParser firstdiff(firstpath, ParsingMode::PERMISSIVE, false, false);
+		EntityParser seconddiff(secondpath, ParsingMode::PERMISSIVE, false, false);
+
+		EntityDiff::ImportMany(merged, {firstdiff.getRoot(), seconddiff.getRoot()}, {"first.diff", "second.diff"}, 
+			logpath.c_str(), "Merged diffs");
+		EntityDiff::Import(sequential, *firstdiff.getRoot(), logpath.c_str(), "First diff");
+		EntityDiff::Import(sequential, *seconddiff.getRoot(), logpath.c_str(), "Second diff");
+		test_check(test_sametree(merged, sequential), "Random merged diffs " + std::to_string(round) + ": differs from importing in turn");
+	}
+}
+
+/* A JSON value: an object if it has keyed members, an array if not, or a scalar if it has none */
+struct test_json
+{
+	enum { SCALAR, OBJECT, ARRAY } type = SCALAR;
+	std::string scalar;
+	std::vector<std::pair<std::string, test_json>> members; // Array elements have no key
+};
+
+test_json test_jsonvalue(int depth)
+{
+	test_json value;
+	int type = depth > 3 ? 0 : test_random(0, 2);
+	if (type == 0) {
+		const char* scalars[] = {"true", "null", "-1.5e+3", "\"text\""};
+		value.scalar = test_random(0, 1) ? std::to_string(test_random(0, 99)) : scalars[test_random(0, 3)];
+		return value;
+	}
+
+	value.type = type == 1 ? test_json::OBJECT : test_json::ARRAY;
+	for(int i = 0, max = test_random(0, 6); i < max; i++)
+		value.members.emplace_back(type == 1 ? "key_" + std::to_string(i) : "", test_jsonvalue(depth + 1));
+	return value;
+}
+
+/* Randomly edits, replaces, removes, inserts and swaps values throughout a tree */
+void test_jsonmutate(test_json& value, int depth)
+{
+	if (value.type == test_json::SCALAR) {
+		if(test_random(0, 3) == 0)
+			value.scalar = std::to_string(test_random(100, 199));
+		return;
+	}
+
+	auto& members = value.members;
+	for (size_t i = 0; i < members.size(); i++) {
+		switch (test_random(0, 9))
+		{
+			case 0:
+			members.erase(members.begin() + i--);
+			break;
+
+			case 1:
+			members[i].second = test_jsonvalue(depth + 1);
+			break;
+
+			case 2:
+			if(value.type == test_json::ARRAY && i > 0)
+				std::swap(members[i - 1], members[i]);
+			break;
+
+			default:
+			test_jsonmutate(members[i].second, depth + 1);
+			break;
+		}
+	}
+	if(test_random(0, 2) == 0)
+		members.emplace(members.begin() + test_random(0, (int)members.size()), 
+			value.type == test_json::OBJECT ? "new_" + std::to_string(test_random(0, 99999)) : "", test_jsonvalue(depth + 1));
+}
+
+void test_jsontext(const test_json& value, std::string& text)
+{
+	if (value.type == test_json::SCALAR) {
+		text.append(value.scalar);
+		return;
+	}
+	text.push_back(value.type == test_json::OBJECT ? '{' : '[');
+	for (size_t i = 0; i < value.members.size(); i++) {
+		if(i > 0)
+			text.append(", ");
+		if(value.type == test_json::OBJECT)
+			text.append("\"").append(value.members[i].first).append("\": ");
+		test_jsontext(value.members[i].second, text);
+	}
+	text.push_back(value.type == test_json::OBJECT ? '}' : ']');
+}
+
+/*
+* Exports a tree diff between two files, then imports it into the first
+* the way EntitySlayer does. The result must be identical to the second file
+*/
+void test_treediff(ParsingMode mode, const std::string& vanilla, const std::string& modded, const std::string& name)
+{
+	EntityParser vparser(mode, vanilla, false);
+	EntityParser mparser(mode, modded, false);
+	std::string diffpath = test_tempfile("ParserTest.diff");
+	EntityDiff::ExportTree(*vparser.getRoot(), *mparser.getRoot(), diffpath.c_str());
+
+	EntityParser diff(diffpath, ParsingMode::PERMISSIVE, false, false);
+	test_check(EntityDiff::IsTreeDiff(*diff.getRoot()), name + ": diff isn't recognized as a tree diff");
+	EntityDiff::ImportTree(vparser, *diff.getRoot(), test_tempfile("ParserTest.log").c_str(), name.c_str());
+	test_check(test_sametree(vparser, mparser), name + ": imported diff doesn't reproduce the modded file");
+}
+
+/* Tree diffs of JSON and permissive files, and the changes they can't export or apply */
+void test_treediffs()
+{
+	for (int round = 0; round < 40; round++) {
+		test_json vanilla = test_jsonvalue(0), modded = vanilla;
+		test_jsonmutate(modded, 0);
+
+		std::string vtext, mtext;
+		test_jsontext(vanilla, vtext);
+		test_jsontext(modded, mtext);
+		test_treediff(ParsingMode::JSON, vtext, mtext, "Random JSON diff " + std::to_string(round));
+	}
+
+	test_treediff(ParsingMode::PERMISSIVE,
+		"{\n\tedit = {\n\t\tdamage = 10;\n\t\tspread {\n\t\t\tx = 1;\n\t\t\ty = 2;\n\t\t}\n\t\tsound = \"fire\";\n\t}\n}\n",
+		"{\n\tedit = {\n\t\tdamage = 25;\n\t\tspread {\n\t\t\ty = 2;\n\t\t\tz = 3;\n\t\t}\n\t\trange = 500;\n\t\tsound = \"fire\";\n\t}\n}\n",
+		"Permissive decl diff");
+
+	// Verbatim strings can't hold %>, so the export fails without writing a diff
+	{
+		EntityParser vparser(ParsingMode::JSON, "{\"name\": \"plain\"}", false);
+		EntityParser mparser(ParsingMode::JSON, "{\"name\": \"a%>b\"}", false);
+		std::string diffpath = test_tempfile("ParserTest.diff");
+		std::filesystem::remove(diffpath);
+
+		std::string error;
+		try {
+			EntityDiff::ExportTree(*vparser.getRoot(), *mparser.getRoot(), diffpath.c_str());
+		}
+		catch (std::runtime_error& e) {
+			error = e.what();
+		}
+		test_check(error == "EntityDiff: Cannot write text containing %> to a tree diff", "Unexportable text: got error \"" + error + "\"");
+		test_check(!std::filesystem::exists(diffpath), "Unexportable text: a diff was written");
+	}
+
+	// Replacements and deletions of nodes changed since the diff was made are skipped and logged
+	{
+		EntityParser vparser(ParsingMode::JSON, "[1, 2, 3, 4]", false);
+		EntityParser mparser(ParsingMode::JSON, "[1, {\"new\": true}, 3]", false);
+		std::string diffpath = test_tempfile("ParserTest.diff"), logpath = test_tempfile("ParserTest.log");
+		EntityDiff::ExportTree(*vparser.getRoot(), *mparser.getRoot(), diffpath.c_str());
+
+		EntityParser diff(diffpath, ParsingMode::PERMISSIVE, false, false);
+		EntityParser target(ParsingMode::JSON, "[1, [\"changed\"], 3, 5]", false);
+		std::filesystem::remove(logpath);
+		EntityDiff::ImportTree(target, *diff.getRoot(), logpath.c_str(), "Changed target");
+
+		EntityParser expected(ParsingMode::JSON, "[1, [\"changed\"], 3, 5]", false);
+		test_check(test_sametree(target, expected), "Changed target: changed nodes were replaced or deleted");
+		std::string log = test_readfile(logpath);
+		size_t skipped = 0;
+		for(size_t i = log.find("Node was changed since the diff was made"); i != std::string::npos; i = log.find("Node was changed", i + 1))
+			skipped++;
+		test_check(skipped == 2, "Changed target: expected 2 skipped operations in the log, found " + std::to_string(skipped));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned seed = argc > 1 ? (unsigned)strtoul(argv[1], nullptr, 10) : 5489u;
+	rng.seed(seed);
+	std::cout << "Seed " << seed << "\n";
+
+	for (int i = 0; i < 20; i++)
+		test_matches(test_file(test_random(0, 40)), "Random file " + std::to_string(i));
+
+	test_matches("", "Empty file");
+	test_matches("Version 7\n// Trailing comment", "Trailing comment");
+	test_matches("Version 7\nentity {\n\tentityDef a {\n\t}\n}", "No final newline");
+
+	std::string broken = test_file(30);
+	broken.insert(broken.length() / 2, "\n= = =\n");
+	test_error(broken, "Misplaced equal signs");
+	test_error(test_file(5) + "entity {\n\tentityDef a {\n\t\tname = \"unterminated\n\t}\n}\n", "Unterminated string");
+	test_error(test_file(5) + "entity {\n/* Unterminated comment", "Unterminated comment");
+	test_error(test_file(5) + "entity {\r", "Lone carriage return");
+
+	test_listdiffs();
+	test_importmany();
+	test_treediffs();
+
+	/*
+	* A single large entity received in small chunks. Reparsing it from the start for every
+	* chunk would take minutes - retries must be spaced out so the total time stays linear
+	*/
+	{
+		std::string large = "entity {\n\tentityDef large {\n\t\tedit = {\n";
+		for(int i = 0; large.length() < (4 << 20); i++)
+			large.append("\t\t\tfield_").append(std::to_string(i)).append(" = \"value\";\n");
+		large.append("\t\t}\n\t}\n}\n");
+
+		auto start = std::chrono::steady_clock::now();
+		EntityParser streamed(ParsingMode::ENTITIES);
+		test_stream(streamed, large, []() { return (size_t)64; });
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		std::cout << "Large entity in 64 byte chunks: " << elapsed.count() << " ms\n";
+
+		EntityParser whole(ParsingMode::ENTITIES, large, false);
+		test_check(streamed.getRoot()->getHash() == whole.getRoot()->getHash(), "Large entity: tree hashes differ");
+	}
+
+	if (failures > 0) {
+		std::cout << failures << " check(s) failed\n";
+		return 1;
+	}
+	std::cout << "All checks passed\n";
+	return 0;
+}